@@ -0,0 +1,207 @@
+/***************************************************************************
+ *  include/color_classifier/active_spans.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef COLORCLASSIFIER_ACTIVESPANS_H_
+#define COLORCLASSIFIER_ACTIVESPANS_H_
+
+// objects
+#include <opencv/cv.h>
+#include <neuromorphic_image_proc/changed_tiles.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// =============================================================================================================================================
+//! Run-length view of the non-zero pixels of a mono8 mask (or of the changed tiles of a ChangedTiles), as [begin, end) column spans per row
+class ActiveSpans
+{
+public:
+    struct Span
+    {
+        int begin_;
+        int end_;
+
+        Span( int const & begin = 0, int const & end = 0 )
+        :
+            begin_( begin ),
+            end_( end )
+        {
+            //
+        }
+    };
+
+protected:
+    //! Spans for row y are spans_[row_offsets_[y]] through spans_[row_offsets_[y + 1] - 1]
+    std::vector<size_t> row_offsets_;
+    std::vector<Span> spans_;
+    size_t num_active_pixels_;
+
+    //! Scratch space for fromTiles; kept across frames to avoid reallocating
+    std::vector<std::vector<Span> > tile_row_spans_;
+    std::vector<std::vector<Span> > row_spans_;
+
+public:
+    ActiveSpans()
+    :
+        num_active_pixels_( 0 )
+    {
+        //
+    }
+
+    void fromMask( cv::Mat const & mask )
+    {
+        row_offsets_.resize( mask.rows + 1 );
+        spans_.clear();
+        num_active_pixels_ = 0;
+
+        for( int y = 0; y < mask.rows; ++y )
+        {
+            row_offsets_[y] = spans_.size();
+
+            uchar const * mask_row = mask.ptr<uchar>( y );
+            int x = 0;
+            while( x < mask.cols )
+            {
+                while( x < mask.cols && !mask_row[x] ) ++x;
+                if( x == mask.cols ) break;
+
+                int const begin = x;
+                while( x < mask.cols && mask_row[x] ) ++x;
+
+                spans_.push_back( Span( begin, x ) );
+                num_active_pixels_ += x - begin;
+            }
+        }
+
+        row_offsets_[mask.rows] = spans_.size();
+    }
+
+    //! Mark every pixel of a size image covered by a changed tile, grown by margin pixels in each direction
+    /*!
+     * - Tiles are in the coordinates of the mask they were computed from; they're scaled to size here
+     * - Equivalent to scaling a mask of the changed tiles to size and dilating it by a (2 * margin + 1) square, but the cost depends on the
+     *   number of tiles rather than the number of pixels
+     */
+    void fromTiles( ChangedTiles const & tiles, cv::Size const & size, int const & margin )
+    {
+        double const scale_x = double( size.width ) / std::max<size_t>( tiles.getWidth(), 1 );
+        double const scale_y = double( size.height ) / std::max<size_t>( tiles.getHeight(), 1 );
+        size_t const tile_size = tiles.getTileSize();
+
+        tile_row_spans_.resize( tiles.getTilesY() );
+        row_spans_.resize( size.height );
+        for( int y = 0; y < size.height; ++y )
+        {
+            row_spans_[y].clear();
+        }
+
+        for( size_t tile_y = 0; tile_y < tiles.getTilesY(); ++tile_y )
+        {
+            // merged spans of the changed tiles in this row of tiles
+            auto & tile_row_spans = tile_row_spans_[tile_y];
+            tile_row_spans.clear();
+
+            for( size_t tile_x = 0; tile_x < tiles.getTilesX(); ++tile_x )
+            {
+                if( !tiles.isChanged( tile_x, tile_y ) ) continue;
+
+                int const begin = std::max( int( std::floor( tile_x * tile_size * scale_x ) ) - margin, 0 );
+                int const end = std::min( int( std::ceil( std::min( ( tile_x + 1 ) * tile_size, tiles.getWidth() ) * scale_x ) ) + margin, size.width );
+
+                if( !tile_row_spans.empty() && begin <= tile_row_spans.back().end_ ) tile_row_spans.back().end_ = std::max( tile_row_spans.back().end_, end );
+                else tile_row_spans.push_back( Span( begin, end ) );
+            }
+
+            if( tile_row_spans.empty() ) continue;
+
+            // every output row this row of tiles touches gets its spans
+            int const y_begin = std::max( int( std::floor( tile_y * tile_size * scale_y ) ) - margin, 0 );
+            int const y_end = std::min( int( std::ceil( std::min( ( tile_y + 1 ) * tile_size, tiles.getHeight() ) * scale_y ) ) + margin, size.height );
+
+            for( int y = y_begin; y < y_end; ++y )
+            {
+                row_spans_[y].insert( row_spans_[y].end(), tile_row_spans.begin(), tile_row_spans.end() );
+            }
+        }
+
+        row_offsets_.resize( size.height + 1 );
+        spans_.clear();
+        num_active_pixels_ = 0;
+
+        for( int y = 0; y < size.height; ++y )
+        {
+            row_offsets_[y] = spans_.size();
+
+            // spans from neighboring rows of tiles can overlap; sort and merge them
+            auto & row_spans = row_spans_[y];
+            std::sort( row_spans.begin(), row_spans.end(), []( Span const & a, Span const & b ){ return a.begin_ < b.begin_; } );
+
+            for( auto span = row_spans.cbegin(); span != row_spans.cend(); ++span )
+            {
+                if( spans_.size() > row_offsets_[y] && span->begin_ <= spans_.back().end_ ) spans_.back().end_ = std::max( spans_.back().end_, span->end_ );
+                else spans_.push_back( *span );
+            }
+
+            for( size_t i = row_offsets_[y]; i < spans_.size(); ++i )
+            {
+                num_active_pixels_ += spans_[i].end_ - spans_[i].begin_;
+            }
+        }
+
+        row_offsets_[size.height] = spans_.size();
+    }
+
+    size_t rows() const
+    {
+        return row_offsets_.empty() ? 0 : row_offsets_.size() - 1;
+    }
+
+    Span const * rowBegin( size_t const & y ) const
+    {
+        return spans_.data() + row_offsets_[y];
+    }
+
+    Span const * rowEnd( size_t const & y ) const
+    {
+        return spans_.data() + row_offsets_[y + 1];
+    }
+
+    size_t numActivePixels() const
+    {
+        return num_active_pixels_;
+    }
+};
+
+#endif // COLORCLASSIFIER_ACTIVESPANS_H_
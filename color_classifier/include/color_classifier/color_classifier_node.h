@@ -45,6 +45,16 @@
 // objects
 #include <quickdev/pixel.h>
 #include <quickdev/param_reader.h>
+#include <color_classifier/gaussian_color_kernel.h>
+#include <color_classifier/color_lookup_table.h>
+#include <color_classifier/active_spans.h>
+#include <neuromorphic_image_proc/hls_preprocessor.h>
+#include <seabee3_common/worker_pool.h>
+#include <seabee3_common/label_map.h>
+#include <seabee3_common/snapshot.h>
+#include <quickdev/multi_subscriber.h>
+#include <deque>
+#include <mutex>
 #include <set>
 
 // utils
@@ -82,6 +92,46 @@ struct ClassifiedColor
     }
 };
 
+//! Everything the image callback needs from the configure action and the color models; published as a whole and never modified afterward
+struct ColorClassifierConfig
+{
+    //! Incremented each time a new config is published
+    size_t version_;
+
+    std::set<std::string> color_filter_;
+
+    //! Names of all colors in the model, indexed by kernel color id
+    std::vector<std::string> model_color_names_;
+    //! Kernel color ids and names of the colors that pass color_filter_, in color id order
+    std::vector<size_t> color_ids_;
+    std::vector<std::string> color_names_;
+
+    boost::shared_ptr<GaussianColorKernel const> color_kernel_;
+    //! Precomputed tables for every color in color_kernel_; null until mapped from disk or built in the background
+    boost::shared_ptr<ColorLookupTable const> lookup_table_;
+
+    ColorClassifierConfig()
+    :
+        version_( 0 )
+    {
+        //
+    }
+
+    void updateEnabledColors()
+    {
+        color_ids_.clear();
+        color_names_.clear();
+
+        for( size_t color_id = 0; color_id < model_color_names_.size(); ++color_id )
+        {
+            if( color_filter_.count( model_color_names_[color_id] ) == 0 ) continue;
+
+            color_ids_.push_back( color_id );
+            color_names_.push_back( model_color_names_[color_id] );
+        }
+    }
+};
+
 QUICKDEV_DECLARE_NODE( ColorClassifier, _AdaptationImageProcPolicy, _ConfigureActionServerPolicy )
 
 QUICKDEV_DECLARE_NODE_CLASS( ColorClassifier )
@@ -92,21 +142,79 @@ protected:
     typedef _ClassifiedColor::_Mean _ColorMean;
     typedef _ClassifiedColor::_Covariance _ColorCovariance;
 
-    std::set<std::string> color_filter_;
-    std::mutex color_filter_mutex_;
+    //! Read once per frame by imagesCB; replaced (never modified) by the configure action and the lookup table loader
+    seabee::Snapshot<ColorClassifierConfig> config_;
 
     std::map<std::string, cv::Mat> classified_images_;
     ros::MultiPublisher<> multi_pub_;
 
     std::map<std::string, _ClassifiedColor> target_colors_;
 
+    boost::shared_ptr<boost::thread> build_lookup_table_thread_ptr_;
+
+    bool use_lookup_table_;
+    std::string lookup_table_cache_uri_;
+
+    //! Splits each frame into row bands; a pool of size 1 classifies on the callback thread
+    boost::shared_ptr<seabee::WorkerPool> worker_pool_;
+
+    //! When enabled, only pixels flagged by the adaptation mask are re-classified; all others keep their value from the previous frame
+    bool sparse_classification_;
+    //! Number of frames between forced full classification passes in sparse mode
+    int full_refresh_interval_;
+    int frames_since_full_refresh_;
+    cv::Mat active_mask_;
+    ActiveSpans active_spans_;
+    //! Recent changed_tiles from the adaptation mask node; when one matches the mask's stamp, active spans are built from it instead of the mask
+    std::deque<_ChangedTilesMsg::ConstPtr> changed_tiles_msgs_;
+    std::mutex changed_tiles_mutex_;
+    ChangedTiles changed_tiles_;
+    ros::MultiSubscriber<> multi_sub_;
+    //! Version of the config used to produce the cached values in classified_images_; a new config forces a full pass
+    size_t last_config_version_;
+
+    const static int blur_size_ = 15;
+
+    //! Half-resolution, blurred HLS copy of the current frame; reused across frames
+    HlsPreprocessor preprocessor_;
+    cv::Mat normalized_image_;
+
+    enum OutputFormat
+    {
+        //! One full-resolution mono8 score image per enabled color
+        OUTPUT_IMAGES,
+        //! A single label image (index of the best-scoring enabled color) plus a confidence plane, at classification resolution
+        OUTPUT_LABEL_MAP,
+        //! As OUTPUT_LABEL_MAP, but with run-length encoded labels and no confidence plane
+        OUTPUT_LABEL_MAP_RLE
+    };
+
+    OutputFormat output_format_;
+    //! Pixels whose best score is below this value are labeled LABEL_NONE
+    int label_min_confidence_;
+    cv::Mat label_image_;
+    cv::Mat confidence_image_;
+
     XmlRpc::XmlRpcValue model_;
 
-    QUICKDEV_DECLARE_NODE_CONSTRUCTOR( ColorClassifier )
+    QUICKDEV_DECLARE_NODE_CONSTRUCTOR( ColorClassifier ),
+        frames_since_full_refresh_( 0 ),
+        last_config_version_( 0 ),
+        preprocessor_( 2, int( blur_size_ ), 3 )
     {
         //
     }
 
+    ~ColorClassifierNode()
+    {
+        // the background build reads config_ and writes the cache file; stop it before either goes away
+        if( build_lookup_table_thread_ptr_ )
+        {
+            build_lookup_table_thread_ptr_->interrupt();
+            build_lookup_table_thread_ptr_->join();
+        }
+    }
+
     QUICKDEV_SPIN_FIRST()
     {
         QUICKDEV_GET_RUNABLE_NODEHANDLE( nh_rel );
@@ -120,14 +228,21 @@ protected:
 //        _ImageProcPolicy::addImagePublisher( "classified_images" );
 
         multi_pub_.addPublishers<_NamedImageArrayMsg>( nh_rel, {"classified_images"} );
+        multi_pub_.addPublishers<seabee::_LabelMapMsg>( nh_rel, {"label_map"} );
 
         model_ = quickdev::ParamReader::readParam<decltype( model_ ) >( nh_rel, "model" );
 
+        // vectorized scorer for all colors in target_colors_; color ids follow the iteration order of target_colors_
+        auto const color_kernel = boost::make_shared<GaussianColorKernel>();
+        std::set<std::string> color_filter;
+        std::vector<std::string> model_color_names;
+
         for( auto color_it = model_.begin(); color_it != model_.end(); ++color_it )
         {
             auto const & color_name = color_it->first;
             std::cout << "Loading settings for color " << color_name << std::endl;
-            color_filter_.insert( color_name );
+            color_filter.insert( color_name );
+            model_color_names.push_back( color_name );
 
             auto & color = color_it->second;
 
@@ -141,36 +256,222 @@ protected:
 
             target_colors_[color_name] = classified_color;
             classified_images_[color_name] = cv::Mat();
+
+            // model_ is sorted by name, so kernel color ids follow the iteration order of target_colors_
+            color_kernel->addColor( color_mean, color_cov );
         }
 
+        color_kernel->setSimdEnabled( quickdev::ParamReader::readParam<bool>( nh_rel, "enable_simd", true ) );
+
+        updateConfig
+        (
+            [&]( ColorClassifierConfig & config )
+            {
+                config.color_filter_ = color_filter;
+                config.model_color_names_ = model_color_names;
+                config.color_kernel_ = color_kernel;
+                config.lookup_table_.reset();
+            }
+        );
+
+        if( !GaussianColorKernel::simdAvailable() ) PRINT_WARN( "Built without SSE2/AVX support; using scalar classification kernel." );
+
+        use_lookup_table_ = quickdev::ParamReader::readParam<bool>( nh_rel, "use_lookup_table", false );
+        lookup_table_cache_uri_ = quickdev::ParamReader::readParam<std::string>( nh_rel, "lookup_table_cache_uri", "" );
+
+        if( use_lookup_table_ ) loadLookupTable();
+
+        auto const num_threads = quickdev::ParamReader::readParam<int>( nh_rel, "num_threads", 1 );
+        worker_pool_ = boost::make_shared<seabee::WorkerPool>( std::max( num_threads, 1 ) );
+        PRINT_INFO( "Classifying with %zu thread(s)", worker_pool_->size() );
+
+        sparse_classification_ = quickdev::ParamReader::readParam<bool>( nh_rel, "sparse_classification", false );
+        full_refresh_interval_ = quickdev::ParamReader::readParam<int>( nh_rel, "full_refresh_interval", 30 );
+
+        if( sparse_classification_ && quickdev::ParamReader::readParam<bool>( nh_rel, "disable_mask", false ) ) PRINT_WARN( "Sparse classification requires the adaptation mask; set disable_mask to false. Classifying every pixel." );
+        if( sparse_classification_ ) multi_sub_.addSubscriber( nh_rel, "changed_tiles", &ColorClassifierNode::changedTilesCB, this );
+
+        auto const output_format = quickdev::ParamReader::readParam<std::string>( nh_rel, "output_format", "images" );
+        if( output_format == "label_map" ) output_format_ = OUTPUT_LABEL_MAP;
+        else if( output_format == "label_map_rle" ) output_format_ = OUTPUT_LABEL_MAP_RLE;
+        else
+        {
+            if( output_format != "images" ) PRINT_WARN( "Unknown output format %s; publishing classified images.", output_format.c_str() );
+            output_format_ = OUTPUT_IMAGES;
+        }
+
+        label_min_confidence_ = quickdev::ParamReader::readParam<int>( nh_rel, "label_min_confidence", 100 );
+
         initPolicies<quickdev::policy::ALL>();
     }
 
-    QUICKDEV_DECLARE_ACTION_EXECUTE_CALLBACK( configureActionExecuteCB, _ConfigureAction )
+    //! Copy the current config, apply func to the copy, and publish it for the next frame
+    template<class __Func>
+    void updateConfig( __Func func )
+    {
+        config_.update
+        (
+            [&]( ColorClassifierConfig & config )
+            {
+                func( config );
+                config.updateEnabledColors();
+                ++config.version_;
+            }
+        );
+    }
+
+    // the lookup tables cover every color in the model, so changes to the color_filter only select tables and never require a rebuild;
+    // a changed model changes the kernel fingerprint, which invalidates any cached tables on disk
+    void loadLookupTable()
     {
-        // lock color_filter mutex
-        auto lock = quickdev::make_unique_lock( color_filter_mutex_ );
+        auto lookup_table = boost::make_shared<ColorLookupTable>();
+
+        if( !lookup_table_cache_uri_.empty() && lookup_table->load( lookup_table_cache_uri_, config_.get()->color_kernel_->getFingerprint() ) )
+        {
+            PRINT_INFO( "Mapped color lookup tables from %s", lookup_table_cache_uri_.c_str() );
+            setLookupTable( lookup_table );
+            return;
+        }
+
+        PRINT_INFO( "No valid color lookup table cache found; building tables in the background" );
+        build_lookup_table_thread_ptr_ = boost::make_shared<boost::thread>( &ColorClassifierNode::buildLookupTable, this );
+    }
+
+    void buildLookupTable()
+    {
+        auto const config = config_.get();
+
+        auto lookup_table = boost::make_shared<ColorLookupTable>();
+        lookup_table->build( *config->color_kernel_ );
+
+        if( !lookup_table_cache_uri_.empty() )
+        {
+            if( lookup_table->save( lookup_table_cache_uri_ ) ) PRINT_INFO( "Saved color lookup tables to %s", lookup_table_cache_uri_.c_str() );
+            else PRINT_WARN( "Failed to save color lookup tables to %s", lookup_table_cache_uri_.c_str() );
+        }
+
+        PRINT_INFO( "Color lookup tables ready for %zu colors", lookup_table->size() );
+        setLookupTable( lookup_table );
+    }
 
+    void setLookupTable( boost::shared_ptr<ColorLookupTable const> const & lookup_table )
+    {
+        updateConfig
+        (
+            [&]( ColorClassifierConfig & config )
+            {
+                // drop tables built for a model that has since been replaced
+                if( config.color_kernel_ && config.color_kernel_->getFingerprint() == lookup_table->getFingerprint() ) config.lookup_table_ = lookup_table;
+            }
+        );
+    }
+
+    QUICKDEV_DECLARE_ACTION_EXECUTE_CALLBACK( configureActionExecuteCB, _ConfigureAction )
+    {
         auto const & settings = goal->settings;
 
-        // update the color_filter
-        for( auto setting_it = settings.cbegin(); setting_it != settings.cend(); ++setting_it )
+        // update a copy of the color_filter; frames in flight keep using the old one
+        updateConfig
+        (
+            [&]( ColorClassifierConfig & config )
+            {
+                auto & color_filter = config.color_filter_;
+
+                for( auto setting_it = settings.cbegin(); setting_it != settings.cend(); ++setting_it )
+                {
+                    auto const & setting = *setting_it;
+
+                    if( setting.empty() ) continue;
+
+                    // reset the color_filter
+                    if( setting == "-all" ) color_filter.clear();
+                    // remove the given item; -<item>
+                    else if( setting.substr( 0, 1 ) == "-" ) color_filter.erase( setting.substr( 1 ) );
+                    // add the given item; +<item>
+                    else if( setting.substr( 0, 1 ) == "+" ) color_filter.insert( setting.substr( 1 ) );
+                    // default; add the given item <item>
+                    else color_filter.insert( setting );
+                }
+            }
+        );
+    }
+
+    //! Find the changed_tiles message with the given stamp; returns false if it hasn't arrived (or has already been discarded)
+    bool findChangedTiles( ros::Time const & stamp, ChangedTiles & changed_tiles )
+    {
+        auto lock = quickdev::make_unique_lock( changed_tiles_mutex_ );
+
+        for( auto msg_it = changed_tiles_msgs_.crbegin(); msg_it != changed_tiles_msgs_.crend(); ++msg_it )
+        {
+            if( ( *msg_it )->header.stamp == stamp ) return changed_tiles.fromMsg( **msg_it );
+        }
+
+        return false;
+    }
+
+    //! Convert the adaptation mask for the current frame into spans of pixels that need to be re-classified; returns false if no usable mask
+    bool updateActiveSpans( cv_bridge::CvImageConstPtr const & mask_msg, cv::Size const & size )
+    {
+        if( !mask_msg ) return false;
+
+        // the adaptation mask node publishes a tile summary of each mask; if it's here, there's no need to touch the mask's pixels
+        if( findChangedTiles( mask_msg->header.stamp, changed_tiles_ ) )
+        {
+            active_spans_.fromTiles( changed_tiles_, size, blur_size_ / 2 );
+            return true;
+        }
+
+        cv::Mat const & mask = mask_msg->image;
+        if( mask.empty() || mask.type() != CV_8UC1 ) return false;
+
+        // bring the mask down to classification resolution; area interpolation keeps any change within each block non-zero
+        cv::resize( mask, active_mask_, size, 0, 0, cv::INTER_AREA );
+
+        // a changed pixel affects every output pixel within the blur kernel, so grow the mask by the same amount
+        cv::dilate( active_mask_, active_mask_, cv::getStructuringElement( cv::MORPH_RECT, cv::Size( blur_size_, blur_size_ ) ) );
+
+        active_spans_.fromMask( active_mask_ );
+
+        return true;
+    }
+
+    //! Label each pixel in row y with the index (into the enabled colors) of its best-scoring color, and store that score as its confidence
+    void labelRow( size_t const & y, std::vector<cv::Mat *> const & enabled_classified_images )
+    {
+        uchar * label_row = label_image_.ptr<uchar>( y );
+        uchar * confidence_row = confidence_image_.ptr<uchar>( y );
+        size_t const width = label_image_.cols;
+
+        memset( label_row, seabee::_LabelMapMsg::LABEL_NONE, width );
+        memset( confidence_row, 0, width );
+
+        for( size_t i = 0; i < enabled_classified_images.size(); ++i )
         {
-            auto const & setting = *setting_it;
-
-            if( setting.empty() ) continue;
-
-            // reset the color_filter
-            if( setting == "-all" ) color_filter_.clear();
-            // remove the given item; -<item>
-            else if( setting.substr( 0, 1 ) == "-" ) color_filter_.erase( setting.substr( 1 ) );
-            // add the given item; +<item>
-            else if( setting.substr( 0, 1 ) == "+" ) color_filter_.insert( setting.substr( 1 ) );
-            // default; add the given item <item>
-            else color_filter_.insert( setting );
+            uchar const * score_row = enabled_classified_images[i]->ptr<uchar>( y );
+            for( size_t x = 0; x < width; ++x )
+            {
+                if( score_row[x] <= confidence_row[x] ) continue;
+
+                confidence_row[x] = score_row[x];
+                label_row[x] = i;
+            }
+        }
+
+        for( size_t x = 0; x < width; ++x )
+        {
+            if( confidence_row[x] < label_min_confidence_ ) label_row[x] = seabee::_LabelMapMsg::LABEL_NONE;
         }
     }
 
+    QUICKDEV_DECLARE_MESSAGE_CALLBACK( changedTilesCB, _ChangedTilesMsg )
+    {
+        auto lock = quickdev::make_unique_lock( changed_tiles_mutex_ );
+
+        // masks are matched to images within a few frames, so only the most recent few summaries are worth keeping
+        changed_tiles_msgs_.push_back( msg );
+        while( changed_tiles_msgs_.size() > 10 ) changed_tiles_msgs_.pop_front();
+    }
+
     void imagesCB( cv_bridge::CvImageConstPtr const & image_msg, cv_bridge::CvImageConstPtr const & mask_msg )
     {
 //        std::cout << "Getting image from message" << std::endl;
@@ -180,90 +481,111 @@ protected:
             return;
         }
         cv::Mat const & image = image_msg->image;
-        cv::Mat normalized_image;
-        cv::resize( image, normalized_image, cv::Size(), 0.5, 0.5 );
-        //image.copyTo( normalized_image );
-
-        cv::GaussianBlur( normalized_image, normalized_image, cv::Size( 15, 15 ), 3 );
-
-        cv::cvtColor( normalized_image, normalized_image, CV_BGR2HLS );
+        cv::Mat & normalized_image = normalized_image_;
 
+        // downscale by 2, blur, and convert to HLS in one pass
+        preprocessor_.process( image, normalized_image );
 
-//        std::cout << "Getting mask from message" << std::endl;
-/*        if( !mask_msg )
-        {
-            PRINT_WARN( "mask message is null" );
-//            return;
-        }
+        // a stable view of the color filter, models, and lookup tables for this frame; updates publish a new config rather than modifying
+        // this one, so no lock is needed
+        auto const config = config_.get();
+        if( !config->color_kernel_ ) return;
 
-        cv::Mat mask;
-        if( mask_msg ) mask = mask_msg->image;
-*/
-//        cv::Mat_<cv::Vec3b>::const_iterator current_image_pixel = image.begin<cv::Vec3b>();
-//        cv::Mat_<uchar>::const_iterator current_mask_pixel = mask.begin<uchar>();
+        auto const & color_ids = config->color_ids_;
+        auto const & enabled_color_names = config->color_names_;
 
-//        std::map<std::string, size_t> num_pixels_processed_map;
+        // collect the output images for all enabled colors
+        std::vector<cv::Mat *> enabled_classified_images;
+        bool outputs_reallocated = false;
 
-//        for( size_t x = 610; x < 616; ++x )
-        quickdev::make_unique_lock( color_filter_mutex_ );
-
-        size_t const & img_width = normalized_image.size().width;
-        size_t const & img_height = normalized_image.size().height;
-        for( size_t x = 0; x < img_width; ++x )
+        for( auto color_name_it = enabled_color_names.cbegin(); color_name_it != enabled_color_names.cend(); ++color_name_it )
         {
-//            for( size_t y = 209; y < 215; ++y )
-            for( size_t y = 0; y < img_height; ++y )
+            auto & classified_image = classified_images_[*color_name_it];
+            if( classified_image.size() != normalized_image.size() )
             {
-//                PRINT_INFO( "Checking mask %zu %zu", x, y );
-/*                if( mask_msg )
-                {
-                    auto const & mask_pixel = mask.at<uchar>( y, x );
-                    if( !mask_pixel ) continue;
-                }
-*/
-                auto const & raw_pixel = normalized_image.at<cv::Vec3b>( y, x );
-                auto const & pixel = quickdev::pixel::make_pixel<float>( raw_pixel );
-
-//                STREAM_INFO( pixel );
+                classified_image.create( normalized_image.size(), CV_8UC1 );
+                outputs_reallocated = true;
+            }
 
-                auto classified_image_it = classified_images_.begin();
-                for( auto target_color_it = target_colors_.cbegin(); target_color_it != target_colors_.cend(); ++target_color_it, ++classified_image_it )
-                {
-                    auto const & target_color_name = target_color_it->first;
-                    if( color_filter_.count( target_color_name ) == 0 ) continue;
+            enabled_classified_images.push_back( &classified_image );
+        }
 
-                    auto const & target_color = target_color_it->second;
-                    auto & classified_image = classified_image_it->second;
+        bool const publish_label_map = output_format_ != OUTPUT_IMAGES;
+        if( publish_label_map )
+        {
+            label_image_.create( normalized_image.size(), CV_8UC1 );
+            confidence_image_.create( normalized_image.size(), CV_8UC1 );
+        }
 
-                    if( classified_image.size() != normalized_image.size() ) classified_image.create( normalized_image.size(), CV_8UC1 );
+        // until the lookup tables are ready (or if they're disabled), fall back to the gaussian kernel
+        auto const & lookup_table = config->lookup_table_;
+        auto const & color_kernel = *config->color_kernel_;
+
+        // in sparse mode, cached values can only be reused if they were produced with the same settings
+        bool full_refresh = !sparse_classification_
+            || outputs_reallocated
+            || config->version_ != last_config_version_
+            || frames_since_full_refresh_ + 1 >= full_refresh_interval_
+            || !updateActiveSpans( mask_msg, normalized_image.size() );
+
+        last_config_version_ = config->version_;
+        frames_since_full_refresh_ = full_refresh ? 0 : frames_since_full_refresh_ + 1;
+
+        // score each row (or each active span of each row) against all enabled colors in one pass; each band of rows writes to disjoint rows
+        // of the output images, and every pixel is classified by the same code regardless of which thread handles it, so the result doesn't
+        // depend on the number of threads
+        worker_pool_->parallelFor
+        (
+            normalized_image.rows,
+            [&]( size_t const & row_begin, size_t const & row_end )
+            {
+                std::vector<uchar *> classified_image_rows( enabled_classified_images.size() );
 
-                    //auto const match_quality = 1.0 - 50 * pixel.distanceTo<quickdev::feature::mode::distance::GAUSSIAN>( target_color.mean_, target_color.covariance_, 50.0 );
-                    auto const match_quality = 1.0 - pixel.distanceTo<quickdev::feature::mode::distance::GAUSSIAN_FAST>( target_color.mean_, target_color.covariance_, 0.5 );
-                    classified_image.at<uchar>( y, x ) = std::numeric_limits<uchar>::max() * match_quality;
+                auto const classify_span = [&]( size_t const & y, int const & x_begin, int const & x_end )
+                {
+                    for( size_t i = 0; i < enabled_classified_images.size(); ++i )
+                    {
+                        classified_image_rows[i] = enabled_classified_images[i]->ptr<uchar>( y ) + x_begin;
+                    }
 
-//                    PRINT_INFO( "%zu %zu %f %u", x, y, match_quality, classified_image.at<uchar>( y, x ) );
+                    uchar const * src = normalized_image.ptr<uchar>( y ) + 3 * x_begin;
+                    size_t const width = x_end - x_begin;
 
-//                    if( num_pixels_processed_map.find( target_color_name ) == num_pixels_processed_map.end() ) num_pixels_processed_map[target_color_name] = 0;
+                    if( lookup_table ) lookup_table->classifyRow( src, width, color_ids.data(), classified_image_rows.data(), color_ids.size() );
+                    else color_kernel.classifyRow( src, width, color_ids.data(), classified_image_rows.data(), color_ids.size() );
+                };
 
-//                    num_pixels_processed_map[target_color_name] ++;
-                }
-/*
-                for( size_t i = 0; i < classified_images_.size(); ++i )
+                for( size_t y = row_begin; y < row_end; ++y )
                 {
-                    if( false ) continue;
-                    auto const & desired_color = seabee3_common::colors::PIXELS[i];
-                    quickdev::Feature<float> const sigma( 0.1f, 0.1f, 0.1f );
-                    classified_images_[i].at<uchar>( y, x ) = std::numeric_limits<uchar>::max() * pixel.distanceTo<quickdev::feature::mode::distance::GAUSSIAN>( desired_color, sigma, 1.0 );
+                    if( full_refresh ) classify_span( y, 0, normalized_image.cols );
+                    else
+                    {
+                        for( auto span = active_spans_.rowBegin( y ); span != active_spans_.rowEnd( y ); ++span )
+                        {
+                            classify_span( y, span->begin_, span->end_ );
+                        }
+                    }
+
+                    // labels are cheap to recompute, so always label the full row from the (partially cached) scores
+                    if( publish_label_map ) labelRow( y, enabled_classified_images );
                 }
-*/
             }
-        }
-/*
-        for( auto pixel_stats_it = num_pixels_processed_map.cbegin(); pixel_stats_it != num_pixels_processed_map.cend(); ++pixel_stats_it )
+        );
+
+        if( publish_label_map )
         {
-            PRINT_INFO( "Processed %f%% of candidate %s pixels", 100 * (float)pixel_stats_it->second / ( image.size().width * image.size().height ), pixel_stats_it->first.c_str() );
+            seabee::_LabelMapMsg label_map_msg;
+            label_map_msg.header = image_msg->header;
+            label_map_msg.color_names = enabled_color_names;
+            label_map_msg.scale = float( image.cols ) / normalized_image.cols;
+
+            seabee::encodeLabelMap( label_image_, confidence_image_, output_format_ == OUTPUT_LABEL_MAP_RLE, label_map_msg );
+
+            multi_pub_.publish( "label_map", label_map_msg );
+
+            return;
         }
-*/
+
         _NamedImageArrayMsg named_image_array_message;
         named_image_array_message.images.resize( classified_images_.size() );
 
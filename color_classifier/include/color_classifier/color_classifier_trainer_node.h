@@ -38,9 +38,20 @@
 
 #include <quickdev/node.h>
 
-#include <quickdev/gaussian_pdf.h>
 #include <quickdev/param_reader.h>
 
+// objects
+#include <color_classifier/color_statistics.h>
+#include <seabee3_common/worker_pool.h>
+#include <map>
+#include <vector>
+
+// utils
+#include <algorithm>
+#include <dirent.h>
+#include <fstream>
+#include <sstream>
+
 #include <opencv/cv.h>
 #include <opencv/highgui.h>
 //#include <opencv/imgproc.h>
@@ -49,6 +60,17 @@ QUICKDEV_DECLARE_NODE( ColorClassifierTrainer )
 
 QUICKDEV_DECLARE_NODE_CLASS( ColorClassifierTrainer )
 {
+protected:
+    struct TrainingPair
+    {
+        std::string src_image_uri_;
+        std::string mask_image_uri_;
+        std::string color_name_;
+    };
+
+    typedef std::map<std::string, ColorStatistics> _ColorStatisticsMap;
+
+public:
     QUICKDEV_DECLARE_NODE_CONSTRUCTOR( ColorClassifierTrainer )
     {
         //
@@ -58,87 +80,234 @@ QUICKDEV_DECLARE_NODE_CLASS( ColorClassifierTrainer )
     {
         QUICKDEV_GET_RUNABLE_NODEHANDLE( nh_rel );
 
-        typedef quickdev::GaussianPDF<3> _ColorModel;
-        typedef _ColorModel::_DataPoint _DataPoint;
-
         auto src_image_uri = ros::ParamReader<std::string, 1>::readParam( nh_rel, "src_image_uri", "" );
         auto mask_image_uri = ros::ParamReader<std::string, 1>::readParam( nh_rel, "mask_image_uri", "" );
         auto color_name = ros::ParamReader<std::string, 1>::readParam( nh_rel, "color_name", "" );
 
+        // batch mode: train every color found in a folder of <frame>_<color>_mask.<ext> files, or listed in a manifest
+        auto const batch_folder = ros::ParamReader<std::string, 1>::readParam( nh_rel, "batch_folder", "" );
+        auto const batch_manifest_uri = ros::ParamReader<std::string, 1>::readParam( nh_rel, "batch_manifest_uri", "" );
+        auto const num_threads = ros::ParamReader<int, 1>::readParam( nh_rel, "num_threads", 1 );
+        auto const write_full_covariance = ros::ParamReader<bool, 1>::readParam( nh_rel, "write_full_covariance", false );
+
         initPolicies<quickdev::policy::ALL>();
 
-        // load color
-        cv::Mat const input_image = cv::imread( src_image_uri );
-        // load grayscale
-        cv::Mat const mask_image = cv::imread( mask_image_uri, 0 );
+        std::vector<TrainingPair> training_pairs;
 
-        if( input_image.empty() )
+        if( !batch_folder.empty() ) training_pairs = findTrainingPairs( batch_folder );
+        else if( !batch_manifest_uri.empty() ) training_pairs = readTrainingManifest( batch_manifest_uri );
+        else
         {
-            PRINT_ERROR( "Input image is empty; exiting" );
+            TrainingPair training_pair;
+            training_pair.src_image_uri_ = src_image_uri;
+            training_pair.mask_image_uri_ = mask_image_uri;
+            training_pair.color_name_ = color_name;
+            training_pairs.push_back( training_pair );
+        }
+
+        // in batch mode, color_name (if set) restricts training to a single color
+        if( !color_name.empty() )
+        {
+            std::vector<TrainingPair> filtered_training_pairs;
+            for( auto training_pair_it = training_pairs.cbegin(); training_pair_it != training_pairs.cend(); ++training_pair_it )
+            {
+                if( training_pair_it->color_name_ == color_name ) filtered_training_pairs.push_back( *training_pair_it );
+            }
+            training_pairs.swap( filtered_training_pairs );
+        }
+
+        if( training_pairs.empty() )
+        {
+            PRINT_ERROR( "No training images found; exiting" );
             exit( 1 );
         }
 
-        if( mask_image.empty() )
+        PRINT_INFO( "Training on %zu image/mask pairs with %i thread(s)", training_pairs.size(), std::max( num_threads, 1 ) );
+
+        // each pair gets its own statistics, which are merged in order afterward so the result doesn't depend on the number of threads;
+        // only the per-pair summaries are kept, never the pixels themselves
+        std::vector<ColorStatistics> pair_statistics( training_pairs.size() );
+        std::vector<char> pair_loaded( training_pairs.size(), false );
+
+        seabee::WorkerPool worker_pool( std::max( num_threads, 1 ) );
+        worker_pool.parallelFor
+        (
+            training_pairs.size(),
+            [&]( size_t const & pair_begin, size_t const & pair_end )
+            {
+                for( size_t i = pair_begin; i < pair_end; ++i )
+                {
+                    pair_loaded[i] = accumulatePair( training_pairs[i], pair_statistics[i] );
+                }
+            }
+        );
+
+        _ColorStatisticsMap color_statistics;
+        for( size_t i = 0; i < training_pairs.size(); ++i )
         {
-            PRINT_ERROR( "Mask image is empty; exiting" );
+            if( !pair_loaded[i] )
+            {
+                PRINT_WARN( "Skipping %s / %s", training_pairs[i].src_image_uri_.c_str(), training_pairs[i].mask_image_uri_.c_str() );
+                continue;
+            }
+
+            color_statistics[training_pairs[i].color_name_].merge( pair_statistics[i] );
+        }
+
+        // as with a single pair that fails to load, don't overwrite the model with nothing
+        if( color_statistics.empty() )
+        {
+            PRINT_ERROR( "None of the %zu image/mask pairs could be loaded; exiting", training_pairs.size() );
             exit( 1 );
         }
 
+        for( auto color_statistics_it = color_statistics.cbegin(); color_statistics_it != color_statistics.cend(); ++color_statistics_it )
+        {
+            auto const & color_name = color_statistics_it->first;
+            auto const & statistics = color_statistics_it->second;
+
+            std::cout << "Sampling " << color_name << " from " << statistics.size() << " data points." << std::endl;
+
+            if( !statistics.size() ) continue;
+
+            // Output mean and variance (and optionally the full covariance, row-major)
+            XmlRpc::XmlRpcValue mean_param;
+            XmlRpc::XmlRpcValue cov_param;
+            XmlRpc::XmlRpcValue full_cov_param;
+
+            for( size_t i = 0; i < ColorStatistics::NUM_CHANNELS; ++i )
+            {
+                mean_param[i] = statistics.getMean( i );
+                cov_param[i] = statistics.getCovariance( i, i );
+
+                for( size_t j = 0; j < ColorStatistics::NUM_CHANNELS; ++j )
+                {
+                    full_cov_param[i * ColorStatistics::NUM_CHANNELS + j] = statistics.getCovariance( i, j );
+                }
+            }
+
+            std::cout << " - mean: " << mean_param << std::endl;
+            std::cout << " - cov: " << full_cov_param << std::endl;
+
+            nh_rel.setParam( "model/" + color_name + "/mean", mean_param );
+            nh_rel.setParam( "model/" + color_name + "/cov", cov_param );
+            if( write_full_covariance ) nh_rel.setParam( "model/" + color_name + "/full_cov", full_cov_param );
+        }
+
+        auto const dump_result = system( std::string( "rosparam dump `rospack find color_classifier`/params/model.yaml /color_classifier_trainer/model/" ).c_str() );
+    }
+
+    //! Load one image/mask pair and accumulate the HLS values of its masked pixels; thread-safe
+    bool accumulatePair( TrainingPair const & training_pair, ColorStatistics & statistics )
+    {
+        // load color
+        cv::Mat const input_image = cv::imread( training_pair.src_image_uri_ );
+        // load grayscale
+        cv::Mat const mask_image = cv::imread( training_pair.mask_image_uri_, 0 );
+
+        if( input_image.empty() || mask_image.empty() || input_image.size() != mask_image.size() ) return false;
+
         // convert to target color space
         cv::Mat input_image_hls;
         cv::cvtColor( input_image, input_image_hls, CV_BGR2HLS );
 
-        // build up our color model
-        _ColorModel color_model_;
+        ColorStatistics::Moments moments;
 
-        for( int y = 0; y < mask_image.size().height; y++ )
+        for( int y = 0; y < mask_image.rows; ++y )
         {
-            for( int x = 0; x < mask_image.size().width; x++ )
-            {
-                auto const & mask_pixel = mask_image.at<unsigned char>( y, x );
+            unsigned char const * mask_row = mask_image.ptr<unsigned char>( y );
+            unsigned char const * hls_row = input_image_hls.ptr<unsigned char>( y );
 
+            for( int x = 0; x < mask_image.cols; ++x )
+            {
                 // ignore "black" mask pixels
-                if( mask_pixel <= 255 / 2 ) continue;
+                if( mask_row[x] <= 255 / 2 ) continue;
 
-                auto const & hls_pixel = input_image_hls.at<cv::Vec3b>( y, x );
-                color_model_.push_back( _DataPoint( (double)hls_pixel[0], (double)hls_pixel[1], (double)hls_pixel[2] ) );
+                moments.add( hls_row + 3 * x );
             }
         }
 
-        std::cout << "Sampling from " << color_model_.size() << " data points." << std::endl;
+        statistics.add( moments );
 
-        auto const & mean = color_model_.updateMean();
-        auto const & covariance = color_model_.updateCovariance();
+        return true;
+    }
 
-        std::cout << mean << std::endl;
+    //! Find all <frame>_<color>_mask.<ext> files in folder, each paired with <frame>.<ext>
+    std::vector<TrainingPair> findTrainingPairs( std::string const & folder )
+    {
+        std::vector<TrainingPair> training_pairs;
 
-        std::cout << covariance << std::endl;
+        DIR * dir = opendir( folder.c_str() );
+        if( !dir )
+        {
+            PRINT_ERROR( "Failed to open folder %s", folder.c_str() );
+            return training_pairs;
+        }
 
-        // Output mean and variance (not full covariance)
-        XmlRpc::XmlRpcValue mean_param;
-        XmlRpc::XmlRpcValue cov_param;
+        std::string const mask_suffix = "_mask";
 
-        for( size_t i = 0; i < mean.size(); ++i )
+        while( struct dirent * entry = readdir( dir ) )
         {
-            mean_param[i] = mean[i];
-            cov_param[i] = covariance( i, i );
+            std::string const filename( entry->d_name );
+
+            // <frame>_<color>_mask.<ext>
+            auto const ext_pos = filename.rfind( '.' );
+            if( ext_pos == std::string::npos || ext_pos < mask_suffix.size() || filename.compare( ext_pos - mask_suffix.size(), mask_suffix.size(), mask_suffix ) != 0 ) continue;
+
+            auto const stem = filename.substr( 0, ext_pos - mask_suffix.size() );
+            auto const color_pos = stem.rfind( '_' );
+            if( color_pos == std::string::npos || color_pos == 0 ) continue;
+
+            TrainingPair training_pair;
+            training_pair.src_image_uri_ = folder + "/" + stem.substr( 0, color_pos ) + filename.substr( ext_pos );
+            training_pair.mask_image_uri_ = folder + "/" + filename;
+            training_pair.color_name_ = stem.substr( color_pos + 1 );
+
+            training_pairs.push_back( training_pair );
         }
 
-        nh_rel.setParam( "model/" + color_name + "/mean", mean_param );
+        closedir( dir );
 
-        nh_rel.setParam( "model/" + color_name + "/cov", cov_param );
+        // readdir order is arbitrary; sort so repeated runs merge in the same order
+        std::sort
+        (
+            training_pairs.begin(),
+            training_pairs.end(),
+            []( TrainingPair const & a, TrainingPair const & b ){ return a.mask_image_uri_ < b.mask_image_uri_; }
+        );
+
+        return training_pairs;
+    }
+
+    //! Read a manifest with one "<src_image_uri> <mask_image_uri> <color_name>" entry per line; blank lines and lines starting with # are ignored
+    std::vector<TrainingPair> readTrainingManifest( std::string const & manifest_uri )
+    {
+        std::vector<TrainingPair> training_pairs;
 
-/* Output full covariance
-        for( size_t i = 0; i < covariance.size(); ++i )
+        std::ifstream manifest( manifest_uri.c_str() );
+        if( !manifest )
         {
-            std::stringstream index_ss;
-            index_ss << i;
-            auto const index_str = index_ss.str();
+            PRINT_ERROR( "Failed to open manifest %s", manifest_uri.c_str() );
+            return training_pairs;
+        }
+
+        std::string line;
+        while( std::getline( manifest, line ) )
+        {
+            if( line.empty() || line[0] == '#' ) continue;
+
+            TrainingPair training_pair;
+            std::istringstream line_stream( line );
+            if( !( line_stream >> training_pair.src_image_uri_ >> training_pair.mask_image_uri_ >> training_pair.color_name_ ) )
+            {
+                PRINT_WARN( "Ignoring malformed manifest line: %s", line.c_str() );
+                continue;
+            }
 
-            nh_rel.setParam( "model/" + color_name + "/cov/elem" + index_str, covariance[i] );
+            training_pairs.push_back( training_pair );
         }
-*/
-        auto const dump_result = system( std::string( "rosparam dump `rospack find color_classifier`/params/model.yaml /color_classifier_trainer/model/" ).c_str() );
+
+        return training_pairs;
     }
 
     QUICKDEV_SPIN_ONCE()
@@ -0,0 +1,290 @@
+/***************************************************************************
+ *  include/color_classifier/color_lookup_table.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef COLORCLASSIFIER_COLORLOOKUPTABLE_H_
+#define COLORCLASSIFIER_COLORLOOKUPTABLE_H_
+
+// objects
+#include <color_classifier/gaussian_color_kernel.h>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/lexical_cast.hpp>
+#include <string>
+#include <vector>
+
+// utils
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// =============================================================================================================================================
+//! Precomputed HLS -> score tables for every color in a GaussianColorKernel
+/*!
+ * - Each channel is quantized to BITS_PER_CHANNEL bits, so each color's table holds BINS_PER_CHANNEL^3 scores and classifying a pixel
+ *   against a color is a single table read
+ * - Table entries are produced by running the kernel itself on the center of each bin, so both paths share one scoring function
+ * - Tables can be saved to disk and memory-mapped back in; the file is tagged with the kernel's fingerprint so a cache built from a
+ *   different model is rejected rather than silently used
+ */
+class ColorLookupTable : boost::noncopyable
+{
+public:
+    typedef unsigned char _Byte;
+
+    static size_t const BITS_PER_CHANNEL = 6;
+    static size_t const BINS_PER_CHANNEL = 1 << BITS_PER_CHANNEL;
+    static size_t const CHANNEL_SHIFT = 8 - BITS_PER_CHANNEL;
+    static size_t const TABLE_SIZE = BINS_PER_CHANNEL * BINS_PER_CHANNEL * BINS_PER_CHANNEL;
+    static uint32_t const FILE_VERSION = 1;
+
+protected:
+    struct FileHeader
+    {
+        char magic_[8];
+        uint32_t version_;
+        uint32_t bits_per_channel_;
+        uint64_t num_colors_;
+        uint64_t fingerprint_;
+    };
+
+    uint64_t fingerprint_;
+    size_t num_colors_;
+
+    //! Points into either owned_tables_ or mapped_region_
+    _Byte const * tables_;
+    std::vector<_Byte> owned_tables_;
+
+    void * mapped_region_;
+    size_t mapped_size_;
+
+public:
+    ColorLookupTable()
+    :
+        fingerprint_( 0 ),
+        num_colors_( 0 ),
+        tables_( NULL ),
+        mapped_region_( NULL ),
+        mapped_size_( 0 )
+    {
+        //
+    }
+
+    ~ColorLookupTable()
+    {
+        unmap();
+    }
+
+    //! Fill in the tables for every color in the given kernel
+    void build( GaussianColorKernel const & kernel )
+    {
+        unmap();
+
+        num_colors_ = kernel.size();
+        fingerprint_ = kernel.getFingerprint();
+        owned_tables_.resize( num_colors_ * TABLE_SIZE );
+        tables_ = owned_tables_.data();
+
+        if( !num_colors_ ) return;
+
+        std::vector<size_t> color_ids( num_colors_ );
+        for( size_t color_id = 0; color_id < num_colors_; ++color_id )
+        {
+            color_ids[color_id] = color_id;
+        }
+
+        // one row of bin centers, varying s
+        size_t const row_width = BINS_PER_CHANNEL;
+        std::vector<_Byte> bin_centers( 3 * row_width );
+        std::vector<_Byte *> table_rows( num_colors_ );
+
+        for( size_t h_bin = 0; h_bin < BINS_PER_CHANNEL; ++h_bin )
+        {
+            // building every table takes a while; let a background build be cancelled between planes
+            boost::this_thread::interruption_point();
+
+            for( size_t l_bin = 0; l_bin < BINS_PER_CHANNEL; ++l_bin )
+            {
+                for( size_t s_bin = 0; s_bin < BINS_PER_CHANNEL; ++s_bin )
+                {
+                    bin_centers[3 * s_bin + 0] = getBinCenter( h_bin );
+                    bin_centers[3 * s_bin + 1] = getBinCenter( l_bin );
+                    bin_centers[3 * s_bin + 2] = getBinCenter( s_bin );
+                }
+
+                size_t const row_offset = getIndex( h_bin, l_bin, 0 );
+                for( size_t color_id = 0; color_id < num_colors_; ++color_id )
+                {
+                    table_rows[color_id] = owned_tables_.data() + color_id * TABLE_SIZE + row_offset;
+                }
+
+                kernel.classifyRow( bin_centers.data(), row_width, color_ids.data(), table_rows.data(), num_colors_ );
+            }
+        }
+    }
+
+    //! Memory-map a table file previously written by save(); fails if the file does not match the given kernel fingerprint
+    bool load( std::string const & uri, uint64_t const & expected_fingerprint )
+    {
+        unmap();
+
+        int const fd = open( uri.c_str(), O_RDONLY );
+        if( fd < 0 ) return false;
+
+        struct stat file_stat;
+        if( fstat( fd, &file_stat ) != 0 || static_cast<size_t>( file_stat.st_size ) < sizeof( FileHeader ) )
+        {
+            close( fd );
+            return false;
+        }
+
+        size_t const file_size = file_stat.st_size;
+        void * const region = mmap( NULL, file_size, PROT_READ, MAP_SHARED, fd, 0 );
+        // the mapping holds its own reference to the file
+        close( fd );
+
+        if( region == MAP_FAILED ) return false;
+
+        FileHeader header;
+        memcpy( &header, region, sizeof( header ) );
+
+        FileHeader expected_header = makeHeader( header.num_colors_, expected_fingerprint );
+
+        if( memcmp( &header, &expected_header, sizeof( header ) ) != 0 || file_size != sizeof( FileHeader ) + header.num_colors_ * TABLE_SIZE )
+        {
+            munmap( region, file_size );
+            return false;
+        }
+
+        mapped_region_ = region;
+        mapped_size_ = file_size;
+        num_colors_ = header.num_colors_;
+        fingerprint_ = header.fingerprint_;
+        tables_ = static_cast<_Byte const *>( region ) + sizeof( FileHeader );
+
+        return true;
+    }
+
+    //! Write the tables to disk; the file is written under a temporary name and then renamed so readers never see a partial file
+    bool save( std::string const & uri ) const
+    {
+        // unique per process, so two nodes sharing a cache never write to the same temporary file
+        std::string const tmp_uri = uri + ".tmp." + boost::lexical_cast<std::string>( getpid() );
+
+        FILE * file = fopen( tmp_uri.c_str(), "wb" );
+        if( !file ) return false;
+
+        FileHeader const header = makeHeader( num_colors_, fingerprint_ );
+
+        bool success = fwrite( &header, sizeof( header ), 1, file ) == 1;
+        if( success && num_colors_ ) success = fwrite( tables_, TABLE_SIZE, num_colors_, file ) == num_colors_;
+        // make sure the data is on disk before the rename makes it visible
+        success = success && fflush( file ) == 0 && fsync( fileno( file ) ) == 0;
+        success = ( fclose( file ) == 0 ) && success;
+
+        if( success ) success = rename( tmp_uri.c_str(), uri.c_str() ) == 0;
+        if( !success ) remove( tmp_uri.c_str() );
+
+        return success;
+    }
+
+    uint64_t getFingerprint() const
+    {
+        return fingerprint_;
+    }
+
+    size_t size() const
+    {
+        return num_colors_;
+    }
+
+    bool isMapped() const
+    {
+        return mapped_region_ != NULL;
+    }
+
+    //! Same interface as GaussianColorKernel::classifyRow()
+    void classifyRow( _Byte const * src, size_t const & width, size_t const * color_ids, _Byte * const * dst, size_t const & num_colors ) const
+    {
+        for( size_t color_idx = 0; color_idx < num_colors; ++color_idx )
+        {
+            _Byte const * table = tables_ + color_ids[color_idx] * TABLE_SIZE;
+            _Byte * dst_pixel = dst[color_idx];
+            _Byte const * src_pixel = src;
+
+            for( size_t x = 0; x < width; ++x, src_pixel += 3 )
+            {
+                dst_pixel[x] = table[getIndex( src_pixel[0] >> CHANNEL_SHIFT, src_pixel[1] >> CHANNEL_SHIFT, src_pixel[2] >> CHANNEL_SHIFT )];
+            }
+        }
+    }
+
+protected:
+    static size_t getIndex( size_t const & h_bin, size_t const & l_bin, size_t const & s_bin )
+    {
+        return ( h_bin << ( 2 * BITS_PER_CHANNEL ) ) | ( l_bin << BITS_PER_CHANNEL ) | s_bin;
+    }
+
+    static _Byte getBinCenter( size_t const & bin )
+    {
+        return ( bin << CHANNEL_SHIFT ) + ( ( 1 << CHANNEL_SHIFT ) >> 1 );
+    }
+
+    static FileHeader makeHeader( uint64_t const & num_colors, uint64_t const & fingerprint )
+    {
+        FileHeader header;
+        memset( &header, 0, sizeof( header ) );
+        strncpy( header.magic_, "CCLUT", sizeof( header.magic_ ) );
+        header.version_ = FILE_VERSION;
+        header.bits_per_channel_ = BITS_PER_CHANNEL;
+        header.num_colors_ = num_colors;
+        header.fingerprint_ = fingerprint;
+
+        return header;
+    }
+
+    void unmap()
+    {
+        if( mapped_region_ ) munmap( mapped_region_, mapped_size_ );
+
+        mapped_region_ = NULL;
+        mapped_size_ = 0;
+        tables_ = owned_tables_.data();
+    }
+};
+
+#endif // COLORCLASSIFIER_COLORLOOKUPTABLE_H_
@@ -0,0 +1,175 @@
+/***************************************************************************
+ *  include/color_classifier/color_statistics.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef COLORCLASSIFIER_COLORSTATISTICS_H_
+#define COLORCLASSIFIER_COLORSTATISTICS_H_
+
+// objects
+#include <stdint.h>
+#include <cstddef>
+
+// =============================================================================================================================================
+//! Running mean and full covariance of 3-channel color samples, in constant memory
+/*! - Samples are added as integer moments of a whole image (or any other batch) at once
+ *  - Two sets of statistics can be merged (Chan et al.), so images can be processed in parallel and combined afterward
+ *  - Merging in a fixed order gives the same result regardless of how the work was split up */
+class ColorStatistics
+{
+public:
+    static size_t const NUM_CHANNELS = 3;
+
+    //! Exact integer sums over a set of 8-bit pixels; cheap to accumulate in an inner loop
+    struct Moments
+    {
+        uint64_t count_;
+        uint64_t sums_[NUM_CHANNELS];
+        uint64_t products_[NUM_CHANNELS][NUM_CHANNELS];
+
+        Moments()
+        {
+            clear();
+        }
+
+        void clear()
+        {
+            count_ = 0;
+            for( size_t i = 0; i < NUM_CHANNELS; ++i )
+            {
+                sums_[i] = 0;
+                for( size_t j = 0; j < NUM_CHANNELS; ++j ) products_[i][j] = 0;
+            }
+        }
+
+        void add( unsigned char const * pixel )
+        {
+            ++count_;
+            for( size_t i = 0; i < NUM_CHANNELS; ++i )
+            {
+                sums_[i] += pixel[i];
+                for( size_t j = i; j < NUM_CHANNELS; ++j ) products_[i][j] += pixel[i] * pixel[j];
+            }
+        }
+    };
+
+protected:
+    uint64_t count_;
+    double mean_[NUM_CHANNELS];
+    //! Sum of products of deviations from the mean
+    double comoment_[NUM_CHANNELS][NUM_CHANNELS];
+
+public:
+    ColorStatistics()
+    :
+        count_( 0 )
+    {
+        for( size_t i = 0; i < NUM_CHANNELS; ++i )
+        {
+            mean_[i] = 0;
+            for( size_t j = 0; j < NUM_CHANNELS; ++j ) comoment_[i][j] = 0;
+        }
+    }
+
+    //! Add all samples summarized by moments
+    void add( Moments const & moments )
+    {
+        if( !moments.count_ ) return;
+
+        // the integer sums are exact, so the mean and comoment of this batch can be computed directly without cancellation issues
+        ColorStatistics batch;
+        batch.count_ = moments.count_;
+
+        for( size_t i = 0; i < NUM_CHANNELS; ++i )
+        {
+            batch.mean_[i] = double( moments.sums_[i] ) / moments.count_;
+        }
+
+        for( size_t i = 0; i < NUM_CHANNELS; ++i )
+        {
+            for( size_t j = i; j < NUM_CHANNELS; ++j )
+            {
+                // sum( x_i x_j ) - sum( x_i ) sum( x_j ) / n, computed in integers as far as possible
+                double const comoment = double( moments.products_[i][j] ) - double( moments.sums_[i] ) * double( moments.sums_[j] ) / moments.count_;
+                batch.comoment_[i][j] = batch.comoment_[j][i] = comoment;
+            }
+        }
+
+        merge( batch );
+    }
+
+    //! Combine with another set of statistics, as if all of its samples had been added to this one
+    void merge( ColorStatistics const & other )
+    {
+        if( !other.count_ ) return;
+
+        uint64_t const count = count_ + other.count_;
+        double const weight = double( count_ ) * other.count_ / count;
+
+        double delta[NUM_CHANNELS];
+        for( size_t i = 0; i < NUM_CHANNELS; ++i )
+        {
+            delta[i] = other.mean_[i] - mean_[i];
+        }
+
+        for( size_t i = 0; i < NUM_CHANNELS; ++i )
+        {
+            for( size_t j = 0; j < NUM_CHANNELS; ++j ) comoment_[i][j] += other.comoment_[i][j] + delta[i] * delta[j] * weight;
+        }
+
+        for( size_t i = 0; i < NUM_CHANNELS; ++i )
+        {
+            mean_[i] += delta[i] * other.count_ / count;
+        }
+
+        count_ = count;
+    }
+
+    uint64_t size() const
+    {
+        return count_;
+    }
+
+    double getMean( size_t const & i ) const
+    {
+        return mean_[i];
+    }
+
+    //! Sample covariance between channels i and j
+    double getCovariance( size_t const & i, size_t const & j ) const
+    {
+        return count_ > 1 ? comoment_[i][j] / ( count_ - 1 ) : 0;
+    }
+};
+
+#endif // COLORCLASSIFIER_COLORSTATISTICS_H_
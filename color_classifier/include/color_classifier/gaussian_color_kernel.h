@@ -0,0 +1,314 @@
+/***************************************************************************
+ *  include/color_classifier/gaussian_color_kernel.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef COLORCLASSIFIER_GAUSSIANCOLORKERNEL_H_
+#define COLORCLASSIFIER_GAUSSIANCOLORKERNEL_H_
+
+// objects
+#include <vector>
+#include <array>
+#include <stdint.h>
+
+// utils
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined( __AVX__ )
+#include <immintrin.h>
+#elif defined( __SSE2__ )
+#include <emmintrin.h>
+#endif
+
+// =============================================================================================================================================
+//! Scores HLS pixels against a set of diagonal-covariance gaussian color models
+/*!
+ * - Pixels are processed one row at a time, in strips of STRIP_SIZE pixels; each strip is de-interleaved into planar float buffers once
+ *   and then scored against every requested color before moving on, so the source row is only read once regardless of the number of colors
+ * - The squared mahalanobis distance for each pixel is computed with AVX or SSE2 when available (scalar otherwise) and mapped to an output
+ *   value in [0, 255] through a small lookup table of 255 * exp( -d^2 / 2 )
+ * - Hue is treated as circular over the 8-bit OpenCV HLS range [0, 180)
+ */
+class GaussianColorKernel
+{
+public:
+    typedef unsigned char _Byte;
+
+    static size_t const STRIP_SIZE = 64;
+    static size_t const RESPONSE_LUT_SIZE = 4096;
+    //! Squared distances at or beyond this value always map to a response of 0
+    static constexpr float MAX_DISTANCE_SQUARED = 16.0f;
+    static constexpr float HUE_RANGE = 180.0f;
+
+protected:
+    std::vector<float> mean_h_;
+    std::vector<float> mean_l_;
+    std::vector<float> mean_s_;
+    std::vector<float> inv_var_h_;
+    std::vector<float> inv_var_l_;
+    std::vector<float> inv_var_s_;
+
+    std::array<_Byte, RESPONSE_LUT_SIZE> response_lut_;
+
+    bool simd_enabled_;
+
+public:
+    GaussianColorKernel( bool const & simd_enabled = true )
+    :
+        simd_enabled_( simd_enabled )
+    {
+        float const lut_scale = RESPONSE_LUT_SIZE / MAX_DISTANCE_SQUARED;
+        for( size_t i = 0; i < RESPONSE_LUT_SIZE; ++i )
+        {
+            response_lut_[i] = std::numeric_limits<_Byte>::max() * exp( -0.5 * i / lut_scale ) + 0.5;
+        }
+    }
+
+    void clear()
+    {
+        mean_h_.clear();
+        mean_l_.clear();
+        mean_s_.clear();
+        inv_var_h_.clear();
+        inv_var_l_.clear();
+        inv_var_s_.clear();
+    }
+
+    //! Add a color given its mean and per-channel variance in HLS order; returns the id of the new color
+    template<class __Mean, class __Variance>
+    size_t addColor( __Mean const & mean, __Variance const & variance )
+    {
+        mean_h_.push_back( mean[0] );
+        mean_l_.push_back( mean[1] );
+        mean_s_.push_back( mean[2] );
+        inv_var_h_.push_back( invertVariance( variance[0] ) );
+        inv_var_l_.push_back( invertVariance( variance[1] ) );
+        inv_var_s_.push_back( invertVariance( variance[2] ) );
+
+        return mean_h_.size() - 1;
+    }
+
+    size_t size() const
+    {
+        return mean_h_.size();
+    }
+
+    //! A 64-bit FNV-1a hash of everything that affects the output of this kernel; used to detect stale caches of its results
+    uint64_t getFingerprint() const
+    {
+        uint64_t fingerprint = 14695981039346656037ULL;
+
+        auto const hash_bytes = [&fingerprint]( void const * data, size_t const & size )
+        {
+            _Byte const * bytes = static_cast<_Byte const *>( data );
+            for( size_t i = 0; i < size; ++i )
+            {
+                fingerprint ^= bytes[i];
+                fingerprint *= 1099511628211ULL;
+            }
+        };
+
+        std::vector<float> const * params[] = { &mean_h_, &mean_l_, &mean_s_, &inv_var_h_, &inv_var_l_, &inv_var_s_ };
+        for( size_t i = 0; i < sizeof( params ) / sizeof( params[0] ); ++i )
+        {
+            if( !params[i]->empty() ) hash_bytes( params[i]->data(), params[i]->size() * sizeof( float ) );
+        }
+        hash_bytes( response_lut_.data(), response_lut_.size() );
+
+        return fingerprint;
+    }
+
+    void setSimdEnabled( bool const & simd_enabled )
+    {
+        simd_enabled_ = simd_enabled;
+    }
+
+    //! Whether this kernel was compiled with a vectorized code path
+    static bool simdAvailable()
+    {
+#if defined( __AVX__ ) || defined( __SSE2__ )
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    //! Score one row of 8-bit HLS pixels against the given colors
+    /*!
+     * \param src pointer to width interleaved HLS pixels
+     * \param width number of pixels in the row
+     * \param color_ids ids of the colors to score, as returned by addColor()
+     * \param dst one output row of width bytes for each entry in color_ids
+     * \param num_colors number of entries in color_ids and dst
+     */
+    void classifyRow( _Byte const * src, size_t const & width, size_t const * color_ids, _Byte * const * dst, size_t const & num_colors ) const
+    {
+        if( !num_colors ) return;
+
+        float h[STRIP_SIZE] __attribute__(( aligned( 32 ) ));
+        float l[STRIP_SIZE] __attribute__(( aligned( 32 ) ));
+        float s[STRIP_SIZE] __attribute__(( aligned( 32 ) ));
+        int lut_idx[STRIP_SIZE] __attribute__(( aligned( 32 ) ));
+
+        for( size_t strip_start = 0; strip_start < width; strip_start += STRIP_SIZE )
+        {
+            size_t const strip_width = std::min<size_t>( width - strip_start, size_t( STRIP_SIZE ) );
+
+            // de-interleave this strip once for all colors
+            _Byte const * src_pixel = src + 3 * strip_start;
+            for( size_t i = 0; i < strip_width; ++i, src_pixel += 3 )
+            {
+                h[i] = src_pixel[0];
+                l[i] = src_pixel[1];
+                s[i] = src_pixel[2];
+            }
+
+            for( size_t color_idx = 0; color_idx < num_colors; ++color_idx )
+            {
+                size_t const & color_id = color_ids[color_idx];
+
+                if( simd_enabled_ ) distanceStripSimd( h, l, s, strip_width, color_id, lut_idx );
+                else distanceStripScalar( h, l, s, 0, strip_width, color_id, lut_idx );
+
+                _Byte * dst_pixel = dst[color_idx] + strip_start;
+                for( size_t i = 0; i < strip_width; ++i )
+                {
+                    dst_pixel[i] = response_lut_[lut_idx[i]];
+                }
+            }
+        }
+    }
+
+protected:
+    static float invertVariance( double const & variance )
+    {
+        // guard against degenerate models; a zero variance would otherwise produce inf * 0 = NaN for exact matches
+        return 1.0f / std::max( static_cast<float>( variance ), 1e-6f );
+    }
+
+    //! Compute response lookup-table indices for pixels [begin, end) of a strip
+    void distanceStripScalar( float const * h, float const * l, float const * s, size_t const & begin, size_t const & end, size_t const & color_id, int * lut_idx ) const
+    {
+        float const lut_scale = RESPONSE_LUT_SIZE / MAX_DISTANCE_SQUARED;
+        float const lut_max = RESPONSE_LUT_SIZE - 1;
+
+        float const mean_h = mean_h_[color_id];
+        float const mean_l = mean_l_[color_id];
+        float const mean_s = mean_s_[color_id];
+        float const inv_var_h = inv_var_h_[color_id];
+        float const inv_var_l = inv_var_l_[color_id];
+        float const inv_var_s = inv_var_s_[color_id];
+
+        for( size_t i = begin; i < end; ++i )
+        {
+            float dh = std::fabs( h[i] - mean_h );
+            dh = std::min( dh, HUE_RANGE - dh );
+            float const dl = l[i] - mean_l;
+            float const ds = s[i] - mean_s;
+
+            float const distance_squared = dh * dh * inv_var_h + dl * dl * inv_var_l + ds * ds * inv_var_s;
+
+            lut_idx[i] = static_cast<int>( std::min( distance_squared * lut_scale + 0.5f, lut_max ) );
+        }
+    }
+
+    void distanceStripSimd( float const * h, float const * l, float const * s, size_t const & width, size_t const & color_id, int * lut_idx ) const
+    {
+        size_t i = 0;
+
+#if defined( __AVX__ )
+        __m256 const lut_scale = _mm256_set1_ps( RESPONSE_LUT_SIZE / MAX_DISTANCE_SQUARED );
+        __m256 const lut_max = _mm256_set1_ps( RESPONSE_LUT_SIZE - 1 );
+        __m256 const half = _mm256_set1_ps( 0.5f );
+        __m256 const hue_range = _mm256_set1_ps( HUE_RANGE );
+        __m256 const abs_mask = _mm256_castsi256_ps( _mm256_set1_epi32( 0x7fffffff ) );
+
+        __m256 const mean_h = _mm256_set1_ps( mean_h_[color_id] );
+        __m256 const mean_l = _mm256_set1_ps( mean_l_[color_id] );
+        __m256 const mean_s = _mm256_set1_ps( mean_s_[color_id] );
+        __m256 const inv_var_h = _mm256_set1_ps( inv_var_h_[color_id] );
+        __m256 const inv_var_l = _mm256_set1_ps( inv_var_l_[color_id] );
+        __m256 const inv_var_s = _mm256_set1_ps( inv_var_s_[color_id] );
+
+        for( ; i + 8 <= width; i += 8 )
+        {
+            __m256 dh = _mm256_and_ps( _mm256_sub_ps( _mm256_load_ps( h + i ), mean_h ), abs_mask );
+            dh = _mm256_min_ps( dh, _mm256_sub_ps( hue_range, dh ) );
+            __m256 const dl = _mm256_sub_ps( _mm256_load_ps( l + i ), mean_l );
+            __m256 const ds = _mm256_sub_ps( _mm256_load_ps( s + i ), mean_s );
+
+            __m256 distance_squared = _mm256_mul_ps( _mm256_mul_ps( dh, dh ), inv_var_h );
+            distance_squared = _mm256_add_ps( distance_squared, _mm256_mul_ps( _mm256_mul_ps( dl, dl ), inv_var_l ) );
+            distance_squared = _mm256_add_ps( distance_squared, _mm256_mul_ps( _mm256_mul_ps( ds, ds ), inv_var_s ) );
+
+            __m256 const idx = _mm256_min_ps( _mm256_add_ps( _mm256_mul_ps( distance_squared, lut_scale ), half ), lut_max );
+            _mm256_store_si256( reinterpret_cast<__m256i *>( lut_idx + i ), _mm256_cvttps_epi32( idx ) );
+        }
+#elif defined( __SSE2__ )
+        __m128 const lut_scale = _mm_set1_ps( RESPONSE_LUT_SIZE / MAX_DISTANCE_SQUARED );
+        __m128 const lut_max = _mm_set1_ps( RESPONSE_LUT_SIZE - 1 );
+        __m128 const half = _mm_set1_ps( 0.5f );
+        __m128 const hue_range = _mm_set1_ps( HUE_RANGE );
+        __m128 const abs_mask = _mm_castsi128_ps( _mm_set1_epi32( 0x7fffffff ) );
+
+        __m128 const mean_h = _mm_set1_ps( mean_h_[color_id] );
+        __m128 const mean_l = _mm_set1_ps( mean_l_[color_id] );
+        __m128 const mean_s = _mm_set1_ps( mean_s_[color_id] );
+        __m128 const inv_var_h = _mm_set1_ps( inv_var_h_[color_id] );
+        __m128 const inv_var_l = _mm_set1_ps( inv_var_l_[color_id] );
+        __m128 const inv_var_s = _mm_set1_ps( inv_var_s_[color_id] );
+
+        for( ; i + 4 <= width; i += 4 )
+        {
+            __m128 dh = _mm_and_ps( _mm_sub_ps( _mm_load_ps( h + i ), mean_h ), abs_mask );
+            dh = _mm_min_ps( dh, _mm_sub_ps( hue_range, dh ) );
+            __m128 const dl = _mm_sub_ps( _mm_load_ps( l + i ), mean_l );
+            __m128 const ds = _mm_sub_ps( _mm_load_ps( s + i ), mean_s );
+
+            __m128 distance_squared = _mm_mul_ps( _mm_mul_ps( dh, dh ), inv_var_h );
+            distance_squared = _mm_add_ps( distance_squared, _mm_mul_ps( _mm_mul_ps( dl, dl ), inv_var_l ) );
+            distance_squared = _mm_add_ps( distance_squared, _mm_mul_ps( _mm_mul_ps( ds, ds ), inv_var_s ) );
+
+            __m128 const idx = _mm_min_ps( _mm_add_ps( _mm_mul_ps( distance_squared, lut_scale ), half ), lut_max );
+            _mm_store_si128( reinterpret_cast<__m128i *>( lut_idx + i ), _mm_cvttps_epi32( idx ) );
+        }
+#endif
+
+        // tail (or everything, if we were built without SIMD support)
+        distanceStripScalar( h, l, s, i, width, color_id, lut_idx );
+    }
+};
+
+#endif // COLORCLASSIFIER_GAUSSIANCOLORKERNEL_H_
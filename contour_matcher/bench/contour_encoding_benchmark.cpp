@@ -0,0 +1,211 @@
+/***************************************************************************
+ *  bench/contour_encoding_benchmark.cpp
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+// Compares the size and serialization/conversion cost of ContourArray messages with each contour encoding: plain Point2D points, int16
+// deltas, and deltas with polygon simplification and a point limit. Contours come from a frame's per-color masks, as extracted by
+// ContourFinderNode.
+//
+// usage: contour_encoding_benchmark [frames_folder] [frame] [iterations]
+// loads <frames_folder>/<frame>_<color>_mask.{jpg,png} for every known color (ie seabee3_data/frames, frame compiled_front); if no
+// masks are found, noisy random blobs are used
+
+#include <contour_matcher/blob_extractor.h>
+#include <seabee3_msgs/ContourArray.h>
+#include <ros/serialization.h>
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+typedef std::chrono::high_resolution_clock _Clock;
+typedef seabee3_msgs::ContourArray _ContourArrayMsg;
+
+static char const * const COLOR_NAMES[] = { "black", "blue", "green", "orange", "red", "white", "yellow" };
+static size_t const NUM_COLOR_NAMES = sizeof( COLOR_NAMES ) / sizeof( COLOR_NAMES[0] );
+
+struct EncodingCase
+{
+    char const * name_;
+    ContourEncoding encoding_;
+};
+
+static void loadMasks( std::string const & folder, std::string const & frame, std::vector<cv::Mat> & masks )
+{
+    for( size_t color_idx = 0; color_idx < NUM_COLOR_NAMES; ++color_idx )
+    {
+        cv::Mat mask = cv::imread( folder + "/" + frame + "_" + COLOR_NAMES[color_idx] + "_mask.jpg", 0 );
+        if( mask.empty() ) mask = cv::imread( folder + "/" + frame + "_" + COLOR_NAMES[color_idx] + "_mask.png", 0 );
+        if( !mask.empty() ) masks.push_back( mask );
+    }
+}
+
+//! Filled ellipses with ragged edges, so their contours are long
+static void makeRandomMasks( std::vector<cv::Mat> & masks )
+{
+    cv::RNG rng( 0 );
+
+    for( size_t mask_idx = 0; mask_idx < 4; ++mask_idx )
+    {
+        cv::Mat mask( 480, 640, CV_8UC1, cv::Scalar( 0 ) );
+        for( size_t blob_idx = 0; blob_idx < 10; ++blob_idx )
+        {
+            cv::Point const center( rng.uniform( 0, 640 ), rng.uniform( 0, 480 ) );
+            cv::Size const axes( rng.uniform( 10, 120 ), rng.uniform( 10, 120 ) );
+            cv::ellipse( mask, center, axes, rng.uniform( 0, 180 ), 0, 360, cv::Scalar( 255 ), CV_FILLED );
+        }
+
+        cv::Mat noise( mask.size(), CV_8UC1 );
+        cv::randu( noise, cv::Scalar( 0 ), cv::Scalar( 255 ) );
+        masks.push_back( mask & ( noise > 64 ) );
+    }
+}
+
+template<class __Func>
+double timeUs( __Func const & func, size_t const & iterations )
+{
+    auto const start = _Clock::now();
+    for( size_t i = 0; i < iterations; ++i )
+    {
+        func();
+    }
+    auto const end = _Clock::now();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( end - start ).count() / ( 1000.0 * iterations );
+}
+
+int main( int argc, char ** argv )
+{
+    std::string const folder = argc > 1 ? argv[1] : "";
+    std::string const frame = argc > 2 ? argv[2] : "compiled_front";
+    size_t const iterations = argc > 3 ? atoi( argv[3] ) : 100;
+
+    std::vector<cv::Mat> masks;
+    if( !folder.empty() ) loadMasks( folder, frame, masks );
+
+    if( masks.empty() )
+    {
+        printf( "Using random masks\n" );
+        makeRandomMasks( masks );
+    }
+
+    // extract once; only the encoding is being measured
+    std::vector<Blob> blobs;
+    for( size_t mask_idx = 0; mask_idx < masks.size(); ++mask_idx )
+    {
+        BlobExtractor blob_extractor;
+        blob_extractor.extract( masks[mask_idx], 100, 255, cv::THRESH_TOZERO );
+        blobs.insert( blobs.end(), blob_extractor.getBlobs().begin(), blob_extractor.getBlobs().end() );
+    }
+
+    size_t num_points = 0;
+    for( auto blob_it = blobs.cbegin(); blob_it != blobs.cend(); ++blob_it )
+    {
+        num_points += blob_it->contour_.size();
+    }
+
+    printf( "%zu contours, %zu points, %zu iterations\n", blobs.size(), num_points, iterations );
+    printf( "%24s %12s %12s %14s %14s %14s\n", "encoding", "points", "bytes", "encode us", "serialize us", "decode us" );
+
+    EncodingCase const cases[] =
+    {
+        { "points", ContourEncoding( uint8_t( _ContourMsg::ENCODING_POINTS ) ) },
+        { "delta", ContourEncoding( uint8_t( _ContourMsg::ENCODING_DELTA ) ) },
+        { "delta, tolerance 1", ContourEncoding( uint8_t( _ContourMsg::ENCODING_DELTA ), 1.0 ) },
+        { "delta, tolerance 2", ContourEncoding( uint8_t( _ContourMsg::ENCODING_DELTA ), 2.0 ) },
+        { "delta, max 64 points", ContourEncoding( uint8_t( _ContourMsg::ENCODING_DELTA ), 0, 64 ) }
+    };
+
+    for( size_t case_idx = 0; case_idx < sizeof( cases ) / sizeof( cases[0] ); ++case_idx )
+    {
+        auto const & encoding_case = cases[case_idx];
+
+        _ContourArrayMsg contour_array_msg;
+        auto encode = [&]()
+        {
+            contour_array_msg.contours.resize( blobs.size() );
+            for( size_t blob_idx = 0; blob_idx < blobs.size(); ++blob_idx )
+            {
+                blobToMsg( blobs[blob_idx], "color", 1.0, encoding_case.encoding_, contour_array_msg.contours[blob_idx] );
+            }
+        };
+
+        double const encode_us = timeUs( encode, iterations );
+
+        size_t const num_bytes = ros::serialization::serializationLength( contour_array_msg );
+        std::vector<uint8_t> buffer( num_bytes );
+        auto serialize = [&]()
+        {
+            ros::serialization::OStream stream( buffer.data(), buffer.size() );
+            ros::serialization::serialize( stream, contour_array_msg );
+        };
+
+        double const serialize_us = timeUs( serialize, iterations );
+
+        size_t num_encoded_points = 0;
+        std::vector<_Contour> contours( blobs.size() );
+        auto decode = [&]()
+        {
+            num_encoded_points = 0;
+            for( size_t blob_idx = 0; blob_idx < blobs.size(); ++blob_idx )
+            {
+                decodeContour( contour_array_msg.contours[blob_idx], contours[blob_idx] );
+                num_encoded_points += contours[blob_idx].size();
+            }
+        };
+
+        double const decode_us = timeUs( decode, iterations );
+
+        printf( "%24s %12zu %12zu %14.1f %14.1f %14.1f\n", encoding_case.name_, num_encoded_points, num_bytes, encode_us, serialize_us, decode_us );
+
+        // lossless encodings must round-trip exactly
+        if( encoding_case.encoding_.tolerance_ <= 0 && encoding_case.encoding_.max_points_ == 0 )
+        {
+            for( size_t blob_idx = 0; blob_idx < blobs.size(); ++blob_idx )
+            {
+                if( contours[blob_idx] != blobs[blob_idx].contour_ )
+                {
+                    printf( "%s: contour %zu did not round-trip\n", encoding_case.name_, blob_idx );
+                    return 1;
+                }
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,242 @@
+/***************************************************************************
+ *  bench/contour_extraction_benchmark.cpp
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+// Compares per-color contour extraction in ContourFinderNode: the original copy/threshold/copy/findContours sequence, BlobExtractor run
+// serially over each color, and BlobExtractor run concurrently over colors on a WorkerPool with 1-N threads. Checks that every thread
+// count produces the same contours, in the same order, as the serial run.
+//
+// usage: contour_extraction_benchmark [frames_folder] [frame] [width] [iterations]
+// loads <frames_folder>/<frame>_<color>_mask.{jpg,png} for every known color (ie seabee3_data/frames, frame compiled_front), resizes
+// the masks to the given width, and repeats them to get up to 2x as many colors as were found; if no masks are found, random blobs are used
+
+#include <contour_matcher/blob_extractor.h>
+#include <seabee3_common/worker_pool.h>
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+typedef std::chrono::high_resolution_clock _Clock;
+
+static char const * const COLOR_NAMES[] = { "black", "blue", "green", "orange", "red", "white", "yellow" };
+static size_t const NUM_COLOR_NAMES = sizeof( COLOR_NAMES ) / sizeof( COLOR_NAMES[0] );
+
+// ContourFinderNode's default threshold settings
+static int const THRESHOLD_MIN = 100;
+static int const THRESHOLD_MAX = 255;
+
+static void loadMasks( std::string const & folder, std::string const & frame, int const & width, std::vector<cv::Mat> & masks )
+{
+    for( size_t color_idx = 0; color_idx < NUM_COLOR_NAMES; ++color_idx )
+    {
+        cv::Mat mask = cv::imread( folder + "/" + frame + "_" + COLOR_NAMES[color_idx] + "_mask.jpg", 0 );
+        if( mask.empty() ) mask = cv::imread( folder + "/" + frame + "_" + COLOR_NAMES[color_idx] + "_mask.png", 0 );
+        if( mask.empty() ) continue;
+
+        printf( "Loaded %s mask (%ix%i)\n", COLOR_NAMES[color_idx], mask.cols, mask.rows );
+
+        cv::Mat resized_mask;
+        cv::resize( mask, resized_mask, cv::Size( width, mask.rows * width / mask.cols ), 0, 0, cv::INTER_AREA );
+        masks.push_back( resized_mask );
+    }
+}
+
+//! Scattered filled ellipses, to stand in for a classifier output
+static void makeRandomMasks( int const & width, size_t const & num_masks, std::vector<cv::Mat> & masks )
+{
+    cv::RNG rng( 0 );
+    int const height = width * 3 / 4;
+
+    for( size_t mask_idx = 0; mask_idx < num_masks; ++mask_idx )
+    {
+        cv::Mat mask( height, width, CV_8UC1, cv::Scalar( 0 ) );
+        for( size_t blob_idx = 0; blob_idx < 20; ++blob_idx )
+        {
+            cv::Point const center( rng.uniform( 0, width ), rng.uniform( 0, height ) );
+            cv::Size const axes( rng.uniform( 2, width / 10 ), rng.uniform( 2, height / 10 ) );
+            cv::ellipse( mask, center, axes, rng.uniform( 0, 180 ), 0, 360, cv::Scalar( rng.uniform( THRESHOLD_MIN + 1, 256 ) ), CV_FILLED );
+        }
+        masks.push_back( mask );
+    }
+}
+
+template<class __Func>
+double timeMs( __Func const & func, size_t const & iterations )
+{
+    auto const start = _Clock::now();
+    for( size_t i = 0; i < iterations; ++i )
+    {
+        func();
+    }
+    auto const end = _Clock::now();
+
+    return std::chrono::duration_cast<std::chrono::microseconds>( end - start ).count() / ( 1000.0 * iterations );
+}
+
+//! Flatten the blobs of each color, in color order, the way ContourFinderNode merges them into its ContourArray
+static void mergeContours( std::vector<BlobExtractor> const & blob_extractors, size_t const & num_colors, std::vector<_Contour> & contours )
+{
+    contours.clear();
+    for( size_t color_idx = 0; color_idx < num_colors; ++color_idx )
+    {
+        auto const & blobs = blob_extractors[color_idx].getBlobs();
+        for( auto blob_it = blobs.cbegin(); blob_it != blobs.cend(); ++blob_it )
+        {
+            contours.push_back( blob_it->contour_ );
+        }
+    }
+}
+
+int main( int argc, char ** argv )
+{
+    std::string const folder = argc > 1 ? argv[1] : "";
+    std::string const frame = argc > 2 ? argv[2] : "compiled_front";
+    int const width = argc > 3 ? atoi( argv[3] ) : 640;
+    size_t const iterations = argc > 4 ? atoi( argv[4] ) : 50;
+
+    std::vector<cv::Mat> masks;
+    if( !folder.empty() ) loadMasks( folder, frame, width, masks );
+
+    if( masks.empty() )
+    {
+        printf( "Using random masks\n" );
+        makeRandomMasks( width, 4, masks );
+    }
+
+    // repeat the masks to simulate more enabled colors
+    size_t const num_loaded = masks.size();
+    for( size_t mask_idx = 0; mask_idx < num_loaded; ++mask_idx )
+    {
+        masks.push_back( masks[mask_idx] );
+    }
+
+    size_t const max_threads = std::max<size_t>( boost::thread::hardware_concurrency(), 2 );
+
+    printf( "Extracting contours from %zu-%zu %ix%i masks, %zu iterations\n", size_t( 1 ), masks.size(), masks[0].cols, masks[0].rows, iterations );
+    printf( "%8s %16s %16s", "colors", "findContours ms", "serial ms" );
+    for( size_t num_threads = 1; num_threads <= max_threads; ++num_threads )
+    {
+        printf( " %7zu thr ms", num_threads );
+    }
+    printf( "\n" );
+
+    std::vector<BlobExtractor> blob_extractors( masks.size() );
+    std::vector<boost::shared_ptr<seabee::WorkerPool> > worker_pools;
+    for( size_t num_threads = 1; num_threads <= max_threads; ++num_threads )
+    {
+        worker_pools.push_back( boost::make_shared<seabee::WorkerPool>( num_threads ) );
+    }
+
+    bool all_match = true;
+
+    for( size_t num_colors = 1; num_colors <= masks.size(); ++num_colors )
+    {
+        // the original ContourFinderNode::processImages loop
+        auto find_contours = [&]()
+        {
+            for( size_t color_idx = 0; color_idx < num_colors; ++color_idx )
+            {
+                cv::Mat normalized_image;
+                cv::Mat thresholded_image;
+                cv::Mat contour_image;
+
+                masks[color_idx].copyTo( normalized_image );
+                cv::threshold( masks[color_idx], thresholded_image, THRESHOLD_MIN, THRESHOLD_MAX, cv::THRESH_TOZERO );
+                thresholded_image.copyTo( contour_image );
+
+                std::vector<_Contour> contours;
+                cv::findContours( contour_image, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE );
+            }
+        };
+
+        auto extract_color = [&]( size_t const & color_idx )
+        {
+            blob_extractors[color_idx].extract( masks[color_idx], THRESHOLD_MIN, THRESHOLD_MAX, cv::THRESH_TOZERO );
+        };
+
+        auto serial = [&]()
+        {
+            for( size_t color_idx = 0; color_idx < num_colors; ++color_idx )
+            {
+                extract_color( color_idx );
+            }
+        };
+
+        printf( "%8zu %16.3f", num_colors, timeMs( find_contours, iterations ) );
+        printf( " %16.3f", timeMs( serial, iterations ) );
+
+        std::vector<_Contour> serial_contours;
+        serial();
+        mergeContours( blob_extractors, num_colors, serial_contours );
+
+        for( size_t pool_idx = 0; pool_idx < worker_pools.size(); ++pool_idx )
+        {
+            auto & worker_pool = *worker_pools[pool_idx];
+
+            auto parallel = [&]()
+            {
+                worker_pool.parallelFor
+                (
+                    num_colors,
+                    [&]( size_t const & begin, size_t const & end )
+                    {
+                        for( size_t color_idx = begin; color_idx < end; ++color_idx )
+                        {
+                            extract_color( color_idx );
+                        }
+                    }
+                );
+            };
+
+            printf( " %14.3f", timeMs( parallel, iterations ) );
+
+            std::vector<_Contour> parallel_contours;
+            parallel();
+            mergeContours( blob_extractors, num_colors, parallel_contours );
+
+            all_match = all_match && parallel_contours == serial_contours;
+        }
+
+        printf( "\n" );
+    }
+
+    printf( "parallel contours match serial: %s\n", all_match ? "yes" : "NO" );
+
+    return all_match ? 0 : 1;
+}
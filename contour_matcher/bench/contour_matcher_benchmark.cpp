@@ -0,0 +1,204 @@
+/***************************************************************************
+ *  bench/contour_matcher_benchmark.cpp
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+// Measures the ShapeMatcher used by ContourMatcherNode: the cost of describing a contour, and of scoring a frame's worth of contours
+// against a library of templates in one batch, compared to calling cv::matchShapes on every candidate/template pair. Also reports how
+// often a rotated, scaled, re-rasterized copy of each template matches its own template best.
+//
+// usage: contour_matcher_benchmark [num_templates] [candidates_per_frame] [iterations]
+// defaults to 48 templates, 20 candidates per frame
+
+#include <contour_matcher/shape_matcher.h>
+#include <contour_matcher/blob_extractor.h>
+#include <opencv/cv.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef std::chrono::high_resolution_clock _Clock;
+
+//! A random star-ish shape: radius 1 + a sum of a few random harmonics
+struct ShapeParams
+{
+    int harmonics_[3];
+    double amplitudes_[3];
+    double phases_[3];
+    double aspect_ratio_;
+};
+
+static ShapeParams makeShapeParams( cv::RNG & rng )
+{
+    ShapeParams params;
+    for( size_t i = 0; i < 3; ++i )
+    {
+        params.harmonics_[i] = rng.uniform( 2, 7 );
+        params.amplitudes_[i] = rng.uniform( 0.0, 0.25 );
+        params.phases_[i] = rng.uniform( 0.0, 2 * M_PI );
+    }
+    params.aspect_ratio_ = rng.uniform( 1.0, 2.5 );
+    return params;
+}
+
+//! Rasterize the shape at the given scale and rotation and extract its contour, as ContourFinderNode would
+static _Contour renderShape( ShapeParams const & params, double const & scale, double const & rotation )
+{
+    int const size = scale * 6 + 8;
+    cv::Mat mask( size, size, CV_8UC1, cv::Scalar( 0 ) );
+
+    std::vector<cv::Point> polygon;
+    for( size_t i = 0; i < 360; ++i )
+    {
+        double const t = 2 * M_PI * i / 360;
+        double radius = 1;
+        for( size_t j = 0; j < 3; ++j )
+        {
+            radius += params.amplitudes_[j] * cos( params.harmonics_[j] * t + params.phases_[j] );
+        }
+
+        double const x = radius * cos( t ) * params.aspect_ratio_;
+        double const y = radius * sin( t );
+        polygon.push_back( cv::Point( size / 2 + scale * ( x * cos( rotation ) - y * sin( rotation ) ), size / 2 + scale * ( x * sin( rotation ) + y * cos( rotation ) ) ) );
+    }
+
+    std::vector<std::vector<cv::Point> > polygons( 1, polygon );
+    cv::fillPoly( mask, polygons, cv::Scalar( 255 ) );
+
+    BlobExtractor blob_extractor;
+    blob_extractor.extract( mask, 127, 255, cv::THRESH_BINARY );
+
+    auto const & blobs = blob_extractor.getBlobs();
+    return blobs.empty() ? _Contour() : blobs.front().contour_;
+}
+
+template<class __Func>
+double timeUs( __Func const & func, size_t const & iterations )
+{
+    auto const start = _Clock::now();
+    for( size_t i = 0; i < iterations; ++i )
+    {
+        func();
+    }
+    auto const end = _Clock::now();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( end - start ).count() / ( 1000.0 * iterations );
+}
+
+int main( int argc, char ** argv )
+{
+    size_t const num_templates = argc > 1 ? atoi( argv[1] ) : 48;
+    size_t const candidates_per_frame = argc > 2 ? atoi( argv[2] ) : 20;
+    size_t const iterations = argc > 3 ? atoi( argv[3] ) : 100;
+
+    cv::RNG rng( 0 );
+
+    ShapeMatcher matcher;
+    std::vector<ShapeParams> shape_params;
+    std::vector<_Contour> templates;
+
+    for( size_t template_idx = 0; template_idx < num_templates; ++template_idx )
+    {
+        shape_params.push_back( makeShapeParams( rng ) );
+        templates.push_back( renderShape( shape_params.back(), 60, 0 ) );
+
+        std::stringstream template_id;
+        template_id << "shape" << template_idx;
+        matcher.addTemplate( template_id.str(), templates.back() );
+    }
+
+    // each candidate is a template at a random scale and rotation
+    std::vector<_Contour> candidates;
+    std::vector<size_t> expected_templates;
+    for( size_t candidate_idx = 0; candidate_idx < candidates_per_frame; ++candidate_idx )
+    {
+        size_t const template_idx = candidate_idx % num_templates;
+        candidates.push_back( renderShape( shape_params[template_idx], rng.uniform( 15.0, 80.0 ), rng.uniform( 0.0, 2 * M_PI ) ) );
+        expected_templates.push_back( template_idx );
+    }
+
+    size_t num_candidate_points = 0;
+    for( auto candidate_it = candidates.cbegin(); candidate_it != candidates.cend(); ++candidate_it )
+    {
+        num_candidate_points += candidate_it->size();
+    }
+
+    printf( "%zu templates, %zu candidates per frame (%zu points on average), %zu iterations\n", num_templates, candidates_per_frame, num_candidate_points / std::max<size_t>( candidates.size(), 1 ), iterations );
+
+    // describing a contour, alone
+    float features[ShapeDescriptor::NUM_FEATURES];
+    double const describe_us = timeUs( [&](){ for( size_t i = 0; i < candidates.size(); ++i ) matcher.describe( candidates[i], features ); }, iterations ) / candidates.size();
+
+    // a whole frame: describe every candidate and score it against every template
+    std::vector<float> qualities;
+    double const batched_us = timeUs( [&](){ matcher.score( candidates, qualities ); }, iterations );
+
+    // the obvious alternative: cv::matchShapes on every pair, which recomputes both contours' moments each time
+    double naive_sum = 0;
+    double const naive_us = timeUs
+    (
+        [&]()
+        {
+            for( size_t candidate_idx = 0; candidate_idx < candidates.size(); ++candidate_idx )
+            {
+                for( size_t template_idx = 0; template_idx < templates.size(); ++template_idx )
+                {
+                    naive_sum += cv::matchShapes( cv::Mat( candidates[candidate_idx] ), cv::Mat( templates[template_idx] ), CV_CONTOURS_MATCH_I1, 0 );
+                }
+            }
+        },
+        std::max<size_t>( iterations / 10, 1 )
+    );
+
+    printf( "%28s %12.2f us\n", "describe one contour", describe_us );
+    printf( "%28s %12.2f us (%.0f frames/s)\n", "batched frame", batched_us, 1e6 / batched_us );
+    printf( "%28s %12.2f us (%.0f frames/s)\n", "pairwise cv::matchShapes", naive_us, 1e6 / naive_us );
+
+    // top-1 accuracy
+    matcher.score( candidates, qualities );
+    size_t num_correct = 0;
+    for( size_t candidate_idx = 0; candidate_idx < candidates.size(); ++candidate_idx )
+    {
+        float const * const candidate_qualities = qualities.data() + candidate_idx * matcher.size();
+        size_t const best_template_idx = std::max_element( candidate_qualities, candidate_qualities + matcher.size() ) - candidate_qualities;
+        if( best_template_idx == expected_templates[candidate_idx] ) ++num_correct;
+    }
+
+    printf( "best match is the source template for %zu/%zu candidates\n", num_correct, candidates.size() );
+
+    return naive_sum < 0 ? 1 : 0;
+}
@@ -0,0 +1,531 @@
+/***************************************************************************
+ *  contour_matcher/include/contour_matcher/blob_extractor.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef CONTOURMATCHER_BLOBEXTRACTOR_H_
+#define CONTOURMATCHER_BLOBEXTRACTOR_H_
+
+// objects
+#include <opencv/cv.hpp>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdint.h>
+
+// utils
+#include <contour_matcher/contour.h>
+
+// =============================================================================================================================================
+//! Shape features of one 8-connected blob, in pixel coordinates of the image it was extracted from
+struct Blob
+{
+    size_t area_;
+    cv::Point2d centroid_;
+    //! Inclusive of the blob's last row/column
+    cv::Rect bounding_box_;
+    //! Central second moments normalized by area; ie the covariance of the blob's pixel coordinates
+    double mu20_;
+    double mu11_;
+    double mu02_;
+    //! Full axis lengths of the ellipse with the same second moments as the blob
+    double major_axis_;
+    double minor_axis_;
+    //! Angle of the major axis from the +x image axis, in radians, towards +y
+    double angle_;
+    //! External boundary, compressed to the points where the chain direction changes (as CV_CHAIN_APPROX_SIMPLE)
+    _Contour contour_;
+};
+
+// =============================================================================================================================================
+//! Labels the 8-connected components of a binary predicate over an image in a single raster pass
+/*! - foreground pixels are grouped into horizontal runs; each run is merged with the runs it touches in the previous row (union-find)
+    - area, bounding box, and raw moments are accumulated per run as it's found, so no label image is ever written
+    - the external contour of each blob is then traced against the runs themselves
+    - blobs that lie inside a hole of another blob are dropped, as with CV_RETR_EXTERNAL; the gaps between runs are labeled as 4-connected
+      background the same way, and a blob is kept only if the background just left of its top-left pixel reaches the edge of the image
+    - blobs are returned in raster order of their top-left pixel */
+class BlobExtractor
+{
+protected:
+    struct Run
+    {
+        int y_;
+        int begin_;
+        int end_;
+        size_t label_;
+    };
+
+    struct Moments
+    {
+        int64_t m00_;
+        int64_t m10_;
+        int64_t m01_;
+        int64_t m20_;
+        int64_t m11_;
+        int64_t m02_;
+        int min_x_;
+        int min_y_;
+        int max_x_;
+        int max_y_;
+        //! Index of the first (top-left) run that created this label
+        size_t first_run_;
+    };
+
+    //! Runs for row y are runs_[row_offsets_[y]] through runs_[row_offsets_[y + 1] - 1], ordered by column
+    std::vector<size_t> row_offsets_;
+    std::vector<Run> runs_;
+    std::vector<size_t> parents_;
+    std::vector<Moments> moments_;
+    std::vector<Blob> blobs_;
+
+    //! Gaps between runs, laid out as runs_; label_ indexes background_parents_
+    std::vector<size_t> background_row_offsets_;
+    std::vector<Run> background_runs_;
+    std::vector<size_t> background_parents_;
+    //! Per background label; non-zero if that background region touches the edge of the image (valid for roots only)
+    std::vector<uint8_t> background_open_;
+
+    int rows_;
+    int cols_;
+
+public:
+    BlobExtractor()
+    :
+        rows_( 0 ),
+        cols_( 0 )
+    {
+        //
+    }
+
+    //! Fill table so that table[value] is true wherever cv::threshold( value, threshold, max_value, type ) is non-zero
+    static void makeThresholdTable( double const & threshold, double const & max_value, int const & type, bool * table )
+    {
+        for( int value = 0; value < 256; ++value )
+        {
+            double result = 0;
+            switch( type )
+            {
+            case cv::THRESH_BINARY:     result = value > threshold ? max_value : 0; break;
+            case cv::THRESH_BINARY_INV: result = value > threshold ? 0 : max_value; break;
+            case cv::THRESH_TRUNC:      result = value > threshold ? threshold : value; break;
+            case cv::THRESH_TOZERO:     result = value > threshold ? value : 0; break;
+            case cv::THRESH_TOZERO_INV: result = value > threshold ? 0 : value; break;
+            }
+            table[value] = cv::saturate_cast<uchar>( result ) != 0;
+        }
+    }
+
+    //! Extract the blobs of a mono8 image whose pixels pass the given threshold; equivalent to running cv::threshold and then cv::findContours
+    //! with CV_RETR_EXTERNAL and CV_CHAIN_APPROX_SIMPLE
+    void extract( cv::Mat const & image, double const & threshold, double const & max_value, int const & type )
+    {
+        bool table[256];
+        makeThresholdTable( threshold, max_value, type, table );
+
+        extract( image.rows, image.cols, [&]( int const & y, int const & x ){ return table[image.ptr<uchar>( y )[x]]; } );
+    }
+
+    //! Extract the blobs of the rows x cols area where is_foreground( y, x ) is true
+    template<class __Foreground>
+    void extract( int const & rows, int const & cols, __Foreground const & is_foreground )
+    {
+        rows_ = rows;
+        cols_ = cols;
+
+        row_offsets_.resize( rows + 1 );
+        runs_.clear();
+        parents_.clear();
+        moments_.clear();
+        blobs_.clear();
+
+        for( int y = 0; y < rows; ++y )
+        {
+            row_offsets_[y] = runs_.size();
+
+            // runs in the previous row; swept alongside the current row since both are ordered by column
+            size_t previous_it = y > 0 ? row_offsets_[y - 1] : 0;
+            size_t const previous_end = row_offsets_[y];
+
+            int x = 0;
+            while( x < cols )
+            {
+                while( x < cols && !is_foreground( y, x ) ) ++x;
+                if( x == cols ) break;
+
+                int const begin = x;
+                while( x < cols && is_foreground( y, x ) ) ++x;
+
+                Run run;
+                run.y_ = y;
+                run.begin_ = begin;
+                run.end_ = x;
+                run.label_ = parents_.size();
+
+                // skip previous runs that end before the diagonal neighbor of our first pixel
+                while( previous_it < previous_end && runs_[previous_it].end_ < begin ) ++previous_it;
+
+                // merge with every previous run that touches [begin - 1, end]; the last one may also touch our right neighbor, so don't consume it
+                for( size_t touching_it = previous_it; touching_it < previous_end && runs_[touching_it].begin_ <= x; ++touching_it )
+                {
+                    size_t const root = findRoot( runs_[touching_it].label_ );
+
+                    if( run.label_ == parents_.size() ) run.label_ = root;
+                    else unite( run.label_, root );
+                }
+
+                if( run.label_ == parents_.size() )
+                {
+                    parents_.push_back( run.label_ );
+                    Moments moments = Moments();
+                    moments.min_x_ = begin;
+                    moments.min_y_ = y;
+                    moments.max_x_ = x - 1;
+                    moments.max_y_ = y;
+                    moments.first_run_ = runs_.size();
+                    moments_.push_back( moments );
+                }
+
+                run.label_ = findRoot( run.label_ );
+                accumulate( run, moments_[run.label_] );
+                runs_.push_back( run );
+            }
+        }
+
+        row_offsets_[rows] = runs_.size();
+
+        labelBackground();
+
+        // fold the moments of merged labels into their roots; roots always have the smallest label in their set, so parents come first
+        for( size_t label = 0; label < parents_.size(); ++label )
+        {
+            size_t const root = findRoot( label );
+            if( root != label ) merge( moments_[label], moments_[root] );
+        }
+
+        for( size_t label = 0; label < parents_.size(); ++label )
+        {
+            if( parents_[label] != label || isEnclosed( runs_[moments_[label].first_run_] ) ) continue;
+
+            blobs_.push_back( Blob() );
+            makeBlob( moments_[label], blobs_.back() );
+        }
+    }
+
+    std::vector<Blob> const & getBlobs() const
+    {
+        return blobs_;
+    }
+
+protected:
+    size_t findRoot( size_t const & label )
+    {
+        return findRoot( parents_, label );
+    }
+
+    static size_t findRoot( std::vector<size_t> & parents, size_t label )
+    {
+        while( parents[label] != label )
+        {
+            // path halving
+            parents[label] = parents[parents[label]];
+            label = parents[label];
+        }
+        return label;
+    }
+
+    //! Label the 4-connected regions of background between the foreground runs, and note which of them reach the edge of the image
+    void labelBackground()
+    {
+        background_row_offsets_.resize( rows_ + 1 );
+        background_runs_.clear();
+        background_parents_.clear();
+        background_open_.clear();
+
+        for( int y = 0; y < rows_; ++y )
+        {
+            background_row_offsets_[y] = background_runs_.size();
+
+            size_t previous_it = y > 0 ? background_row_offsets_[y - 1] : 0;
+            size_t const previous_end = background_row_offsets_[y];
+
+            int begin = 0;
+            for( size_t run_it = row_offsets_[y]; run_it <= row_offsets_[y + 1]; ++run_it )
+            {
+                // the gap before each run, then the gap after the last one
+                int const end = run_it < row_offsets_[y + 1] ? runs_[run_it].begin_ : cols_;
+
+                if( begin < end )
+                {
+                    Run run;
+                    run.y_ = y;
+                    run.begin_ = begin;
+                    run.end_ = end;
+                    run.label_ = background_parents_.size();
+
+                    background_parents_.push_back( run.label_ );
+                    background_open_.push_back( y == 0 || y == rows_ - 1 || begin == 0 || end == cols_ );
+
+                    // 4-connected: previous runs must share at least one column with [begin, end)
+                    while( previous_it < previous_end && background_runs_[previous_it].end_ <= begin ) ++previous_it;
+
+                    for( size_t touching_it = previous_it; touching_it < previous_end && background_runs_[touching_it].begin_ < end; ++touching_it )
+                    {
+                        uniteBackground( run.label_, background_runs_[touching_it].label_ );
+                    }
+
+                    background_runs_.push_back( run );
+                }
+
+                if( run_it < row_offsets_[y + 1] ) begin = runs_[run_it].end_;
+            }
+        }
+
+        background_row_offsets_[rows_] = background_runs_.size();
+    }
+
+    void uniteBackground( size_t const & label, size_t const & other )
+    {
+        size_t const root = findRoot( background_parents_, label );
+        size_t const other_root = findRoot( background_parents_, other );
+        if( root == other_root ) return;
+
+        size_t const new_root = std::min( root, other_root );
+        size_t const old_root = std::max( root, other_root );
+
+        background_parents_[old_root] = new_root;
+        background_open_[new_root] |= background_open_[old_root];
+    }
+
+    //! Whether the blob whose top-left run is first_run lies inside a hole of another blob
+    bool isEnclosed( Run const & first_run )
+    {
+        // the pixel west of a blob's top-left pixel is always outside its external boundary
+        if( first_run.begin_ == 0 ) return false;
+
+        auto const row_begin = background_runs_.begin() + background_row_offsets_[first_run.y_];
+        auto const row_end = background_runs_.begin() + background_row_offsets_[first_run.y_ + 1];
+
+        // the gap ending where this run begins
+        auto const gap_it = std::lower_bound( row_begin, row_end, first_run.begin_, []( Run const & run, int const & column ){ return run.end_ < column; } );
+
+        return !background_open_[findRoot( background_parents_, gap_it->label_ )];
+    }
+
+    //! Keep the smaller label as the root, so every set is rooted at the label of its top-left run
+    void unite( size_t & label, size_t const & other )
+    {
+        size_t const root = findRoot( label );
+        size_t const other_root = findRoot( other );
+        if( root == other_root ) return;
+
+        if( root < other_root ) parents_[other_root] = root;
+        else parents_[root] = other_root;
+
+        label = std::min( root, other_root );
+    }
+
+    //! Sum of x over [begin, end)
+    static int64_t sumRange( int64_t const & begin, int64_t const & end )
+    {
+        return ( end * ( end - 1 ) - begin * ( begin - 1 ) ) / 2;
+    }
+
+    //! Sum of x^2 over [begin, end)
+    static int64_t sumSquaresRange( int64_t const & begin, int64_t const & end )
+    {
+        return ( ( end - 1 ) * end * ( 2 * end - 1 ) - ( begin - 1 ) * begin * ( 2 * begin - 1 ) ) / 6;
+    }
+
+    static void accumulate( Run const & run, Moments & moments )
+    {
+        int64_t const y = run.y_;
+        int64_t const count = run.end_ - run.begin_;
+        int64_t const sum_x = sumRange( run.begin_, run.end_ );
+
+        moments.m00_ += count;
+        moments.m10_ += sum_x;
+        moments.m01_ += count * y;
+        moments.m20_ += sumSquaresRange( run.begin_, run.end_ );
+        moments.m11_ += sum_x * y;
+        moments.m02_ += count * y * y;
+
+        moments.min_x_ = std::min( moments.min_x_, run.begin_ );
+        moments.max_x_ = std::max( moments.max_x_, run.end_ - 1 );
+        moments.min_y_ = std::min( moments.min_y_, run.y_ );
+        moments.max_y_ = std::max( moments.max_y_, run.y_ );
+    }
+
+    static void merge( Moments const & from, Moments & to )
+    {
+        to.m00_ += from.m00_;
+        to.m10_ += from.m10_;
+        to.m01_ += from.m01_;
+        to.m20_ += from.m20_;
+        to.m11_ += from.m11_;
+        to.m02_ += from.m02_;
+
+        to.min_x_ = std::min( to.min_x_, from.min_x_ );
+        to.max_x_ = std::max( to.max_x_, from.max_x_ );
+        to.min_y_ = std::min( to.min_y_, from.min_y_ );
+        to.max_y_ = std::max( to.max_y_, from.max_y_ );
+    }
+
+    void makeBlob( Moments const & moments, Blob & blob ) const
+    {
+        double const area = moments.m00_;
+        double const mean_x = moments.m10_ / area;
+        double const mean_y = moments.m01_ / area;
+
+        blob.area_ = moments.m00_;
+        blob.centroid_ = cv::Point2d( mean_x, mean_y );
+        blob.bounding_box_ = cv::Rect( moments.min_x_, moments.min_y_, moments.max_x_ - moments.min_x_ + 1, moments.max_y_ - moments.min_y_ + 1 );
+
+        blob.mu20_ = moments.m20_ / area - mean_x * mean_x;
+        blob.mu11_ = moments.m11_ / area - mean_x * mean_y;
+        blob.mu02_ = moments.m02_ / area - mean_y * mean_y;
+
+        // eigenvalues of the covariance are the variances along the ellipse's axes; a solid ellipse with semi-axis a has variance a^2 / 4 along it
+        double const half_trace = ( blob.mu20_ + blob.mu02_ ) / 2;
+        double const spread = sqrt( std::max( 0.0, ( blob.mu20_ - blob.mu02_ ) * ( blob.mu20_ - blob.mu02_ ) / 4 + blob.mu11_ * blob.mu11_ ) );
+
+        blob.major_axis_ = 4 * sqrt( std::max( 0.0, half_trace + spread ) );
+        blob.minor_axis_ = 4 * sqrt( std::max( 0.0, half_trace - spread ) );
+        blob.angle_ = 0.5 * atan2( 2 * blob.mu11_, blob.mu20_ - blob.mu02_ );
+
+        traceContour( runs_[moments.first_run_], blob.contour_ );
+    }
+
+    bool isForeground( int const & x, int const & y ) const
+    {
+        if( x < 0 || y < 0 || x >= cols_ || y >= rows_ ) return false;
+
+        auto const row_begin = runs_.begin() + row_offsets_[y];
+        auto const row_end = runs_.begin() + row_offsets_[y + 1];
+
+        // last run starting at or before x
+        auto const run_it = std::upper_bound( row_begin, row_end, x, []( int const & column, Run const & run ){ return column < run.begin_; } );
+        return run_it != row_begin && x < ( run_it - 1 )->end_;
+    }
+
+    //! Moore-neighbor trace of the external boundary, starting from the blob's top-left pixel and stopping on Jacob's criterion
+    void traceContour( Run const & first_run, _Contour & contour ) const
+    {
+        // clockwise on screen (y down), starting east
+        static int const dx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+        static int const dy[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+
+        contour.clear();
+
+        cv::Point const start( first_run.begin_, first_run.y_ );
+        std::vector<int> directions;
+
+        cv::Point current = start;
+        // we entered the top-left pixel from the west; everything west and north of it is background
+        int search_direction = 4;
+        int first_direction = -1;
+
+        std::vector<cv::Point> points;
+
+        while( true )
+        {
+            int direction = -1;
+            for( int i = 0; i < 8; ++i )
+            {
+                int const candidate = ( search_direction + i ) % 8;
+                if( isForeground( current.x + dx[candidate], current.y + dy[candidate] ) )
+                {
+                    direction = candidate;
+                    break;
+                }
+            }
+
+            // isolated pixel
+            if( direction < 0 ) break;
+
+            if( current == start )
+            {
+                if( first_direction < 0 ) first_direction = direction;
+                else if( direction == first_direction ) break;
+            }
+
+            points.push_back( current );
+            directions.push_back( direction );
+
+            current += cv::Point( dx[direction], dy[direction] );
+            // restart the search at the background pixel examined just before the one we moved to
+            search_direction = ( direction + ( direction % 2 ? 5 : 6 ) ) % 8;
+        }
+
+        if( points.empty() )
+        {
+            contour.push_back( start );
+            return;
+        }
+
+        // keep only the points where the chain changes direction, plus the start
+        for( size_t i = 0; i < points.size(); ++i )
+        {
+            int const previous_direction = directions[( i + directions.size() - 1 ) % directions.size()];
+            if( i == 0 || directions[i] != previous_direction ) contour.push_back( points[i] );
+        }
+    }
+};
+
+// =============================================================================================================================================
+//! Fill contour_msg with the given blob's contour (written with contour_encoding) and features, scaled by scale into source image coordinates
+/*! - the features always describe the full blob, even if the contour is simplified */
+inline void blobToMsg( Blob const & blob, std::string const & name, double const & scale, ContourEncoding const & contour_encoding, _ContourMsg & contour_msg )
+{
+    contour_msg.name = name;
+
+    encodeContour( blob.contour_, scale, contour_encoding, contour_msg );
+
+    double const area_scale = scale * scale;
+
+    contour_msg.area = blob.area_ * area_scale;
+    contour_msg.centroid.x = blob.centroid_.x * scale;
+    contour_msg.centroid.y = blob.centroid_.y * scale;
+    contour_msg.bounding_box_min.x = blob.bounding_box_.x * scale;
+    contour_msg.bounding_box_min.y = blob.bounding_box_.y * scale;
+    contour_msg.bounding_box_max.x = ( blob.bounding_box_.x + blob.bounding_box_.width - 1 ) * scale;
+    contour_msg.bounding_box_max.y = ( blob.bounding_box_.y + blob.bounding_box_.height - 1 ) * scale;
+    contour_msg.mu20 = blob.mu20_ * area_scale;
+    contour_msg.mu11 = blob.mu11_ * area_scale;
+    contour_msg.mu02 = blob.mu02_ * area_scale;
+    contour_msg.major_axis = blob.major_axis_ * scale;
+    contour_msg.minor_axis = blob.minor_axis_ * scale;
+    contour_msg.angle = blob.angle_;
+}
+
+#endif // CONTOURMATCHER_BLOBEXTRACTOR_H_
@@ -38,6 +38,7 @@
 
 #include <opencv/cv.hpp>
 #include <vector>
+#include <stdint.h>
 #include <seabee3_msgs/Contour.h>
 #include <quickdev/unit.h>
 
@@ -46,7 +47,142 @@ typedef seabee3_msgs::Point2D _ContourPointMsg;
 typedef std::vector<_Point> _Contour;
 typedef seabee3_msgs::Contour _ContourMsg;
 
-DECLARE_UNIT_CONVERSION_LAMBDA( _Contour, _ContourMsg, contour, _ContourMsg contour_msg; for( auto point_it = contour.cbegin(); point_it != contour.cend(); ++point_it ){ _ContourPointMsg point_msg; point_msg.x = point_it->x; point_msg.y = point_it->y; contour_msg.points.push_back( point_msg ); } return contour_msg; )
-DECLARE_UNIT_CONVERSION_LAMBDA( _ContourMsg, _Contour, contour_msg, _Contour contour; for( auto point_it = contour_msg.points.cbegin(); point_it != contour_msg.points.cend(); ++point_it ){ contour.push_back( _Point( point_it->x, point_it->y ) ); } return contour; )
+// =============================================================================================================================================
+//! How contours are written to _ContourMsg
+struct ContourEncoding
+{
+    //! _ContourMsg::ENCODING_POINTS or _ContourMsg::ENCODING_DELTA
+    uint8_t encoding_;
+    //! Maximum distance (in unscaled pixels) of the simplified polygon from the original contour; 0 to disable
+    double tolerance_;
+    //! Maximum number of points per contour; 0 for no limit
+    size_t max_points_;
+
+    ContourEncoding( uint8_t const & encoding = uint8_t( _ContourMsg::ENCODING_POINTS ), double const & tolerance = 0, size_t const & max_points = 0 )
+    :
+        encoding_( encoding ),
+        tolerance_( tolerance ),
+        max_points_( max_points )
+    {
+        //
+    }
+};
+
+//! Simplify contour to within tolerance and to at most max_points points (either may be 0 to skip that limit)
+/*! - if the tolerance-bounded polygon still has too many points, the tolerance is doubled until it fits (up to a point); as a last resort
+      evenly spaced points are kept */
+inline void simplifyContour( _Contour const & contour, double const & tolerance, size_t const & max_points, _Contour & simplified )
+{
+    simplified = contour;
+
+    double epsilon = tolerance > 0 ? tolerance : 1.0;
+    bool const over_limit = max_points > 0 && simplified.size() > max_points;
+
+    if( tolerance > 0 || over_limit )
+    {
+        for( size_t attempt = 0; attempt < 8 && simplified.size() > 2; ++attempt, epsilon *= 2 )
+        {
+            _Contour approximated;
+            cv::approxPolyDP( cv::Mat( contour ), approximated, epsilon, true );
+            simplified.swap( approximated );
+
+            if( max_points == 0 || simplified.size() <= max_points ) break;
+        }
+    }
+
+    if( max_points > 0 && simplified.size() > max_points )
+    {
+        _Contour subsampled;
+        subsampled.reserve( max_points );
+        for( size_t i = 0; i < max_points; ++i )
+        {
+            subsampled.push_back( simplified[i * simplified.size() / max_points] );
+        }
+        simplified.swap( subsampled );
+    }
+}
+
+//! Write contour (in unscaled pixels) into contour_msg with the given encoding; decoded points are contour's points times scale
+inline void encodeContour( _Contour const & contour, double const & scale, uint8_t const & encoding, _ContourMsg & contour_msg )
+{
+    contour_msg.encoding = encoding;
+    contour_msg.point_scale = scale;
+    contour_msg.points.clear();
+    contour_msg.deltas.clear();
+
+    if( encoding == _ContourMsg::ENCODING_DELTA )
+    {
+        // image coordinates fit in int16, so their differences do too
+        contour_msg.deltas.resize( 2 * contour.size() );
+
+        _Point last_point( 0, 0 );
+        for( size_t i = 0; i < contour.size(); ++i )
+        {
+            contour_msg.deltas[2 * i] = contour[i].x - last_point.x;
+            contour_msg.deltas[2 * i + 1] = contour[i].y - last_point.y;
+            last_point = contour[i];
+        }
+        return;
+    }
+
+    contour_msg.points.resize( contour.size() );
+    for( size_t i = 0; i < contour.size(); ++i )
+    {
+        contour_msg.points[i].x = contour[i].x * scale;
+        contour_msg.points[i].y = contour[i].y * scale;
+    }
+}
+
+//! Simplify contour according to contour_encoding, then write it into contour_msg
+inline void encodeContour( _Contour const & contour, double const & scale, ContourEncoding const & contour_encoding, _ContourMsg & contour_msg )
+{
+    if( contour_encoding.tolerance_ <= 0 && ( contour_encoding.max_points_ == 0 || contour.size() <= contour_encoding.max_points_ ) )
+    {
+        encodeContour( contour, scale, contour_encoding.encoding_, contour_msg );
+        return;
+    }
+
+    _Contour simplified;
+    simplifyContour( contour, contour_encoding.tolerance_, contour_encoding.max_points_, simplified );
+    encodeContour( simplified, scale, contour_encoding.encoding_, contour_msg );
+}
+
+//! Read the (scaled) points of contour_msg, in either encoding
+inline void decodeContour( _ContourMsg const & contour_msg, _Contour & contour )
+{
+    if( contour_msg.encoding == _ContourMsg::ENCODING_DELTA )
+    {
+        size_t const num_points = contour_msg.deltas.size() / 2;
+        contour.resize( num_points );
+
+        // messages from before point_scale existed decode as unscaled
+        double const scale = contour_msg.point_scale > 0 ? contour_msg.point_scale : 1.0;
+
+        int x = 0;
+        int y = 0;
+        for( size_t i = 0; i < num_points; ++i )
+        {
+            x += contour_msg.deltas[2 * i];
+            y += contour_msg.deltas[2 * i + 1];
+            contour[i] = _Point( x * scale, y * scale );
+        }
+        return;
+    }
+
+    contour.resize( contour_msg.points.size() );
+    for( size_t i = 0; i < contour_msg.points.size(); ++i )
+    {
+        contour[i] = _Point( contour_msg.points[i].x, contour_msg.points[i].y );
+    }
+}
+
+//! Number of points in contour_msg, in either encoding
+inline size_t getNumContourPoints( _ContourMsg const & contour_msg )
+{
+    return contour_msg.encoding == _ContourMsg::ENCODING_DELTA ? contour_msg.deltas.size() / 2 : contour_msg.points.size();
+}
+
+DECLARE_UNIT_CONVERSION_LAMBDA( _Contour, _ContourMsg, contour, _ContourMsg contour_msg; encodeContour( contour, 1.0, uint8_t( _ContourMsg::ENCODING_POINTS ), contour_msg ); return contour_msg; )
+DECLARE_UNIT_CONVERSION_LAMBDA( _ContourMsg, _Contour, contour_msg, _Contour contour; decodeContour( contour_msg, contour ); return contour; )
 
 #endif // CONTOURMATCHER_CONTOUR_H_
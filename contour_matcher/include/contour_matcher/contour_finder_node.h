@@ -50,6 +50,11 @@
 
 // utils
 #include <contour_matcher/contour.h>
+#include <contour_matcher/blob_extractor.h>
+#include <seabee3_common/label_map.h>
+#include <seabee3_common/snapshot.h>
+#include <seabee3_common/message_worker.h>
+#include <seabee3_common/worker_pool.h>
 
 // actions
 #include <seabee3_actions/ConfigureAction.h>
@@ -61,14 +66,16 @@
 typedef seabee3_msgs::ContourArray _ContourArrayMsg;
 
 typedef seabee3_msgs::NamedImageArray _NamedImageArrayMsg;
+typedef seabee3_msgs::NamedImage _NamedImageMsg;
+typedef seabee::_LabelMapMsg _LabelMapMsg;
 
 typedef seabee3_actions::ConfigureAction _ConfigureAction;
 
 typedef quickdev::ActionServerPolicy<_ConfigureAction> _ConfigureActionServerPolicy;
 
-// cache most recent classified image array
+// cache most recent classified image array or label map
 // start up action server; accept color-specific requests
-// run cv::findContours( ... ) on specified images; publish resulting contours
+// extract the blobs of specified images; publish their contours and shape features
 // publish debug image
 
 QUICKDEV_DECLARE_NODE( ContourFinder, _ConfigureActionServerPolicy )
@@ -79,20 +86,53 @@ protected:
     ros::MultiSubscriber<> multi_sub_;
     ros::MultiPublisher<> multi_pub_;
 
-    std::mutex process_images_mutex_;
-    boost::shared_ptr<boost::thread> process_images_thread_ptr_;
-
     XmlRpc::XmlRpcValue params_;
 
-    std::set<std::string> color_filter_;
-    std::mutex color_filter_mutex_;
+    typedef std::set<std::string> _ColorFilter;
+
+    //! Read once per processing cycle; replaced (never modified) by the configure action
+    seabee::Snapshot<_ColorFilter> color_filter_;
 
-    _NamedImageArrayMsg::ConstPtr images_msg_ptr_;
-    std::mutex images_mutex_;
+    //! Exactly one of these is set: an input in whichever format the classifier publishes
+    struct Input
+    {
+        _NamedImageArrayMsg::ConstPtr images_msg_ptr_;
+        _LabelMapMsg::ConstPtr label_map_msg_ptr_;
+    };
+
+    //! One enabled color's share of a processing cycle
+    struct ColorJob
+    {
+        std::string name_;
+        //! Set for named image inputs
+        _NamedImageMsg const * image_msg_;
+        //! Set for label map inputs
+        uchar label_;
+        int threshold_min_;
+        int threshold_max_;
+        int threshold_type_;
+        //! Filled in by the job
+        cv::Size image_size_;
+        cv::Mat debug_input_image_;
+    };
+
+    //! Colors are extracted concurrently on this pool; size set by ~num_threads
+    boost::shared_ptr<seabee::WorkerPool> worker_pool_;
+
+    //! Only used by the worker thread; blob_extractors_[i] holds the blobs of the cycle's i-th enabled color. Reused across cycles to avoid
+    //! reallocating their buffers
+    std::vector<BlobExtractor> blob_extractors_;
+    std::vector<ColorJob> color_jobs_;
 
     std::map<std::string, cv::Scalar> colors_map_;
 
     bool show_debug_images_;
+    int worker_stats_interval_;
+
+    ContourEncoding contour_encoding_;
+
+    //! Declared last so it's stopped before anything processImages() uses is destroyed
+    seabee::MessageWorker<Input> worker_;
 
     QUICKDEV_DECLARE_NODE_CONSTRUCTOR( ContourFinder )
     {
@@ -105,9 +145,15 @@ protected:
         colors_map_["black"]  = cv::Scalar(   0,   0,   0 );
         colors_map_["white"]  = cv::Scalar( 255, 255, 255 );
 
-        color_filter_.insert( "green" );
-        color_filter_.insert( "orange" );
-        color_filter_.insert( "yellow" );
+        color_filter_.update
+        (
+            []( _ColorFilter & color_filter )
+            {
+                color_filter.insert( "green" );
+                color_filter.insert( "orange" );
+                color_filter.insert( "yellow" );
+            }
+        );
     }
 
     QUICKDEV_SPIN_FIRST()
@@ -115,6 +161,7 @@ protected:
         QUICKDEV_GET_RUNABLE_NODEHANDLE( nh_rel );
 
         multi_sub_.addSubscriber( nh_rel, "classified_images", &ContourFinderNode::namedImageArrayCB, this );
+        multi_sub_.addSubscriber( nh_rel, "label_map", &ContourFinderNode::labelMapCB, this );
         multi_pub_.addPublishers<_ContourArrayMsg>( nh_rel, { "contours" } );
 
         _ConfigureActionServerPolicy::registerExecuteCB( quickdev::auto_bind( &ContourFinderNode::configureActionExecuteCB, this ) );
@@ -123,138 +170,254 @@ protected:
 
         params_ = quickdev::ParamReader::readParam<decltype( params_ )>( nh_rel, "params" );
         show_debug_images_ = quickdev::ParamReader::getXmlRpcValue<bool>( params_, "show_debug_images", false );
+        worker_stats_interval_ = quickdev::ParamReader::readParam<int>( nh_rel, "worker_stats_interval", 300 );
+
+        auto const contour_encoding = quickdev::ParamReader::readParam<std::string>( nh_rel, "contour_encoding", "points" );
+        if( contour_encoding == "delta" ) contour_encoding_.encoding_ = _ContourMsg::ENCODING_DELTA;
+        else if( contour_encoding != "points" ) PRINT_WARN( "Unknown contour_encoding [%s]; using points", contour_encoding.c_str() );
+        contour_encoding_.tolerance_ = quickdev::ParamReader::readParam<double>( nh_rel, "contour_tolerance", 0.0 );
+        contour_encoding_.max_points_ = std::max( quickdev::ParamReader::readParam<int>( nh_rel, "contour_max_points", 0 ), 0 );
+
+        auto const num_threads = quickdev::ParamReader::readParam<int>( nh_rel, "num_threads", 1 );
+        worker_pool_ = boost::make_shared<seabee::WorkerPool>( std::max( num_threads, 1 ) );
+        PRINT_INFO( "Extracting contours with %zu thread(s)", worker_pool_->size() );
 
         initPolicies<quickdev::policy::ALL>();
 
-        process_images_thread_ptr_ = boost::make_shared<boost::thread>( &ContourFinderNode::processImages, this );
+        worker_.setDepth( quickdev::ParamReader::readParam<int>( nh_rel, "queue_depth", 1 ) );
+        worker_.start( quickdev::auto_bind( &ContourFinderNode::processImages, this ) );
     }
 
     QUICKDEV_DECLARE_ACTION_EXECUTE_CALLBACK( configureActionExecuteCB, _ConfigureAction )
     {
-        // lock color_filter mutex
-        auto lock = quickdev::make_unique_lock( color_filter_mutex_ );
-
         auto const & settings = goal->settings;
 
-        // update the color_filter
-        for( auto setting_it = settings.cbegin(); setting_it != settings.cend(); ++setting_it )
-        {
-            auto const & setting = *setting_it;
-
-            if( setting.empty() ) continue;
-
-            // reset the color_filter
-            if( setting == "-all" ) color_filter_.clear();
-            // remove the given item; -<item>
-            else if( setting.substr( 0, 1 ) == "-" ) color_filter_.erase( setting.substr( 1 ) );
-            // add the given item; +<item>
-            else if( setting.substr( 0, 1 ) == "+" ) color_filter_.insert( setting.substr( 1 ) );
-            // default; add the given item <item>
-            else color_filter_.insert( setting );
-        }
+        // update a copy of the color_filter; a processing cycle in flight keeps using the old one
+        color_filter_.update
+        (
+            [&]( _ColorFilter & color_filter )
+            {
+                for( auto setting_it = settings.cbegin(); setting_it != settings.cend(); ++setting_it )
+                {
+                    auto const & setting = *setting_it;
+
+                    if( setting.empty() ) continue;
+
+                    // reset the color_filter
+                    if( setting == "-all" ) color_filter.clear();
+                    // remove the given item; -<item>
+                    else if( setting.substr( 0, 1 ) == "-" ) color_filter.erase( setting.substr( 1 ) );
+                    // add the given item; +<item>
+                    else if( setting.substr( 0, 1 ) == "+" ) color_filter.insert( setting.substr( 1 ) );
+                    // default; add the given item <item>
+                    else color_filter.insert( setting );
+                }
+            }
+        );
     }
 
     QUICKDEV_DECLARE_MESSAGE_CALLBACK( namedImageArrayCB, _NamedImageArrayMsg )
     {
-        PRINT_INFO( "Got new image array" );
-        // try lock image mutex
-        auto lock = quickdev::make_unique_lock( images_mutex_, std::try_to_lock );
-        // drop message if lock failed
-        if( !lock ) return;
-
-        // update image array cache
-        images_msg_ptr_ = msg;
+        Input input;
+        input.images_msg_ptr_ = msg;
+        worker_.post( input );
+    }
 
-        // unlock the processImages thread for one cycle
-        process_images_mutex_.unlock();
+    QUICKDEV_DECLARE_MESSAGE_CALLBACK( labelMapCB, _LabelMapMsg )
+    {
+        Input input;
+        input.label_map_msg_ptr_ = msg;
+        worker_.post( input );
     }
 
-    void processImages()
+    void processImages( Input const & input )
     {
-        while( QUICKDEV_GET_RUNABLE_POLICY()::running() )
+        // use the same color_filter for the whole cycle, even if it's replaced while we work
+        auto const color_filter = color_filter_.get();
+
+        _ContourArrayMsg contour_array_msg;
+
+        cv::Mat debug_image;
+
+        if( input.label_map_msg_ptr_ ) processLabelMap( *input.label_map_msg_ptr_, *color_filter, contour_array_msg, debug_image );
+        else if( input.images_msg_ptr_ ) processNamedImages( input.images_msg_ptr_->images, *color_filter, contour_array_msg, debug_image );
+
+        multi_pub_.publish( "contours", contour_array_msg );
+
+        if( show_debug_images_ && !debug_image.empty() )
         {
-            // make sure mutex is locked once
-            process_images_mutex_.try_lock();
-            // block until new image received
-            auto process_images_lock = quickdev::make_unique_lock( process_images_mutex_ );
+            cv::imshow( "Contours", debug_image );
+            cvWaitKey( 20 );
+        }
 
-            PRINT_INFO( "processing images" );
+        reportWorkerStats();
+    }
 
-            // prevent updates to the color_filter while we process the images
-            auto color_filter_lock = quickdev::make_unique_lock( color_filter_mutex_ );
-            // prevent updates to the images while we process them
-            auto images_lock = quickdev::make_unique_lock( images_mutex_ );
+    //! Periodically log how many inputs were processed or skipped, and how long they waited
+    void reportWorkerStats()
+    {
+        if( worker_stats_interval_ <= 0 ) return;
 
-            auto const & images = images_msg_ptr_->images;
+        auto const stats = worker_.getStats();
+        // this cycle isn't counted as processed until we return
+        if( ( stats.processed_ + 1 ) % worker_stats_interval_ != 0 ) return;
 
-            _ContourArrayMsg contour_array_msg;
+        PRINT_INFO( "Inputs: %s", stats.toString().c_str() );
+    }
 
-            cv::Mat debug_image;
+    //! Start a job for the given color, with its threshold settings
+    ColorJob & addColorJob( std::string const & image_name )
+    {
+        auto image_params = quickdev::ParamReader::getXmlRpcValue<XmlRpc::XmlRpcValue>( params_, image_name );
+
+        ColorJob color_job;
+        color_job.name_ = image_name;
+        color_job.image_msg_ = NULL;
+        color_job.label_ = 0;
+        color_job.threshold_min_ = quickdev::ParamReader::getXmlRpcValue<int>( image_params, "threshold_min", 100 );
+        color_job.threshold_max_ = quickdev::ParamReader::getXmlRpcValue<int>( image_params, "threshold_max", 255 );
+        color_job.threshold_type_ = quickdev::ParamReader::getXmlRpcValue<int>( image_params, "threshold_type", cv::THRESH_TOZERO );
+
+        color_jobs_.push_back( color_job );
+        return color_jobs_.back();
+    }
+
+    //! Run func( job_idx ) for each of color_jobs_ on the worker pool, each writing only to blob_extractors_[job_idx] and color_jobs_[job_idx]
+    template<class __JobFunc>
+    void runColorJobs( __JobFunc const & func )
+    {
+        if( blob_extractors_.size() < color_jobs_.size() ) blob_extractors_.resize( color_jobs_.size() );
 
-            for( auto images_msg_it = images.cbegin(); images_msg_it != images.cend(); ++images_msg_it )
+        worker_pool_->parallelFor
+        (
+            color_jobs_.size(),
+            [&]( size_t const & begin, size_t const & end )
             {
-                auto const & image_name = images_msg_it->name;
-                if( !color_filter_.count( image_name ) ) continue;
+                for( size_t job_idx = begin; job_idx < end; ++job_idx )
+                {
+                    func( job_idx );
+                }
+            }
+        );
+    }
 
-                auto const & images_msg = *images_msg_it;
+    void processNamedImages( std::vector<_NamedImageMsg> const & images, _ColorFilter const & color_filter, _ContourArrayMsg & contour_array_msg, cv::Mat & debug_image )
+    {
+        color_jobs_.clear();
+
+        for( auto images_msg_it = images.cbegin(); images_msg_it != images.cend(); ++images_msg_it )
+        {
+            if( !color_filter.count( images_msg_it->name ) ) continue;
+
+            addColorJob( images_msg_it->name ).image_msg_ = &*images_msg_it;
+        }
 
-                auto const cv_image_ptr = quickdev::opencv_conversion::fromImageMsg( images_msg.image );
+        runColorJobs
+        (
+            [&]( size_t const & job_idx )
+            {
+                auto & color_job = color_jobs_[job_idx];
+
+                auto const cv_image_ptr = quickdev::opencv_conversion::fromImageMsg( color_job.image_msg_->image );
                 cv::Mat const & image = cv_image_ptr->image;
 
-                auto image_params = quickdev::ParamReader::getXmlRpcValue<XmlRpc::XmlRpcValue>( params_, image_name );
-                auto const threshold_min = quickdev::ParamReader::getXmlRpcValue<int>( image_params, "threshold_min", 100 );
-                auto const threshold_max = quickdev::ParamReader::getXmlRpcValue<int>( image_params, "threshold_max", 255 );
-                auto const threshold_type = quickdev::ParamReader::getXmlRpcValue<int>( image_params, "threshold_type", cv::THRESH_TOZERO );
+                // threshold and label in one pass straight off the message's pixels
+                blob_extractors_[job_idx].extract( image, color_job.threshold_min_, color_job.threshold_max_, color_job.threshold_type_ );
 
-                cv::Mat normalized_image;
-                cv::Mat thresholded_image;
-                cv::Mat contour_image;
+                color_job.image_size_ = image.size();
+                if( show_debug_images_ ) image.copyTo( color_job.debug_input_image_ );
+            }
+        );
 
-                image.copyTo( normalized_image );
-                //cv::GaussianBlur( image, normalized_image, cv::Size( 11, 11 ), 5 );
-                //cv::normalize( image, normalized_image, 0, 255, CV_MINMAX );
-                //cv::adaptiveThreshold( normalized_image, thresholded_image, 255, cv::ADAPTIVE_THRESH_GAUSSIAN_C, cv::THRESH_BINARY, 7, 0 );
-                cv::threshold( image, thresholded_image, threshold_min, threshold_max, threshold_type );
-                thresholded_image.copyTo( contour_image );
+        // merge in input order, regardless of which thread finished first
+        for( size_t job_idx = 0; job_idx < color_jobs_.size(); ++job_idx )
+        {
+            auto const & color_job = color_jobs_[job_idx];
 
-                std::vector<_Contour> contours;
-                cv::findContours( contour_image, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE );
+            if( show_debug_images_ ) cv::imshow( color_job.name_ + " input", color_job.debug_input_image_ );
 
-                for( auto contour_it = contours.cbegin(); contour_it != contours.cend(); ++contour_it )
-                {
-                    auto const & contour = *contour_it;
+            addContours( color_job.name_, blob_extractors_[job_idx], color_job.image_size_, 1.0, contour_array_msg, debug_image );
+        }
+    }
 
-                    _ContourMsg contour_msg = unit::implicit_convert( contour );
-                    contour_msg.name = image_name;
+    // a label map carries every enabled color in a single image; each color's binary image is the set of pixels labeled with that color
+    // whose confidence passes the color's threshold
+    void processLabelMap( _LabelMapMsg const & label_map_msg, _ColorFilter const & color_filter, _ContourArrayMsg & contour_array_msg, cv::Mat & debug_image )
+    {
+        cv::Mat labels;
+        cv::Mat confidence;
 
-                    contour_array_msg.contours.push_back( contour_msg );
-                }
+        if( !seabee::decodeLabelMap( label_map_msg, labels, confidence ) )
+        {
+            PRINT_WARN( "Dropping malformed label map" );
+            return;
+        }
 
-                if( show_debug_images_ )
-                {
-                    cv::imshow( image_name + " input", image );
-                    cv::imshow( image_name + " normalized", normalized_image );
-                    cv::imshow( image_name + " thresholded", thresholded_image );
+        color_jobs_.clear();
 
-                    if( debug_image.empty() ) debug_image = cv::Mat( image.size(), CV_8UC3, cv::Scalar( 0, 0, 0 ) );
+        for( size_t label = 0; label < label_map_msg.color_names.size(); ++label )
+        {
+            if( !color_filter.count( label_map_msg.color_names[label] ) ) continue;
 
-                    auto color_it = colors_map_.find( image_name );
-                    cv::Scalar color = color_it != colors_map_.end() ? color_it->second : cv::Scalar( 255, 0, 255 );
+            addColorJob( label_map_msg.color_names[label] ).label_ = label;
+        }
 
-                    for( size_t contour_idx = 0; contour_idx < contours.size(); ++contour_idx )
+        runColorJobs
+        (
+            [&]( size_t const & job_idx )
+            {
+                auto & color_job = color_jobs_[job_idx];
+                uchar const label_value = color_job.label_;
+                int const threshold_min = color_job.threshold_min_;
+
+                blob_extractors_[job_idx].extract
+                (
+                    labels.rows,
+                    labels.cols,
+                    [&]( int const & y, int const & x )
                     {
-
-                        cv::drawContours( debug_image, contours, contour_idx, color );
+                        return labels.ptr<uchar>( y )[x] == label_value && confidence.ptr<uchar>( y )[x] > threshold_min;
                     }
-                }
+                );
+
+                color_job.image_size_ = labels.size();
             }
+        );
+
+        for( size_t job_idx = 0; job_idx < color_jobs_.size(); ++job_idx )
+        {
+            auto const & color_job = color_jobs_[job_idx];
+            addContours( color_job.name_, blob_extractors_[job_idx], color_job.image_size_, label_map_msg.scale, contour_array_msg, debug_image );
+        }
+    }
+
+    //! Add the blobs found by the given extractor to contour_array_msg, scaled by scale into source image coordinates
+    void addContours( std::string const & image_name, BlobExtractor const & blob_extractor, cv::Size const & image_size, double const & scale, _ContourArrayMsg & contour_array_msg, cv::Mat & debug_image )
+    {
+        auto const & blobs = blob_extractor.getBlobs();
 
-            multi_pub_.publish( "contours", contour_array_msg );
+        for( auto blob_it = blobs.cbegin(); blob_it != blobs.cend(); ++blob_it )
+        {
+            contour_array_msg.contours.push_back( _ContourMsg() );
+            blobToMsg( *blob_it, image_name, scale, contour_encoding_, contour_array_msg.contours.back() );
+        }
+
+        if( show_debug_images_ )
+        {
+            if( debug_image.empty() ) debug_image = cv::Mat( image_size, CV_8UC3, cv::Scalar( 0, 0, 0 ) );
+
+            auto color_it = colors_map_.find( image_name );
+            cv::Scalar color = color_it != colors_map_.end() ? color_it->second : cv::Scalar( 255, 0, 255 );
+
+            std::vector<_Contour> contours;
+            for( auto blob_it = blobs.cbegin(); blob_it != blobs.cend(); ++blob_it )
+            {
+                contours.push_back( blob_it->contour_ );
+            }
 
-            if( show_debug_images_ )
+            for( size_t contour_idx = 0; contour_idx < contours.size(); ++contour_idx )
             {
-                cv::imshow( "Contours", debug_image );
-                cvWaitKey( 20 );
+                cv::drawContours( debug_image, contours, contour_idx, color );
             }
         }
     }
@@ -43,25 +43,37 @@
 
 // objects
 #include <quickdev/multi_subscriber.h>
+#include <quickdev/multi_publisher.h>
+#include <quickdev/param_reader.h>
+#include <contour_matcher/shape_matcher.h>
+#include <contour_matcher/blob_extractor.h>
 
 // utils
 #include <contour_matcher/contour.h>
+#include <algorithm>
+#include <dirent.h>
+#include <sstream>
+#include <opencv/highgui.h>
 
 // actions
 #include <seabee3_actions/MatchContoursAction.h>
 
 // msgs
 #include <seabee3_msgs/ContourArray.h>
+#include <seabee3_msgs/MatchQualityArray.h>
 
 typedef seabee3_msgs::ContourArray _ContourArrayMsg;
 typedef seabee3_msgs::Contour _ContourMsg;
+typedef seabee3_msgs::MatchQualityArray _MatchQualityArrayMsg;
+typedef seabee3_msgs::MatchQuality _MatchQualityMsg;
 
 typedef seabee3_actions::MatchContoursAction _MatchContoursAction;
 
 typedef quickdev::ActionServerPolicy<_MatchContoursAction> _MatchContoursActionServerPolicy;
 
-// subscribe to contours from contour_finder
-// when request comes in, ignore new contours until request is completed
+// load a library of template shapes at startup
+// subscribe to contours from contour_finder; publish the best template match for each contour
+// when request comes in, score its candidates (or the most recent contours) against its templates (or the library)
 
 QUICKDEV_DECLARE_NODE( ContourMatcher, _MatchContoursActionServerPolicy )
 
@@ -69,28 +81,216 @@ QUICKDEV_DECLARE_NODE_CLASS( ContourMatcher )
 {
 protected:
     ros::MultiSubscriber<> multi_sub_;
+    ros::MultiPublisher<> multi_pub_;
+
+    //! Templates loaded from ~template_library_uri; shared by contoursCB and the action, so guarded by library_mutex_
+    ShapeMatcher library_matcher_;
+    std::mutex library_mutex_;
+
+    double hu_weight_;
+    double fourier_weight_;
+    //! Matches below this quality aren't published
+    double min_match_quality_;
+
+    //! Most recent contours, for requests that don't supply their own candidates; never modified once received
+    _ContourArrayMsg::ConstPtr contours_msg_ptr_;
+    std::mutex contours_mutex_;
+
+    //! Scratch space for contoursCB
+    std::vector<_Contour> candidates_;
+    std::vector<float> qualities_;
 
     QUICKDEV_DECLARE_NODE_CONSTRUCTOR( ContourMatcher )
     {
         //
     }
+
     QUICKDEV_SPIN_FIRST()
     {
         QUICKDEV_GET_RUNABLE_NODEHANDLE( nh_rel );
 
+        hu_weight_ = quickdev::ParamReader::readParam<double>( nh_rel, "hu_weight", 1.0 );
+        fourier_weight_ = quickdev::ParamReader::readParam<double>( nh_rel, "fourier_weight", 1.0 );
+        min_match_quality_ = quickdev::ParamReader::readParam<double>( nh_rel, "min_match_quality", 0.5 );
+
+        library_matcher_.setWeights( hu_weight_, fourier_weight_ );
+
+        auto const template_library_uri = quickdev::ParamReader::readParam<std::string>( nh_rel, "template_library_uri", "" );
+        if( !template_library_uri.empty() ) loadTemplateLibrary( template_library_uri );
+
         multi_sub_.addSubscriber( nh_rel, "input_contours", &ContourMatcherNode::contoursCB, this );
+        multi_pub_.addPublishers<_MatchQualityArrayMsg>( nh_rel, { "matches" } );
+
+        _MatchContoursActionServerPolicy::registerExecuteCB( quickdev::auto_bind( &ContourMatcherNode::matchContoursActionExecuteCB, this ) );
+
+        initPolicies<_MatchContoursActionServerPolicy>( "action_name_param", std::string( "match_contours" ) );
 
         initPolicies<quickdev::policy::ALL>();
     }
 
+    //! Add the largest blob of every image in folder to the library, named after the image's file name (without its extension)
+    void loadTemplateLibrary( std::string const & folder )
+    {
+        DIR * dir = opendir( folder.c_str() );
+        if( !dir )
+        {
+            PRINT_ERROR( "Failed to open template library %s", folder.c_str() );
+            return;
+        }
+
+        std::vector<std::string> filenames;
+        while( struct dirent * entry = readdir( dir ) )
+        {
+            std::string const filename( entry->d_name );
+            if( filename.empty() || filename[0] == '.' ) continue;
+            filenames.push_back( filename );
+        }
+
+        closedir( dir );
+
+        // readdir order is arbitrary; sort so template indices are the same every run
+        std::sort( filenames.begin(), filenames.end() );
+
+        BlobExtractor blob_extractor;
+
+        auto library_lock = quickdev::make_unique_lock( library_mutex_ );
+
+        for( auto filename_it = filenames.cbegin(); filename_it != filenames.cend(); ++filename_it )
+        {
+            auto const & filename = *filename_it;
+
+            cv::Mat const image = cv::imread( folder + "/" + filename, 0 );
+            if( image.empty() ) continue;
+
+            blob_extractor.extract( image, 127, 255, cv::THRESH_BINARY );
+            auto const & blobs = blob_extractor.getBlobs();
+
+            auto const largest_blob_it = std::max_element( blobs.cbegin(), blobs.cend(), []( Blob const & a, Blob const & b ){ return a.area_ < b.area_; } );
+            if( largest_blob_it == blobs.cend() )
+            {
+                PRINT_WARN( "Template image %s is empty", filename.c_str() );
+                continue;
+            }
+
+            auto const template_id = filename.substr( 0, filename.rfind( '.' ) );
+            if( !library_matcher_.addTemplate( template_id, largest_blob_it->contour_ ) ) PRINT_WARN( "Template %s is degenerate and will never match", template_id.c_str() );
+        }
+
+        PRINT_INFO( "Loaded %zu templates from %s", library_matcher_.size(), folder.c_str() );
+    }
+
+    //! Unique name for the contour_idx-th contour of a list; <name>/<contour_idx>
+    static std::string getContourId( _ContourMsg const & contour_msg, size_t const & contour_idx )
+    {
+        std::stringstream contour_id;
+        contour_id << ( contour_msg.name.empty() ? "contour" : contour_msg.name ) << "/" << contour_idx;
+        return contour_id.str();
+    }
+
+    static void decodeContours( std::vector<_ContourMsg> const & contour_msgs, std::vector<_Contour> & contours )
+    {
+        contours.resize( contour_msgs.size() );
+        for( size_t contour_idx = 0; contour_idx < contour_msgs.size(); ++contour_idx )
+        {
+            decodeContour( contour_msgs[contour_idx], contours[contour_idx] );
+        }
+    }
+
     QUICKDEV_DECLARE_ACTION_EXECUTE_CALLBACK( matchContoursActionExecuteCB, _MatchContoursAction )
     {
-        //
+        // score against the request's templates if it has any, otherwise against a copy of the library
+        ShapeMatcher matcher( hu_weight_, fourier_weight_ );
+        std::vector<std::string> template_ids;
+
+        if( !goal->template_contours.empty() )
+        {
+            for( size_t template_idx = 0; template_idx < goal->template_contours.size(); ++template_idx )
+            {
+                auto const & template_msg = goal->template_contours[template_idx];
+                _Contour template_contour;
+                decodeContour( template_msg, template_contour );
+                matcher.addTemplate( getContourId( template_msg, template_idx ), template_contour );
+            }
+        }
+        else
+        {
+            auto library_lock = quickdev::make_unique_lock( library_mutex_ );
+            matcher = library_matcher_;
+        }
+
+        if( matcher.size() == 0 )
+        {
+            PRINT_WARN( "No templates to match against" );
+            return _MatchContoursActionServerPolicy::setAborted();
+        }
+
+        // likewise, the request's candidates or the most recent contours
+        _ContourArrayMsg::ConstPtr contours_msg_ptr;
+        {
+            auto contours_lock = quickdev::make_unique_lock( contours_mutex_ );
+            contours_msg_ptr = contours_msg_ptr_;
+        }
+
+        auto const & candidate_msgs = !goal->candidate_contours.empty() || !contours_msg_ptr ? goal->candidate_contours : contours_msg_ptr->contours;
+
+        std::vector<_Contour> candidates;
+        decodeContours( candidate_msgs, candidates );
+
+        std::vector<float> qualities;
+        matcher.score( candidates, qualities );
+
+        _MatchContoursActionServerPolicy::_ResultMsg result;
+        result.matches.resize( candidates.size() );
+
+        for( size_t candidate_idx = 0; candidate_idx < candidates.size(); ++candidate_idx )
+        {
+            auto & match_quality_array_msg = result.matches[candidate_idx];
+            match_quality_array_msg.candidate_id = getContourId( candidate_msgs[candidate_idx], candidate_idx );
+            match_quality_array_msg.match_qualites.resize( matcher.size() );
+
+            for( size_t template_idx = 0; template_idx < matcher.size(); ++template_idx )
+            {
+                auto & match_quality_msg = match_quality_array_msg.match_qualites[template_idx];
+                match_quality_msg.template_id = matcher.getTemplateId( template_idx );
+                match_quality_msg.match_quality = qualities[candidate_idx * matcher.size() + template_idx];
+            }
+        }
+
+        return _MatchContoursActionServerPolicy::setSuccessful( result );
     }
 
+    //! Score each incoming contour against the whole library in one batch, and publish each contour's best match as its own MatchQualityArray
     QUICKDEV_DECLARE_MESSAGE_CALLBACK( contoursCB, _ContourArrayMsg )
     {
-        //
+        {
+            auto contours_lock = quickdev::make_unique_lock( contours_mutex_ );
+            contours_msg_ptr_ = msg;
+        }
+
+        auto library_lock = quickdev::make_unique_lock( library_mutex_ );
+        if( library_matcher_.size() == 0 ) return;
+
+        decodeContours( msg->contours, candidates_ );
+        library_matcher_.score( candidates_, qualities_ );
+
+        for( size_t candidate_idx = 0; candidate_idx < candidates_.size(); ++candidate_idx )
+        {
+            float const * const candidate_qualities = qualities_.data() + candidate_idx * library_matcher_.size();
+            size_t const best_template_idx = std::max_element( candidate_qualities, candidate_qualities + library_matcher_.size() ) - candidate_qualities;
+
+            if( candidate_qualities[best_template_idx] < min_match_quality_ ) continue;
+
+            // a MatchQualityArray describes a single candidate
+            _MatchQualityArrayMsg match_quality_array_msg;
+            match_quality_array_msg.candidate_id = getContourId( msg->contours[candidate_idx], candidate_idx );
+
+            _MatchQualityMsg match_quality_msg;
+            match_quality_msg.template_id = library_matcher_.getTemplateId( best_template_idx );
+            match_quality_msg.match_quality = candidate_qualities[best_template_idx];
+            match_quality_array_msg.match_qualites.push_back( match_quality_msg );
+
+            multi_pub_.publish( "matches", match_quality_array_msg );
+        }
     }
 
     QUICKDEV_SPIN_ONCE()
@@ -0,0 +1,310 @@
+/***************************************************************************
+ *  contour_matcher/include/contour_matcher/shape_matcher.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef CONTOURMATCHER_SHAPEMATCHER_H_
+#define CONTOURMATCHER_SHAPEMATCHER_H_
+
+// objects
+#include <opencv/cv.hpp>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <math.h>
+
+// utils
+#include <contour_matcher/contour.h>
+
+// =============================================================================================================================================
+//! Translation-, rotation-, scale-, and start-point-invariant features of a closed contour
+/*! - the 7 Hu moments, each taken to the root that makes it scale like a length ratio, so near-zero moments of symmetric shapes stay
+      near zero instead of blowing up under a log
+    - the magnitudes of the low-frequency Fourier coefficients of the boundary (resampled to NUM_SAMPLES points by arc length),
+      normalized by the fundamental; the boundary is first made counter-clockwise so mirrored traversals agree */
+class ShapeDescriptor
+{
+public:
+    static size_t const NUM_HU_MOMENTS = 7;
+    //! Coefficients -NUM_FOURIER_DESCRIPTORS / 2 .. NUM_FOURIER_DESCRIPTORS / 2 + 1, skipping 0 (position) and 1 (the fundamental)
+    static size_t const NUM_FOURIER_DESCRIPTORS = 16;
+    static size_t const NUM_FEATURES = NUM_HU_MOMENTS + NUM_FOURIER_DESCRIPTORS;
+    static size_t const NUM_SAMPLES = 64;
+
+    //! Write NUM_FEATURES features for contour into features; returns false (leaving features zeroed) if the contour is degenerate
+    static bool compute( _Contour const & contour, float * features )
+    {
+        std::fill( features, features + NUM_FEATURES, 0.0f );
+
+        if( contour.size() < 3 ) return false;
+
+        cv::Moments const moments = cv::moments( cv::Mat( contour ) );
+        if( fabs( moments.m00 ) < 1 ) return false;
+
+        double hu_moments[NUM_HU_MOMENTS];
+        cv::HuMoments( moments, hu_moments );
+
+        static double const HU_ROOTS[NUM_HU_MOMENTS] = { 1, 2, 3, 3, 6, 4, 6 };
+        for( size_t i = 0; i < NUM_HU_MOMENTS; ++i )
+        {
+            double const magnitude = pow( fabs( hu_moments[i] ), 1.0 / HU_ROOTS[i] );
+            features[i] = hu_moments[i] < 0 ? -magnitude : magnitude;
+        }
+
+        return computeFourierDescriptors( contour, features + NUM_HU_MOMENTS );
+    }
+
+protected:
+    static bool computeFourierDescriptors( _Contour const & contour, float * descriptors )
+    {
+        size_t const num_points = contour.size();
+
+        // shoelace; > 0 means counter-clockwise in a y-up frame
+        double signed_area = 0;
+        for( size_t i = 0; i < num_points; ++i )
+        {
+            auto const & point = contour[i];
+            auto const & next_point = contour[( i + 1 ) % num_points];
+            signed_area += double( point.x ) * next_point.y - double( next_point.x ) * point.y;
+        }
+        bool const reverse = signed_area < 0;
+
+        auto const getPoint = [&]( size_t const & i ) -> _Point const & { return contour[reverse ? num_points - 1 - i : i]; };
+
+        double perimeter = 0;
+        for( size_t i = 0; i < num_points; ++i )
+        {
+            perimeter += cv::norm( getPoint( ( i + 1 ) % num_points ) - getPoint( i ) );
+        }
+        if( perimeter <= 0 ) return false;
+
+        // resample by arc length
+        double samples_x[NUM_SAMPLES];
+        double samples_y[NUM_SAMPLES];
+
+        double segment_begin = 0;
+        size_t segment = 0;
+        double segment_length = cv::norm( getPoint( 1 ) - getPoint( 0 ) );
+
+        for( size_t sample = 0; sample < NUM_SAMPLES; ++sample )
+        {
+            double const position = perimeter * sample / NUM_SAMPLES;
+            while( segment + 1 < num_points && segment_begin + segment_length < position )
+            {
+                segment_begin += segment_length;
+                ++segment;
+                segment_length = cv::norm( getPoint( ( segment + 1 ) % num_points ) - getPoint( segment ) );
+            }
+
+            auto const & begin = getPoint( segment );
+            auto const & end = getPoint( ( segment + 1 ) % num_points );
+            double const t = segment_length > 0 ? std::min( 1.0, ( position - segment_begin ) / segment_length ) : 0;
+
+            samples_x[sample] = begin.x + t * ( end.x - begin.x );
+            samples_y[sample] = begin.y + t * ( end.y - begin.y );
+        }
+
+        // DFT at the few frequencies we need; the twiddle table is shared by every call
+        static std::vector<double> const cos_table = makeTwiddleTable( true );
+        static std::vector<double> const sin_table = makeTwiddleTable( false );
+
+        auto const magnitude = [&]( int const & frequency )
+        {
+            int const num_samples = NUM_SAMPLES;
+            size_t const wrapped_frequency = ( frequency % num_samples + num_samples ) % num_samples;
+
+            double real = 0;
+            double imaginary = 0;
+            for( size_t sample = 0; sample < NUM_SAMPLES; ++sample )
+            {
+                size_t const phase = ( wrapped_frequency * sample ) % NUM_SAMPLES;
+                // ( x + iy ) * ( cos - i sin )
+                real += samples_x[sample] * cos_table[phase] + samples_y[sample] * sin_table[phase];
+                imaginary += samples_y[sample] * cos_table[phase] - samples_x[sample] * sin_table[phase];
+            }
+            return sqrt( real * real + imaginary * imaginary );
+        };
+
+        double const fundamental = magnitude( 1 );
+        if( fundamental <= 1e-9 ) return false;
+
+        int const half = NUM_FOURIER_DESCRIPTORS / 2;
+        size_t descriptor_idx = 0;
+        for( int frequency = -half; frequency <= half + 1; ++frequency )
+        {
+            if( frequency == 0 || frequency == 1 ) continue;
+            descriptors[descriptor_idx++] = magnitude( frequency ) / fundamental;
+        }
+
+        return true;
+    }
+
+    static std::vector<double> makeTwiddleTable( bool const & cosine )
+    {
+        std::vector<double> table( NUM_SAMPLES );
+        for( size_t phase = 0; phase < NUM_SAMPLES; ++phase )
+        {
+            double const angle = 2 * M_PI * phase / NUM_SAMPLES;
+            table[phase] = cosine ? cos( angle ) : sin( angle );
+        }
+        return table;
+    }
+};
+
+// =============================================================================================================================================
+//! A library of template shapes, scored against batches of candidate contours
+/*! - template features are computed once, weighted, and stored contiguously (one row per template), so scoring a candidate against every
+      template is a single pass over one flat array
+    - distance is the weighted L1 distance between features; match quality is 1 / ( 1 + distance ), so an identical shape scores 1
+    - degenerate templates or candidates always score 0 */
+class ShapeMatcher
+{
+protected:
+    std::vector<std::string> template_ids_;
+    //! template_features_[i * NUM_FEATURES + j] is feature j of template i, already weighted
+    std::vector<float> template_features_;
+    std::vector<bool> template_valid_;
+
+    float weights_[ShapeDescriptor::NUM_FEATURES];
+
+    //! Scratch space for a batch of candidates
+    std::vector<float> candidate_features_;
+    std::vector<bool> candidate_valid_;
+
+public:
+    ShapeMatcher( double const & hu_weight = 1.0, double const & fourier_weight = 1.0 )
+    {
+        setWeights( hu_weight, fourier_weight );
+    }
+
+    //! Relative importance of the Hu moments and the Fourier descriptors; clears the library, since stored features are pre-weighted
+    void setWeights( double const & hu_weight, double const & fourier_weight )
+    {
+        for( size_t i = 0; i < ShapeDescriptor::NUM_FEATURES; ++i )
+        {
+            weights_[i] = i < ShapeDescriptor::NUM_HU_MOMENTS ? hu_weight : fourier_weight;
+        }
+        clearTemplates();
+    }
+
+    void clearTemplates()
+    {
+        template_ids_.clear();
+        template_features_.clear();
+        template_valid_.clear();
+    }
+
+    //! Add a template; returns false if its contour is degenerate (it is still added, but never matches)
+    bool addTemplate( std::string const & id, _Contour const & contour )
+    {
+        size_t const num_features = ShapeDescriptor::NUM_FEATURES;
+
+        template_ids_.push_back( id );
+        template_features_.resize( template_features_.size() + num_features );
+
+        bool const valid = describe( contour, &template_features_[template_features_.size() - num_features] );
+        template_valid_.push_back( valid );
+
+        return valid;
+    }
+
+    size_t size() const
+    {
+        return template_ids_.size();
+    }
+
+    std::string const & getTemplateId( size_t const & template_idx ) const
+    {
+        return template_ids_[template_idx];
+    }
+
+    //! Weighted features of contour, in the layout of template_features_
+    bool describe( _Contour const & contour, float * features ) const
+    {
+        bool const valid = ShapeDescriptor::compute( contour, features );
+        for( size_t i = 0; i < ShapeDescriptor::NUM_FEATURES; ++i )
+        {
+            features[i] *= weights_[i];
+        }
+        return valid;
+    }
+
+    //! Score every candidate against every template; qualities is row-major, one row of size() qualities per candidate
+    void score( std::vector<_Contour> const & candidates, std::vector<float> & qualities )
+    {
+        size_t const num_features = ShapeDescriptor::NUM_FEATURES;
+
+        candidate_features_.resize( candidates.size() * num_features );
+        candidate_valid_.resize( candidates.size() );
+
+        for( size_t candidate_idx = 0; candidate_idx < candidates.size(); ++candidate_idx )
+        {
+            candidate_valid_[candidate_idx] = describe( candidates[candidate_idx], &candidate_features_[candidate_idx * num_features] );
+        }
+
+        qualities.resize( candidates.size() * size() );
+
+        for( size_t candidate_idx = 0; candidate_idx < candidates.size(); ++candidate_idx )
+        {
+            float * const candidate_qualities = qualities.data() + candidate_idx * size();
+
+            if( !candidate_valid_[candidate_idx] )
+            {
+                std::fill( candidate_qualities, candidate_qualities + size(), 0.0f );
+                continue;
+            }
+
+            scoreFeatures( &candidate_features_[candidate_idx * num_features], candidate_qualities );
+        }
+    }
+
+    //! Score one candidate's weighted features against every template
+    void scoreFeatures( float const * candidate_features, float * qualities ) const
+    {
+        size_t const num_features = ShapeDescriptor::NUM_FEATURES;
+        float const * template_features = template_features_.data();
+
+        for( size_t template_idx = 0; template_idx < size(); ++template_idx, template_features += num_features )
+        {
+            float distance = 0;
+            for( size_t i = 0; i < num_features; ++i )
+            {
+                distance += fabsf( candidate_features[i] - template_features[i] );
+            }
+
+            qualities[template_idx] = template_valid_[template_idx] ? 1.0f / ( 1.0f + distance ) : 0.0f;
+        }
+    }
+};
+
+#endif // CONTOURMATCHER_SHAPEMATCHER_H_
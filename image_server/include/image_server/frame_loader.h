@@ -0,0 +1,398 @@
+/***************************************************************************
+ *  include/image_server/frame_loader.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef IMAGESERVER_FRAMELOADER_H_
+#define IMAGESERVER_FRAMELOADER_H_
+
+// objects
+#include <boost/thread.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <opencv2/core/core.hpp>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// utils
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdio>
+
+// =============================================================================================================================================
+//! Loads a numbered sequence of images on demand, keeping a bounded number of decoded frames
+/*!
+ * - Nothing is decoded up front; setFiles() only checks which files exist
+ * - Decoded frames live in an LRU cache of at most cache_size frames, so memory doesn't depend on the length of the sequence
+ * - A background thread reads ahead of the most recently requested frame, in the direction of playback, and keeps a few frames behind it so
+ *   reversing direction doesn't miss; frames in that window are never evicted
+ * - Frames are handed out as shared pointers to immutable images, so they stay valid after being evicted for as long as the caller needs
+ */
+class FrameLoader : boost::noncopyable
+{
+public:
+    typedef boost::shared_ptr<cv::Mat const> _FramePtr;
+
+    struct Stats
+    {
+        size_t hits_;
+        size_t misses_;
+        size_t prefetched_;
+    };
+
+protected:
+    typedef std::list<size_t> _LruList;
+
+    struct CacheEntry
+    {
+        _FramePtr frame_;
+        _LruList::iterator lru_it_;
+    };
+
+    std::vector<std::string> paths_;
+    int width_;
+    int height_;
+
+    size_t cache_size_;
+    size_t read_ahead_;
+    size_t read_behind_;
+    bool loop_;
+
+    std::map<size_t, CacheEntry> cache_;
+    //! Most recently used first
+    _LruList lru_;
+
+    std::mutex mutex_;
+    std::condition_variable prefetch_condition_;
+
+    //! Frames the prefetcher should have ready, nearest first; protected from eviction
+    std::vector<size_t> window_;
+    //! Incremented whenever window_ changes, so the prefetcher can drop stale work
+    size_t generation_;
+    bool running_;
+
+    Stats stats_;
+
+    boost::shared_ptr<boost::thread> prefetch_thread_;
+
+public:
+    FrameLoader()
+    :
+        width_( -1 ),
+        height_( -1 ),
+        cache_size_( 32 ),
+        read_ahead_( 8 ),
+        read_behind_( 2 ),
+        loop_( false ),
+        generation_( 0 ),
+        running_( false )
+    {
+        stats_.hits_ = stats_.misses_ = stats_.prefetched_ = 0;
+    }
+
+    ~FrameLoader()
+    {
+        stop();
+    }
+
+    //! Find the frames <prefix><zero-padded number><ext> for numbers in [start, end]; missing files are skipped
+    /*! \return the number of frames found */
+    size_t setFiles( std::string const & prefix, std::string const & ext, int const & digits, int const & start, int const & end )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        paths_.clear();
+        cache_.clear();
+        lru_.clear();
+        window_.clear();
+        ++generation_;
+
+        std::vector<char> number( std::max( digits, 0 ) + 16 );
+        for( int frame = start; frame <= end; ++frame )
+        {
+            snprintf( number.data(), number.size(), "%0*d", std::max( digits, 0 ), frame );
+            std::string const path = prefix + number.data() + ext;
+
+            struct stat file_stat;
+            if( stat( path.c_str(), &file_stat ) == 0 ) paths_.push_back( path );
+        }
+
+        return paths_.size();
+    }
+
+    //! Resize frames to width x height as they're loaded; if either is <= 0, frames are left as they are
+    void setSize( int const & width, int const & height )
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex_ );
+
+            width_ = width;
+            height_ = height;
+            cache_.clear();
+            lru_.clear();
+            // the window is unchanged, but everything in it is gone; have the prefetcher refill it now rather than when playback moves
+            ++generation_;
+        }
+        prefetch_condition_.notify_all();
+    }
+
+    //! Keep up to cache_size decoded frames; read read_ahead frames ahead of playback and keep read_behind frames behind it
+    void setCacheSize( size_t const & cache_size, size_t const & read_ahead, size_t const & read_behind )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        read_ahead_ = read_ahead;
+        read_behind_ = read_behind;
+        // the current frame and everything in the prefetch window must fit
+        cache_size_ = std::max( cache_size, read_ahead + read_behind + 1 );
+        evict();
+    }
+
+    //! Whether read-ahead wraps around the ends of the sequence
+    void setLoop( bool const & loop )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        loop_ = loop;
+    }
+
+    size_t size() const
+    {
+        return paths_.size();
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        return stats_;
+    }
+
+    void start()
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        if( running_ ) return;
+
+        running_ = true;
+        prefetch_thread_ = boost::make_shared<boost::thread>( &FrameLoader::prefetchLoop, this );
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex_ );
+            if( !running_ ) return;
+            running_ = false;
+        }
+        prefetch_condition_.notify_all();
+
+        prefetch_thread_->join();
+        prefetch_thread_.reset();
+    }
+
+    //! Get frame index, decoding it now if it isn't cached; direction (1: forward, -1: reverse) steers read-ahead
+    /*! \return the frame, or an empty pointer if index is out of range or the file can't be read */
+    _FramePtr get( size_t const & index, int const & direction = 1 )
+    {
+        std::unique_lock<std::mutex> lock( mutex_ );
+
+        if( index >= paths_.size() ) return _FramePtr();
+
+        updateWindow( index, direction );
+
+        _FramePtr frame_ptr = lookup( index );
+
+        if( frame_ptr )
+        {
+            ++stats_.hits_;
+        }
+        else
+        {
+            ++stats_.misses_;
+
+            std::string const path = paths_[index];
+            int const width = width_;
+            int const height = height_;
+
+            // don't hold up the prefetcher while we decode
+            lock.unlock();
+            frame_ptr = decode( path, width, height );
+            lock.lock();
+
+            // the prefetcher may have beaten us to it
+            if( _FramePtr const cached_frame_ptr = lookup( index ) ) frame_ptr = cached_frame_ptr;
+            else if( frame_ptr && index < paths_.size() && paths_[index] == path && width == width_ && height == height_ ) insert( index, frame_ptr );
+        }
+
+        lock.unlock();
+        prefetch_condition_.notify_all();
+
+        return frame_ptr;
+    }
+
+protected:
+    static _FramePtr decode( std::string const & path, int const & width, int const & height )
+    {
+        cv::Mat image = cv::imread( path );
+        if( image.empty() ) return _FramePtr();
+
+        if( width > 0 && height > 0 && ( image.cols != width || image.rows != height ) )
+        {
+            cv::Mat resized_image;
+            cv::resize( image, resized_image, cv::Size( width, height ) );
+            image = resized_image;
+        }
+
+        return boost::make_shared<cv::Mat const>( image );
+    }
+
+    //! Index of the frame offset frames from index, honoring loop_; false if that runs off the end
+    bool step( size_t const & index, long const & offset, size_t & result ) const
+    {
+        long const num_frames = paths_.size();
+        long stepped = long( index ) + offset;
+
+        if( loop_ ) stepped = ( ( stepped % num_frames ) + num_frames ) % num_frames;
+        else if( stepped < 0 || stepped >= num_frames ) return false;
+
+        result = stepped;
+        return true;
+    }
+
+    //! mutex_ must be held
+    void updateWindow( size_t const & index, int const & direction )
+    {
+        long const sign = direction < 0 ? -1 : 1;
+
+        std::vector<size_t> window;
+        window.push_back( index );
+
+        size_t neighbor;
+        for( size_t offset = 1; offset <= read_ahead_; ++offset )
+        {
+            if( step( index, sign * long( offset ), neighbor ) ) window.push_back( neighbor );
+        }
+        for( size_t offset = 1; offset <= read_behind_; ++offset )
+        {
+            if( step( index, -sign * long( offset ), neighbor ) ) window.push_back( neighbor );
+        }
+
+        if( window == window_ ) return;
+
+        window_.swap( window );
+        ++generation_;
+    }
+
+    //! Get a cached frame and mark it most recently used; mutex_ must be held
+    _FramePtr lookup( size_t const & index )
+    {
+        auto const entry_it = cache_.find( index );
+        if( entry_it == cache_.end() ) return _FramePtr();
+
+        lru_.splice( lru_.begin(), lru_, entry_it->second.lru_it_ );
+        return entry_it->second.frame_;
+    }
+
+    //! mutex_ must be held
+    void insert( size_t const & index, _FramePtr const & frame_ptr )
+    {
+        lru_.push_front( index );
+
+        CacheEntry entry;
+        entry.frame_ = frame_ptr;
+        entry.lru_it_ = lru_.begin();
+        cache_[index] = entry;
+
+        evict();
+    }
+
+    //! Drop least recently used frames outside the prefetch window until the cache fits; mutex_ must be held
+    void evict()
+    {
+        auto lru_it = lru_.end();
+        while( cache_.size() > cache_size_ && lru_it != lru_.begin() )
+        {
+            --lru_it;
+            if( std::find( window_.begin(), window_.end(), *lru_it ) != window_.end() ) continue;
+
+            cache_.erase( *lru_it );
+            lru_it = lru_.erase( lru_it );
+        }
+    }
+
+    void prefetchLoop()
+    {
+        size_t last_generation = 0;
+
+        std::unique_lock<std::mutex> lock( mutex_ );
+        while( true )
+        {
+            while( running_ && generation_ == last_generation ) prefetch_condition_.wait( lock );
+            if( !running_ ) return;
+
+            last_generation = generation_;
+            std::vector<size_t> const window( window_ );
+
+            // nearest first; start over as soon as playback moves on
+            for( auto index_it = window.cbegin(); index_it != window.cend() && running_ && generation_ == last_generation; ++index_it )
+            {
+                size_t const index = *index_it;
+                if( cache_.count( index ) ) continue;
+
+                std::string const path = paths_[index];
+                int const width = width_;
+                int const height = height_;
+
+                lock.unlock();
+                _FramePtr const frame_ptr = decode( path, width, height );
+                lock.lock();
+
+                // setFiles() or setSize() may have changed things while we were decoding
+                if( !frame_ptr || index >= paths_.size() || paths_[index] != path || width != width_ || height != height_ || cache_.count( index ) ) continue;
+
+                insert( index, frame_ptr );
+                ++stats_.prefetched_;
+            }
+        }
+    }
+};
+
+#endif // IMAGESERVER_FRAMELOADER_H_
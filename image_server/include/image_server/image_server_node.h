@@ -39,7 +39,8 @@
 #include <quickdev/node.h>
 
 // objects
-#include <quickdev/image_loader.h>
+#include <image_server/frame_loader.h>
+#include <image_server/raw_frame_player.h>
 #include <camera_info_manager/camera_info_manager.h>
 
 // policies
@@ -65,7 +66,8 @@ QUICKDEV_DECLARE_NODE( ImageServer, _ImageProcPolicy, _ImageServerConfigPolicy )
 QUICKDEV_DECLARE_NODE_CLASS( ImageServer )
 {
 private:
-    ImageLoader image_loader_;
+    FrameLoader frame_loader_;
+    RawFramePlayer raw_frame_player_;
     _CameraInfoManager camera_info_manager_;
     ros::MultiPublisher<> multi_pub_;
 
@@ -74,16 +76,17 @@ public:
     bool last_prev_image_state_;
     unsigned int current_frame_;
     unsigned int direction_;
+    bool playing_container_;
 
     _CameraInfoMsg::ConstPtr camera_info_msg_ptr_;
 
     QUICKDEV_DECLARE_NODE_CONSTRUCTOR( ImageServer ),
-        image_loader_( quickdev::getFirstOfType<ros::NodeHandle>( args... ) ),
         camera_info_manager_( quickdev::getFirstOfType<ros::NodeHandle>( args... ) ),
         last_next_image_state_( false ),
         last_prev_image_state_( false ),
         current_frame_( 0 ),
-        direction_( 0 )
+        direction_( 0 ),
+        playing_container_( false )
     {
 
     }
@@ -117,33 +120,88 @@ public:
 
         initPolicies<quickdev::policy::ALL>();
 
-        image_loader_.loadImages();
+        // a pre-decoded container replays on its own thread at its own rate, so spinOnce has nothing to do
+        auto const container = quickdev::ParamReader::readParam<std::string>( nh_rel, "container", "" );
+        if( !container.empty() )
+        {
+            if( !raw_frame_player_.open( container, quickdev::ParamReader::readParam<double>( nh_rel, "sync_tolerance", 0.005 ) ) )
+            {
+                PRINT_ERROR( "%s", raw_frame_player_.getError().c_str() );
+                return;
+            }
+
+            PRINT_INFO( "Playing %zu frames from %zu cameras in %s", raw_frame_player_.getNumFrames(), raw_frame_player_.getNumStreams(), container.c_str() );
+
+            raw_frame_player_.advertise( nh_rel, "output_image", "camera_info", node_name, quickdev::ParamReader::readParam<int>( nh_rel, "queue_size", 1 ) );
+            raw_frame_player_.setLoop( config_.loop );
+            raw_frame_player_.setMode( RawFramePlayer::parseMode( config_.playback_mode ), config_.playback_rate, config_.playback_speed );
+            raw_frame_player_.start();
+
+            playing_container_ = true;
+            return;
+        }
+
+        auto const prefix = quickdev::ParamReader::readParam<std::string>( nh_rel, "prefix", "" );
+        auto const ext = quickdev::ParamReader::readParam<std::string>( nh_rel, "ext", ".jpg" );
+        auto const digits = quickdev::ParamReader::readParam<int>( nh_rel, "digits", 0 );
+        auto const start = quickdev::ParamReader::readParam<int>( nh_rel, "start", 0 );
+        auto const end = quickdev::ParamReader::readParam<int>( nh_rel, "end", 0 );
+
+        frame_loader_.setSize( quickdev::ParamReader::readParam<int>( nh_rel, "width", -1 ), quickdev::ParamReader::readParam<int>( nh_rel, "height", -1 ) );
+        frame_loader_.setCacheSize
+        (
+            quickdev::ParamReader::readParam<int>( nh_rel, "cache_size", 32 ),
+            quickdev::ParamReader::readParam<int>( nh_rel, "read_ahead", 8 ),
+            quickdev::ParamReader::readParam<int>( nh_rel, "read_behind", 2 )
+        );
+        frame_loader_.setLoop( config_.loop );
+
+        // frames are decoded on demand; this only checks which files exist
+        if( !frame_loader_.setFiles( prefix, ext, digits, start, end ) ) PRINT_WARN( "No images found matching %s*%s", prefix.c_str(), ext.c_str() );
+        else PRINT_INFO( "Found %zu images", frame_loader_.size() );
+
+        frame_loader_.start();
     }
 
     void spinOnce()
     {
-        if ( image_loader_.images_loaded_ )
+        if( playing_container_ )
+        {
+            auto const stats = raw_frame_player_.getStats();
+            ROS_INFO_THROTTLE( 5, "Published %zu frames in %zu sets; %zu sets late, at most by %f s", stats.frames_, stats.sets_, stats.late_sets_, stats.max_lateness_ );
+            return;
+        }
+
+        if ( current_frame_ < frame_loader_.size() )
         {
-            if ( current_frame_ < image_loader_.image_cache_.size() )
+            auto const frame_ptr = frame_loader_.get( current_frame_, direction_ == 1 ? -1 : 1 );
+
+            if ( !frame_ptr )
             {
-                ROS_INFO( "Publishing image %d [%dx%d]", current_frame_, image_loader_.image_cache_[current_frame_]->width, image_loader_.image_cache_[current_frame_]->height );
+                PRINT_WARN( "Failed to load image %d", current_frame_ );
+            }
+            else
+            {
+                // shallow copy; the loader's frames are shared and immutable
+                cv::Mat frame = *frame_ptr;
+
+                ROS_INFO( "Publishing image %d [%dx%d]", current_frame_, frame.cols, frame.rows );
 
-                publishImages( "output_image", quickdev::opencv_conversion::fromIplImage( image_loader_.image_cache_[current_frame_], "image_server", "bgr8" ) );
+                publishImages( "output_image", quickdev::opencv_conversion::fromMat( frame, "image_server", "bgr8" ) );
 
                 multi_pub_.publish( "camera_info", camera_info_msg_ptr_ );
+            }
 
-                //publishCvImage( image_loader_.image_cache_[current_frame_] );
-                if ( config_.auto_advance )
+            if ( config_.auto_advance )
+            {
+                switch ( direction_ )
                 {
-                    switch ( direction_ )
-                    {
-                    case 0:
-                        nextFrame();
-                        break;
-                    case 1:
-                        prevFrame();
-                        break;
-                    }
+                case 0:
+                    nextFrame();
+                    break;
+                case 1:
+                    prevFrame();
+                    break;
                 }
             }
         }
@@ -151,7 +209,7 @@ public:
 
     void nextFrame()
     {
-        if ( current_frame_ < image_loader_.image_cache_.size() - 1 )
+        if ( current_frame_ + 1 < frame_loader_.size() )
         {
             ++current_frame_;
         }
@@ -163,18 +221,22 @@ public:
 
     void prevFrame()
     {
-        if ( current_frame_ > 0 && image_loader_.image_cache_.size() > 0 )
+        if ( current_frame_ > 0 && frame_loader_.size() > 0 )
         {
             --current_frame_;
         }
         else if ( config_.loop )
         {
-            current_frame_ = image_loader_.image_cache_.size() - 1;
+            current_frame_ = frame_loader_.size() - 1;
         }
     }
 
     QUICKDEV_DECLARE_RECONFIGURE_CALLBACK( reconfigureCB, _ImageServerConfig )
     {
+        frame_loader_.setLoop( config.loop );
+        raw_frame_player_.setLoop( config.loop );
+        raw_frame_player_.setMode( RawFramePlayer::parseMode( config.playback_mode ), config.playback_rate, config.playback_speed );
+
         if ( config.auto_advance )
         {
             if ( config.next_image && !config.prev_image ) direction_ = 0;
@@ -0,0 +1,543 @@
+/***************************************************************************
+ *  include/image_server/raw_frame_container.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef IMAGESERVER_RAWFRAMECONTAINER_H_
+#define IMAGESERVER_RAWFRAMECONTAINER_H_
+
+// objects
+#include <boost/noncopyable.hpp>
+#include <string>
+#include <vector>
+
+// utils
+#include <ros/serialization.h>
+#include <ros/message_traits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// msgs
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/CameraInfo.h>
+
+// =============================================================================================================================================
+//! A decoded frame inside a RawFrameContainer; publishes as a sensor_msgs/Image without ever building one
+/*! Pixel data is serialized straight out of the container's mapping, so publishing costs one copy into roscpp's outgoing buffer and no
+    conversion. The container must stay open until publish() returns. */
+struct RawFrameView
+{
+    std_msgs::Header header_;
+    uint32_t height_;
+    uint32_t width_;
+    std::string encoding_;
+    uint8_t is_bigendian_;
+    uint32_t step_;
+    uint8_t const * data_;
+    uint32_t size_;
+};
+
+namespace ros
+{
+namespace message_traits
+{
+
+// on the wire, a RawFrameView is a sensor_msgs/Image
+template<>
+struct MD5Sum<RawFrameView>
+{
+    static char const * value() { return MD5Sum<sensor_msgs::Image>::value(); }
+    static char const * value( RawFrameView const & ) { return value(); }
+};
+
+template<>
+struct DataType<RawFrameView>
+{
+    static char const * value() { return DataType<sensor_msgs::Image>::value(); }
+    static char const * value( RawFrameView const & ) { return value(); }
+};
+
+template<>
+struct Definition<RawFrameView>
+{
+    static char const * value() { return Definition<sensor_msgs::Image>::value(); }
+    static char const * value( RawFrameView const & ) { return value(); }
+};
+
+} // message_traits
+
+namespace serialization
+{
+
+template<>
+struct Serializer<RawFrameView>
+{
+    //! Same field order as sensor_msgs/Image
+    template<typename __Stream>
+    inline static void write( __Stream & stream, RawFrameView const & frame )
+    {
+        stream.next( frame.header_ );
+        stream.next( frame.height_ );
+        stream.next( frame.width_ );
+        stream.next( frame.encoding_ );
+        stream.next( frame.is_bigendian_ );
+        stream.next( frame.step_ );
+        stream.next( frame.size_ );
+        memcpy( stream.advance( frame.size_ ), frame.data_, frame.size_ );
+    }
+
+    inline static uint32_t serializedLength( RawFrameView const & frame )
+    {
+        return serializationLength( frame.header_ ) + 4 + 4 + serializationLength( frame.encoding_ ) + 1 + 4 + 4 + frame.size_;
+    }
+};
+
+} // serialization
+} // ros
+
+// =============================================================================================================================================
+//! One camera's frames within a container
+struct RawFrameStream
+{
+    std::string name_;
+    sensor_msgs::CameraInfo camera_info_msg_;
+};
+
+//! Where one frame lives in a container
+struct RawFrameRecord
+{
+    uint32_t stream_idx_;
+    uint32_t height_;
+    uint32_t width_;
+    uint32_t step_;
+    uint8_t is_bigendian_;
+    std::string encoding_;
+    ros::Time stamp_;
+    uint64_t offset_;
+    uint32_t size_;
+};
+
+// =============================================================================================================================================
+//! File layout shared by RawFrameWriter and RawFrameContainer
+/*!
+ * - header: the magic string, then the offset and size of the index (both uint64)
+ * - pixel data for every frame, each aligned to DATA_ALIGNMENT bytes
+ * - index: the streams (name and camera info), then one record per frame, sorted by stamp; serialized with ros::serialization
+ * Everything is little-endian, like ROS's own serialization.
+ */
+namespace raw_frames
+{
+    static char const MAGIC[8] = { 'S', 'B', 'R', 'A', 'W', 'F', 'R', '1' };
+    static size_t const HEADER_SIZE = sizeof( MAGIC ) + 2 * sizeof( uint64_t );
+    static size_t const DATA_ALIGNMENT = 64;
+
+    inline uint32_t serializationLength( RawFrameStream const & stream )
+    {
+        return ros::serialization::serializationLength( stream.name_ ) + ros::serialization::serializationLength( stream.camera_info_msg_ );
+    }
+
+    inline uint32_t serializationLength( RawFrameRecord const & record )
+    {
+        return 4 + 4 + 4 + 4 + 1 + ros::serialization::serializationLength( record.encoding_ ) + 8 + 8 + 4;
+    }
+
+    template<class __Stream>
+    void serialize( __Stream & stream, std::vector<RawFrameStream> const & streams, std::vector<RawFrameRecord> const & records )
+    {
+        stream.next( uint32_t( streams.size() ) );
+        for( auto stream_it = streams.cbegin(); stream_it != streams.cend(); ++stream_it )
+        {
+            stream.next( stream_it->name_ );
+            stream.next( stream_it->camera_info_msg_ );
+        }
+
+        stream.next( uint32_t( records.size() ) );
+        for( auto record_it = records.cbegin(); record_it != records.cend(); ++record_it )
+        {
+            stream.next( record_it->stream_idx_ );
+            stream.next( record_it->height_ );
+            stream.next( record_it->width_ );
+            stream.next( record_it->step_ );
+            stream.next( record_it->is_bigendian_ );
+            stream.next( record_it->encoding_ );
+            stream.next( record_it->stamp_ );
+            stream.next( record_it->offset_ );
+            stream.next( record_it->size_ );
+        }
+    }
+
+    template<class __Stream>
+    void deserialize( __Stream & stream, std::vector<RawFrameStream> & streams, std::vector<RawFrameRecord> & records )
+    {
+        uint32_t num_streams = 0;
+        stream.next( num_streams );
+        streams.resize( num_streams );
+        for( auto stream_it = streams.begin(); stream_it != streams.end(); ++stream_it )
+        {
+            stream.next( stream_it->name_ );
+            stream.next( stream_it->camera_info_msg_ );
+        }
+
+        uint32_t num_records = 0;
+        stream.next( num_records );
+        records.resize( num_records );
+        for( auto record_it = records.begin(); record_it != records.end(); ++record_it )
+        {
+            stream.next( record_it->stream_idx_ );
+            stream.next( record_it->height_ );
+            stream.next( record_it->width_ );
+            stream.next( record_it->step_ );
+            stream.next( record_it->is_bigendian_ );
+            stream.next( record_it->encoding_ );
+            stream.next( record_it->stamp_ );
+            stream.next( record_it->offset_ );
+            stream.next( record_it->size_ );
+        }
+    }
+
+    inline bool compareStamps( RawFrameRecord const & a, RawFrameRecord const & b )
+    {
+        return a.stamp_ < b.stamp_;
+    }
+} // raw_frames
+
+// =============================================================================================================================================
+//! Writes decoded frames from any number of cameras into a container file
+class RawFrameWriter : boost::noncopyable
+{
+protected:
+    FILE * file_;
+    uint64_t offset_;
+    std::vector<RawFrameStream> streams_;
+    std::vector<RawFrameRecord> records_;
+    std::string error_;
+
+public:
+    RawFrameWriter()
+    :
+        file_( NULL ),
+        offset_( 0 )
+    {
+        //
+    }
+
+    ~RawFrameWriter()
+    {
+        close();
+    }
+
+    std::string const & getError() const
+    {
+        return error_;
+    }
+
+    bool open( std::string const & path )
+    {
+        close();
+
+        file_ = fopen( path.c_str(), "wb" );
+        if( !file_ ) return fail( "Failed to open " + path + " for writing" );
+
+        // filled in by close()
+        std::vector<uint8_t> const header( raw_frames::HEADER_SIZE, 0 );
+        if( fwrite( header.data(), 1, header.size(), file_ ) != header.size() ) return fail( "Failed to write header" );
+        offset_ = header.size();
+
+        streams_.clear();
+        records_.clear();
+
+        return true;
+    }
+
+    //! Add a camera; \return its index, for addFrame()
+    size_t addStream( std::string const & name, sensor_msgs::CameraInfo const & camera_info_msg )
+    {
+        RawFrameStream stream;
+        stream.name_ = name;
+        stream.camera_info_msg_ = camera_info_msg;
+        streams_.push_back( stream );
+
+        return streams_.size() - 1;
+    }
+
+    //! Update a camera's calibration, ie if it only became known after its first frame
+    void setCameraInfo( size_t const & stream_idx, sensor_msgs::CameraInfo const & camera_info_msg )
+    {
+        if( stream_idx < streams_.size() ) streams_[stream_idx].camera_info_msg_ = camera_info_msg;
+    }
+
+    bool addFrame( size_t const & stream_idx, sensor_msgs::Image const & image_msg )
+    {
+        if( !file_ ) return fail( "Not open" );
+        if( stream_idx >= streams_.size() ) return fail( "No such stream" );
+        if( image_msg.data.size() != size_t( image_msg.step ) * image_msg.height ) return fail( "Image data doesn't match its step and height" );
+
+        // pad so every frame starts on an aligned boundary
+        size_t const padding = ( raw_frames::DATA_ALIGNMENT - offset_ % raw_frames::DATA_ALIGNMENT ) % raw_frames::DATA_ALIGNMENT;
+        static uint8_t const zeros[raw_frames::DATA_ALIGNMENT] = { 0 };
+        if( padding && fwrite( zeros, 1, padding, file_ ) != padding ) return fail( "Failed to write frame" );
+        offset_ += padding;
+
+        if( !image_msg.data.empty() && fwrite( image_msg.data.data(), 1, image_msg.data.size(), file_ ) != image_msg.data.size() ) return fail( "Failed to write frame" );
+
+        RawFrameRecord record;
+        record.stream_idx_ = stream_idx;
+        record.height_ = image_msg.height;
+        record.width_ = image_msg.width;
+        record.step_ = image_msg.step;
+        record.is_bigendian_ = image_msg.is_bigendian;
+        record.encoding_ = image_msg.encoding;
+        record.stamp_ = image_msg.header.stamp;
+        record.offset_ = offset_;
+        record.size_ = image_msg.data.size();
+        records_.push_back( record );
+
+        offset_ += image_msg.data.size();
+
+        return true;
+    }
+
+    size_t getNumFrames() const
+    {
+        return records_.size();
+    }
+
+    //! Write the index and finish the file
+    bool close()
+    {
+        if( !file_ ) return true;
+
+        std::stable_sort( records_.begin(), records_.end(), raw_frames::compareStamps );
+
+        uint64_t const index_offset = offset_;
+
+        uint64_t index_size = 4 + 4;
+        for( auto stream_it = streams_.cbegin(); stream_it != streams_.cend(); ++stream_it ) index_size += raw_frames::serializationLength( *stream_it );
+        for( auto record_it = records_.cbegin(); record_it != records_.cend(); ++record_it ) index_size += raw_frames::serializationLength( *record_it );
+
+        std::vector<uint8_t> index( index_size );
+        ros::serialization::OStream index_stream( index.data(), index.size() );
+        raw_frames::serialize( index_stream, streams_, records_ );
+
+        std::vector<uint8_t> header( raw_frames::HEADER_SIZE );
+        ros::serialization::OStream header_stream( header.data(), header.size() );
+        memcpy( header_stream.advance( sizeof( raw_frames::MAGIC ) ), raw_frames::MAGIC, sizeof( raw_frames::MAGIC ) );
+        header_stream.next( index_offset );
+        header_stream.next( index_size );
+
+        bool const success =
+            fwrite( index.data(), 1, index.size(), file_ ) == index.size() &&
+            fseek( file_, 0, SEEK_SET ) == 0 &&
+            fwrite( header.data(), 1, header.size(), file_ ) == header.size();
+
+        bool const closed = fclose( file_ ) == 0;
+        file_ = NULL;
+
+        if( !success || !closed ) return fail( "Failed to write index" );
+
+        return true;
+    }
+
+protected:
+    bool fail( std::string const & error )
+    {
+        error_ = error;
+        return false;
+    }
+};
+
+// =============================================================================================================================================
+//! Read-only, memory-mapped view of a container file
+/*!
+ * - open() maps the file and reads the index; pixel data is paged in by the OS as frames are touched, so opening is fast regardless of size
+ * - getFrame() is cheap and allocation-free apart from the encoding string; frames point into the mapping
+ * - Not copyable; frames are only valid while the container is open
+ */
+class RawFrameContainer : boost::noncopyable
+{
+protected:
+    int fd_;
+    uint8_t const * data_;
+    size_t size_;
+
+    std::vector<RawFrameStream> streams_;
+    std::vector<RawFrameRecord> records_;
+    std::string error_;
+
+public:
+    RawFrameContainer()
+    :
+        fd_( -1 ),
+        data_( NULL ),
+        size_( 0 )
+    {
+        //
+    }
+
+    ~RawFrameContainer()
+    {
+        close();
+    }
+
+    std::string const & getError() const
+    {
+        return error_;
+    }
+
+    bool open( std::string const & path )
+    {
+        close();
+
+        fd_ = ::open( path.c_str(), O_RDONLY );
+        if( fd_ < 0 ) return fail( "Failed to open " + path );
+
+        struct stat file_stat;
+        if( fstat( fd_, &file_stat ) != 0 ) return fail( "Failed to stat " + path );
+        size_ = file_stat.st_size;
+
+        if( size_ < raw_frames::HEADER_SIZE ) return fail( path + " is too small to be a frame container" );
+
+        void * const data = mmap( NULL, size_, PROT_READ, MAP_SHARED, fd_, 0 );
+        if( data == MAP_FAILED ) return fail( "Failed to map " + path );
+        data_ = static_cast<uint8_t const *>( data );
+
+        // we mostly read front to back
+        madvise( const_cast<uint8_t *>( data_ ), size_, MADV_SEQUENTIAL );
+
+        if( memcmp( data_, raw_frames::MAGIC, sizeof( raw_frames::MAGIC ) ) != 0 ) return fail( path + " is not a frame container" );
+
+        uint64_t index_offset = 0;
+        uint64_t index_size = 0;
+        ros::serialization::IStream header_stream( const_cast<uint8_t *>( data_ ) + sizeof( raw_frames::MAGIC ), 2 * sizeof( uint64_t ) );
+        header_stream.next( index_offset );
+        header_stream.next( index_size );
+
+        if( index_offset < raw_frames::HEADER_SIZE || index_offset > size_ || index_size > size_ - index_offset ) return fail( path + " has a bad index; was it closed properly?" );
+
+        try
+        {
+            ros::serialization::IStream index_stream( const_cast<uint8_t *>( data_ ) + index_offset, index_size );
+            raw_frames::deserialize( index_stream, streams_, records_ );
+        }
+        catch( ros::serialization::StreamOverrunException const & )
+        {
+            return fail( path + " has a truncated index" );
+        }
+
+        for( auto record_it = records_.cbegin(); record_it != records_.cend(); ++record_it )
+        {
+            if( record_it->stream_idx_ >= streams_.size() || record_it->offset_ > index_offset || record_it->size_ > index_offset - record_it->offset_ )
+            {
+                return fail( path + " has a frame outside its data" );
+            }
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        if( data_ ) munmap( const_cast<uint8_t *>( data_ ), size_ );
+        if( fd_ >= 0 ) ::close( fd_ );
+
+        fd_ = -1;
+        data_ = NULL;
+        size_ = 0;
+        streams_.clear();
+        records_.clear();
+    }
+
+    bool isOpen() const
+    {
+        return data_ != NULL;
+    }
+
+    std::vector<RawFrameStream> const & getStreams() const
+    {
+        return streams_;
+    }
+
+    size_t getNumFrames() const
+    {
+        return records_.size();
+    }
+
+    //! Frames are sorted by stamp across all streams
+    RawFrameRecord const & getRecord( size_t const & frame_idx ) const
+    {
+        return records_[frame_idx];
+    }
+
+    //! Fill frame with frame_idx's metadata and a pointer to its pixels; its header is left for the caller
+    void getFrame( size_t const & frame_idx, RawFrameView & frame ) const
+    {
+        auto const & record = records_[frame_idx];
+
+        frame.height_ = record.height_;
+        frame.width_ = record.width_;
+        frame.encoding_ = record.encoding_;
+        frame.is_bigendian_ = record.is_bigendian_;
+        frame.step_ = record.step_;
+        frame.data_ = data_ + record.offset_;
+        frame.size_ = record.size_;
+    }
+
+    //! Ask the OS to start paging in frames [begin, end); useful just ahead of playback
+    void prefetch( size_t const & begin, size_t const & end ) const
+    {
+        if( begin >= end || end > records_.size() ) return;
+
+        long const page_size = sysconf( _SC_PAGESIZE );
+        for( size_t frame_idx = begin; frame_idx < end; ++frame_idx )
+        {
+            auto const & record = records_[frame_idx];
+            size_t const page_begin = record.offset_ / page_size * page_size;
+            madvise( const_cast<uint8_t *>( data_ ) + page_begin, record.offset_ + record.size_ - page_begin, MADV_WILLNEED );
+        }
+    }
+
+protected:
+    bool fail( std::string const & error )
+    {
+        error_ = error;
+        close();
+        return false;
+    }
+};
+
+#endif // IMAGESERVER_RAWFRAMECONTAINER_H_
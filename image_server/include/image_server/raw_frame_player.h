@@ -0,0 +1,417 @@
+/***************************************************************************
+ *  include/image_server/raw_frame_player.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef IMAGESERVER_RAWFRAMEPLAYER_H_
+#define IMAGESERVER_RAWFRAMEPLAYER_H_
+
+// objects
+#include <image_server/raw_frame_container.h>
+#include <boost/thread.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// utils
+#include <ros/ros.h>
+#include <chrono>
+#include <cmath>
+
+// msgs
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/CameraInfo.h>
+
+// =============================================================================================================================================
+//! Replays a RawFrameContainer on its own thread, one image and camera_info topic per camera
+/*!
+ * - Frames from different cameras whose stamps lie within sync_tolerance of each other form a set; every frame in a set is published
+ *   back-to-back with the same stamp, so downstream exact-time synchronizers see them together in every mode
+ * - ORIGINAL reproduces the recorded spacing between sets, scaled by speed; stamps are the playback start plus the scaled recorded offset
+ * - FIXED publishes one set every 1 / rate seconds, stamped with the current time
+ * - FAST publishes sets back-to-back, stamped with the current time, with no throttling at all: ros::Publisher::publish() never blocks, so
+ *   this keeps a core busy, and a subscriber that falls more than queue_size messages behind silently loses frames (roscpp drops the
+ *   oldest). Measure throughput at the subscriber, with a queue_size deep enough for the burst, rather than from getStats(). While no
+ *   camera's image topic has subscribers, FAST waits instead of publishing into the void
+ * - Pacing is against an absolute schedule, so a slow publish doesn't push every later frame back; getStats() reports how often we fell behind
+ */
+class RawFramePlayer : boost::noncopyable
+{
+public:
+    enum Mode
+    {
+        ORIGINAL,
+        FIXED,
+        FAST
+    };
+
+    struct Stats
+    {
+        size_t frames_;
+        size_t sets_;
+        //! Sets published more than one set period after they were due
+        size_t late_sets_;
+        double max_lateness_;
+    };
+
+protected:
+    //! How many frames to ask the OS to page in ahead of playback
+    static size_t const PREFETCH_FRAMES = 32;
+
+    RawFrameContainer container_;
+    //! Index of the first frame of each set, plus one past the last frame
+    std::vector<size_t> set_begins_;
+
+    std::vector<ros::Publisher> image_pubs_;
+    std::vector<ros::Publisher> camera_info_pubs_;
+    std::vector<sensor_msgs::CameraInfo> camera_info_msgs_;
+
+    Mode mode_;
+    double rate_;
+    double speed_;
+    bool loop_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_condition_;
+    bool running_;
+
+    Stats stats_;
+
+    boost::shared_ptr<boost::thread> playback_thread_;
+
+public:
+    RawFramePlayer()
+    :
+        mode_( ORIGINAL ),
+        rate_( 15 ),
+        speed_( 1 ),
+        loop_( false ),
+        running_( false )
+    {
+        stats_.frames_ = stats_.sets_ = stats_.late_sets_ = 0;
+        stats_.max_lateness_ = 0;
+    }
+
+    ~RawFramePlayer()
+    {
+        stop();
+    }
+
+    //! \return "original", "fixed" or "fast" as a Mode; anything else is ORIGINAL
+    static Mode parseMode( std::string const & mode )
+    {
+        if( mode == "fixed" ) return FIXED;
+        if( mode == "fast" ) return FAST;
+        return ORIGINAL;
+    }
+
+    std::string const & getError() const
+    {
+        return container_.getError();
+    }
+
+    //! Map the container at path and group its frames into sets
+    bool open( std::string const & path, double const & sync_tolerance )
+    {
+        stop();
+
+        if( !container_.open( path ) ) return false;
+
+        set_begins_.clear();
+
+        std::vector<bool> stream_in_set( container_.getStreams().size(), false );
+        ros::Time set_stamp;
+
+        for( size_t frame_idx = 0; frame_idx < container_.getNumFrames(); ++frame_idx )
+        {
+            auto const & record = container_.getRecord( frame_idx );
+
+            // a new set starts when this camera already has a frame in the current one, or when we're too far from the set's first frame
+            if( set_begins_.empty() || stream_in_set[record.stream_idx_] || ( record.stamp_ - set_stamp ).toSec() > sync_tolerance )
+            {
+                set_begins_.push_back( frame_idx );
+                std::fill( stream_in_set.begin(), stream_in_set.end(), false );
+                set_stamp = record.stamp_;
+            }
+
+            stream_in_set[record.stream_idx_] = true;
+        }
+
+        set_begins_.push_back( container_.getNumFrames() );
+
+        return true;
+    }
+
+    size_t getNumStreams() const
+    {
+        return container_.getStreams().size();
+    }
+
+    size_t getNumFrames() const
+    {
+        return container_.getNumFrames();
+    }
+
+    size_t getNumSets() const
+    {
+        return set_begins_.empty() ? 0 : set_begins_.size() - 1;
+    }
+
+    //! Advertise each camera's topics on nh
+    /*! A container with a single camera publishes on image_topic and camera_info_topic directly, so it's a drop-in replacement for a live
+        camera; with several, each camera's topics are put in a namespace named after it. queue_size is each publisher's outgoing queue;
+        1 behaves like a live camera, where only the latest frame matters. */
+    void advertise( ros::NodeHandle & nh, std::string const & image_topic, std::string const & camera_info_topic, std::string const & frame_id = "", int const & queue_size = 1 )
+    {
+        auto const & streams = container_.getStreams();
+
+        image_pubs_.clear();
+        camera_info_pubs_.clear();
+        camera_info_msgs_.clear();
+
+        for( auto stream_it = streams.cbegin(); stream_it != streams.cend(); ++stream_it )
+        {
+            std::string const prefix = streams.size() > 1 ? stream_it->name_ + "/" : "";
+
+            image_pubs_.push_back( nh.advertise<sensor_msgs::Image>( prefix + image_topic, queue_size ) );
+            camera_info_pubs_.push_back( nh.advertise<sensor_msgs::CameraInfo>( prefix + camera_info_topic, queue_size ) );
+
+            camera_info_msgs_.push_back( stream_it->camera_info_msg_ );
+            if( !frame_id.empty() ) camera_info_msgs_.back().header.frame_id = streams.size() > 1 ? frame_id + "/" + stream_it->name_ : frame_id;
+            else if( camera_info_msgs_.back().header.frame_id.empty() ) camera_info_msgs_.back().header.frame_id = stream_it->name_;
+        }
+    }
+
+    //! Takes effect from the next set
+    void setMode( Mode const & mode, double const & rate, double const & speed )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        mode_ = mode;
+        rate_ = rate > 0 ? rate : 1;
+        speed_ = speed > 0 ? speed : 1;
+
+        // re-anchor the schedule to the new timing
+        wake_condition_.notify_all();
+    }
+
+    void setLoop( bool const & loop )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        loop_ = loop;
+    }
+
+    void start()
+    {
+        if( playback_thread_ || set_begins_.size() < 2 ) return;
+
+        running_ = true;
+        playback_thread_ = boost::make_shared<boost::thread>( &RawFramePlayer::playbackLoop, this );
+    }
+
+    void stop()
+    {
+        if( !playback_thread_ ) return;
+
+        {
+            std::lock_guard<std::mutex> lock( mutex_ );
+            running_ = false;
+        }
+        wake_condition_.notify_all();
+
+        playback_thread_->join();
+        playback_thread_.reset();
+    }
+
+    bool isPlaying()
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        return running_;
+    }
+
+    Stats getStats()
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        return stats_;
+    }
+
+protected:
+    bool hasImageSubscribers() const
+    {
+        for( auto image_pub_it = image_pubs_.cbegin(); image_pub_it != image_pubs_.cend(); ++image_pub_it )
+        {
+            if( image_pub_it->getNumSubscribers() ) return true;
+        }
+
+        return false;
+    }
+
+    void playbackLoop()
+    {
+        size_t set_idx = 0;
+        size_t prefetched_until = 0;
+
+        std::unique_lock<std::mutex> lock( mutex_ );
+
+        Mode mode = mode_;
+        double rate = rate_;
+        double speed = speed_;
+
+        // the schedule is anchored at set anchor_set_idx, due at anchor_wall_time and stamped anchor_stamp
+        size_t anchor_set_idx = 0;
+        ros::WallTime anchor_wall_time = ros::WallTime::now();
+        ros::Time anchor_stamp = ros::Time::now();
+
+        RawFrameView frame;
+
+        while( running_ )
+        {
+            if( set_idx + 1 >= set_begins_.size() )
+            {
+                if( !loop_ ) break;
+
+                set_idx = 0;
+                prefetched_until = 0;
+                anchor_set_idx = 0;
+                anchor_wall_time = ros::WallTime::now();
+                anchor_stamp = ros::Time::now();
+            }
+
+            // settings changed; start a new schedule from here
+            if( mode != mode_ || rate != rate_ || speed != speed_ )
+            {
+                mode = mode_;
+                rate = rate_;
+                speed = speed_;
+                anchor_set_idx = set_idx;
+                anchor_wall_time = ros::WallTime::now();
+                anchor_stamp = ros::Time::now();
+            }
+
+            size_t const set_begin = set_begins_[set_idx];
+            size_t const set_end = set_begins_[set_idx + 1];
+
+            double offset = 0;
+            double period = 0;
+            switch( mode )
+            {
+            case ORIGINAL:
+                offset = ( container_.getRecord( set_begin ).stamp_ - container_.getRecord( set_begins_[anchor_set_idx] ).stamp_ ).toSec() / speed;
+                if( set_idx + 2 < set_begins_.size() ) period = ( container_.getRecord( set_end ).stamp_ - container_.getRecord( set_begin ).stamp_ ).toSec() / speed;
+                break;
+            case FIXED:
+                offset = ( set_idx - anchor_set_idx ) / rate;
+                period = 1.0 / rate;
+                break;
+            case FAST:
+                break;
+            }
+
+            // nobody to publish to, and nothing to pace us; don't spin
+            if( mode == FAST && !hasImageSubscribers() )
+            {
+                wake_condition_.wait_for( lock, std::chrono::milliseconds( 100 ) );
+                continue;
+            }
+
+            ros::Time stamp = ros::Time::now();
+
+            if( mode != FAST )
+            {
+                ros::WallTime const due = anchor_wall_time + ros::WallDuration( offset );
+
+                // sleep until the set is due, waking early if we're stopped or reconfigured
+                bool interrupted = false;
+                for( ros::WallTime now = ros::WallTime::now(); running_ && now < due; now = ros::WallTime::now() )
+                {
+                    if( mode != mode_ || rate != rate_ || speed != speed_ )
+                    {
+                        interrupted = true;
+                        break;
+                    }
+
+                    wake_condition_.wait_for( lock, std::chrono::microseconds( ( due - now ).toNSec() / 1000 + 1 ) );
+                }
+
+                if( !running_ ) break;
+                if( interrupted ) continue;
+
+                double const lateness = ( ros::WallTime::now() - due ).toSec();
+                if( lateness > period && period > 0 ) ++stats_.late_sets_;
+                if( lateness > stats_.max_lateness_ ) stats_.max_lateness_ = lateness;
+
+                if( mode == ORIGINAL ) stamp = anchor_stamp + ros::Duration( offset );
+            }
+
+            lock.unlock();
+
+            // have the OS page in upcoming frames while we publish these ones
+            if( set_end + PREFETCH_FRAMES / 2 > prefetched_until )
+            {
+                prefetched_until = std::min( set_end + PREFETCH_FRAMES, container_.getNumFrames() );
+                container_.prefetch( set_end, prefetched_until );
+            }
+
+            for( size_t frame_idx = set_begin; frame_idx < set_end; ++frame_idx )
+            {
+                auto const stream_idx = container_.getRecord( frame_idx ).stream_idx_;
+                auto & camera_info_msg = camera_info_msgs_[stream_idx];
+
+                container_.getFrame( frame_idx, frame );
+                frame.header_.stamp = stamp;
+                frame.header_.frame_id = camera_info_msg.header.frame_id;
+                frame.header_.seq = frame_idx;
+
+                camera_info_msg.header.stamp = stamp;
+
+                // serialized straight out of the mapped container
+                image_pubs_[stream_idx].publish( frame );
+                camera_info_pubs_[stream_idx].publish( camera_info_msg );
+            }
+
+            lock.lock();
+
+            stats_.frames_ += set_end - set_begin;
+            ++stats_.sets_;
+            ++set_idx;
+        }
+
+        running_ = false;
+    }
+};
+
+#endif // IMAGESERVER_RAWFRAMEPLAYER_H_
@@ -0,0 +1,185 @@
+/***************************************************************************
+ *  tools/raw_frame_converter.cpp
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+// Converts camera streams recorded in a bag into a RawFrameContainer that image_server can replay without decoding anything.
+//
+// Each image topic becomes one stream, named after the topic's namespace (/seabee3/camera1/image_raw -> camera1); its calibration is taken
+// from the camera_info topic in the same namespace. With no topics given, every sensor_msgs/Image topic in the bag is converted.
+//
+// usage: raw_frame_converter <output> <bag> [image_topic ...]
+
+#include <image_server/raw_frame_container.h>
+
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+
+#include <boost/foreach.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+//! /seabee3/camera1/image_raw -> /seabee3/camera1
+static std::string getNamespace( std::string const & topic )
+{
+    size_t const slash = topic.find_last_of( '/' );
+    return slash == std::string::npos ? "" : topic.substr( 0, slash );
+}
+
+//! /seabee3/camera1/image_raw -> camera1
+static std::string getStreamName( std::string const & topic )
+{
+    std::string const ns = getNamespace( topic );
+    std::string const name = ns.substr( ns.find_last_of( '/' ) + 1 );
+    return name.empty() ? "camera" : name;
+}
+
+int main( int argc, char ** argv )
+{
+    if( argc < 3 )
+    {
+        printf( "usage: %s <output> <bag> [image_topic ...]\n", argv[0] );
+        return 1;
+    }
+
+    std::string const output_path = argv[1];
+
+    rosbag::Bag bag;
+    try
+    {
+        bag.open( argv[2], rosbag::bagmode::Read );
+    }
+    catch( rosbag::BagException const & exception )
+    {
+        printf( "Failed to open %s: %s\n", argv[2], exception.what() );
+        return 1;
+    }
+
+    std::vector<std::string> image_topics( argv + 3, argv + argc );
+
+    if( image_topics.empty() )
+    {
+        rosbag::View const all_view( bag );
+        BOOST_FOREACH( rosbag::ConnectionInfo const * connection, all_view.getConnections() )
+        {
+            if( connection->datatype == "sensor_msgs/Image" && std::find( image_topics.begin(), image_topics.end(), connection->topic ) == image_topics.end() )
+            {
+                image_topics.push_back( connection->topic );
+            }
+        }
+    }
+
+    if( image_topics.empty() )
+    {
+        printf( "No image topics found in %s\n", argv[2] );
+        return 1;
+    }
+
+    RawFrameWriter writer;
+    if( !writer.open( output_path ) )
+    {
+        printf( "%s\n", writer.getError().c_str() );
+        return 1;
+    }
+
+    std::map<std::string, size_t> image_streams;
+    std::map<std::string, size_t> camera_info_streams;
+    std::vector<bool> has_camera_info;
+    std::vector<std::string> topics;
+
+    for( auto topic_it = image_topics.cbegin(); topic_it != image_topics.cend(); ++topic_it )
+    {
+        std::string const camera_info_topic = getNamespace( *topic_it ) + "/camera_info";
+        size_t const stream_idx = writer.addStream( getStreamName( *topic_it ), sensor_msgs::CameraInfo() );
+
+        image_streams[*topic_it] = stream_idx;
+        camera_info_streams[camera_info_topic] = stream_idx;
+        has_camera_info.push_back( false );
+
+        topics.push_back( *topic_it );
+        topics.push_back( camera_info_topic );
+
+        printf( "%s -> stream %zu (%s)\n", topic_it->c_str(), stream_idx, getStreamName( *topic_it ).c_str() );
+    }
+
+    std::vector<size_t> num_frames( image_topics.size(), 0 );
+
+    rosbag::View const view( bag, rosbag::TopicQuery( topics ) );
+    BOOST_FOREACH( rosbag::MessageInstance const & message, view )
+    {
+        auto const image_stream_it = image_streams.find( message.getTopic() );
+        if( image_stream_it != image_streams.end() )
+        {
+            auto const image_msg = message.instantiate<sensor_msgs::Image>();
+            if( !image_msg ) continue;
+
+            if( !writer.addFrame( image_stream_it->second, *image_msg ) )
+            {
+                printf( "%s\n", writer.getError().c_str() );
+                return 1;
+            }
+
+            ++num_frames[image_stream_it->second];
+            continue;
+        }
+
+        // the first camera_info for each camera is all we need
+        auto const camera_info_stream_it = camera_info_streams.find( message.getTopic() );
+        if( camera_info_stream_it != camera_info_streams.end() && !has_camera_info[camera_info_stream_it->second] )
+        {
+            auto const camera_info_msg = message.instantiate<sensor_msgs::CameraInfo>();
+            if( !camera_info_msg ) continue;
+
+            writer.setCameraInfo( camera_info_stream_it->second, *camera_info_msg );
+            has_camera_info[camera_info_stream_it->second] = true;
+        }
+    }
+
+    if( !writer.close() )
+    {
+        printf( "%s\n", writer.getError().c_str() );
+        return 1;
+    }
+
+    for( size_t stream_idx = 0; stream_idx < image_topics.size(); ++stream_idx )
+    {
+        printf( "stream %zu: %zu frames%s\n", stream_idx, num_frames[stream_idx], has_camera_info[stream_idx] ? "" : ", no camera_info" );
+    }
+
+    printf( "Wrote %zu frames to %s\n", writer.getNumFrames(), output_path.c_str() );
+
+    return 0;
+}
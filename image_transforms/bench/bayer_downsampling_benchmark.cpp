@@ -0,0 +1,131 @@
+/***************************************************************************
+ *  bench/bayer_downsampling_benchmark.cpp
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+// Compares ImageScalerNode's two ways of turning a full-resolution Bayer mosaic into a smaller BGR image: cv::cvtColor followed by
+// cv::resize (two full-resolution passes, one of them writing a full-resolution color image) against downsampleBayer() (one pass over the
+// mosaic, writing only the output). Also reports how far the fused output is from the two-step one, per channel.
+//
+// usage: bayer_downsampling_benchmark [width] [height] [iterations]
+
+#include <image_transforms/bayer_downsampling.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+typedef std::chrono::high_resolution_clock _Clock;
+
+static double elapsedUs( _Clock::time_point const & start )
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( _Clock::now() - start ).count() / 1000.0;
+}
+
+//! Mosaic a smooth color scene with a little noise, so both paths have realistic data to chew on
+static cv::Mat makeMosaic( int const & width, int const & height )
+{
+    cv::Mat mosaic( height, width, CV_8UC1 );
+
+    srand( 0 );
+    for( int row = 0; row < height; ++row )
+    {
+        uchar * mosaic_ptr = mosaic.ptr<uchar>( row );
+        for( int col = 0; col < width; ++col )
+        {
+            int const red = 255 * col / width;
+            int const green = 255 * row / height;
+            int const blue = 255 - ( red + green ) / 2;
+
+            // BG layout: red on even rows and columns, blue on odd rows and columns
+            int const value = ( row & 1 ) == ( col & 1 ) ? ( row & 1 ? blue : red ) : green;
+            mosaic_ptr[col] = cv::saturate_cast<uchar>( value + rand() % 9 - 4 );
+        }
+    }
+
+    return mosaic;
+}
+
+int main( int argc, char ** argv )
+{
+    int const width = argc > 1 ? atoi( argv[1] ) : 1280;
+    int const height = argc > 2 ? atoi( argv[2] ) : 960;
+    int const iterations = argc > 3 ? atoi( argv[3] ) : 200;
+
+    cv::Mat const mosaic = makeMosaic( width, height );
+
+    printf( "%dx%d mosaic, %d iterations\n", width, height, iterations );
+    printf( "%8s %18s %18s %10s %24s\n", "factor", "two-step us / fr", "fused us / fr", "speedup", "mean |diff| (b, g, r)" );
+
+    int const factors[] = { 2, 4 };
+    for( size_t factor_idx = 0; factor_idx < sizeof( factors ) / sizeof( factors[0] ); ++factor_idx )
+    {
+        int const factor = factors[factor_idx];
+        double const scale = 1.0 / factor;
+
+        cv::Mat color;
+        cv::Mat two_step;
+        cv::Mat fused;
+
+        // warm up allocations so both paths are timed in their steady state
+        cv::cvtColor( mosaic, color, CV_BayerBG2BGR );
+        cv::resize( color, two_step, cv::Size(), scale, scale );
+        downsampleBayer( mosaic, fused, factor, CV_BayerBG2BGR );
+
+        auto const two_step_start = _Clock::now();
+        for( int iteration = 0; iteration < iterations; ++iteration )
+        {
+            cv::cvtColor( mosaic, color, CV_BayerBG2BGR );
+            cv::resize( color, two_step, cv::Size(), scale, scale );
+        }
+        double const two_step_us = elapsedUs( two_step_start ) / iterations;
+
+        auto const fused_start = _Clock::now();
+        for( int iteration = 0; iteration < iterations; ++iteration )
+        {
+            downsampleBayer( mosaic, fused, factor, CV_BayerBG2BGR );
+        }
+        double const fused_us = elapsedUs( fused_start ) / iterations;
+
+        // the two-step path rounds odd sizes where the fused one crops; compare the common area
+        cv::Rect const common( 0, 0, std::min( fused.cols, two_step.cols ), std::min( fused.rows, two_step.rows ) );
+        cv::Mat difference;
+        cv::absdiff( fused( common ), two_step( common ), difference );
+        cv::Scalar const mean_difference = cv::mean( difference );
+
+        printf( "%8d %18.1f %18.1f %9.2fx %8.2f %6.2f %6.2f\n", factor, two_step_us, fused_us, two_step_us / fused_us, mean_difference[0], mean_difference[1], mean_difference[2] );
+    }
+
+    return 0;
+}
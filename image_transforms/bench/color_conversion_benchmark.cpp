@@ -0,0 +1,113 @@
+/***************************************************************************
+ *  bench/color_conversion_benchmark.cpp
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+// Compares ColorTransformNode's table-driven HLS and HSV conversion against cv::cvtColor, both one space at a time and with both spaces
+// requested (where convertBgrToHueSpaces() shares a single pass), and reports the largest per-channel difference from cv::cvtColor.
+//
+// usage: color_conversion_benchmark [width] [height] [iterations]
+
+#include <image_transforms/color_conversions.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+typedef std::chrono::high_resolution_clock _Clock;
+
+static double elapsedUs( _Clock::time_point const & start )
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( _Clock::now() - start ).count() / 1000.0;
+}
+
+static double maxDifference( cv::Mat const & a, cv::Mat const & b )
+{
+    cv::Mat difference;
+    cv::absdiff( a, b, difference );
+
+    double max_difference = 0;
+    cv::minMaxLoc( difference.reshape( 1 ), NULL, &max_difference );
+    return max_difference;
+}
+
+int main( int argc, char ** argv )
+{
+    int const width = argc > 1 ? atoi( argv[1] ) : 640;
+    int const height = argc > 2 ? atoi( argv[2] ) : 480;
+    int const iterations = argc > 3 ? atoi( argv[3] ) : 200;
+
+    cv::Mat image( height, width, CV_8UC3 );
+    cv::randu( image, cv::Scalar::all( 0 ), cv::Scalar::all( 256 ) );
+
+    cv::Mat opencv_hls;
+    cv::Mat opencv_hsv;
+    cv::Mat hls;
+    cv::Mat hsv;
+
+    // warm up allocations and the tables
+    cv::cvtColor( image, opencv_hls, CV_BGR2HLS );
+    cv::cvtColor( image, opencv_hsv, CV_BGR2HSV );
+    convertBgrToHueSpaces( image, &hls, &hsv );
+
+    printf( "%dx%d bgr8, %d iterations\n", width, height, iterations );
+    printf( "%12s %16s %16s %10s %10s\n", "spaces", "cvtColor us", "tables us", "speedup", "max diff" );
+
+    auto start = _Clock::now();
+    for( int iteration = 0; iteration < iterations; ++iteration ) cv::cvtColor( image, opencv_hls, CV_BGR2HLS );
+    double const opencv_hls_us = elapsedUs( start ) / iterations;
+
+    start = _Clock::now();
+    for( int iteration = 0; iteration < iterations; ++iteration ) convertBgrToHueSpaces( image, &hls, NULL );
+    double const hls_us = elapsedUs( start ) / iterations;
+
+    printf( "%12s %16.1f %16.1f %9.2fx %10.0f\n", "hls", opencv_hls_us, hls_us, opencv_hls_us / hls_us, maxDifference( hls, opencv_hls ) );
+
+    start = _Clock::now();
+    for( int iteration = 0; iteration < iterations; ++iteration ) cv::cvtColor( image, opencv_hsv, CV_BGR2HSV );
+    double const opencv_hsv_us = elapsedUs( start ) / iterations;
+
+    start = _Clock::now();
+    for( int iteration = 0; iteration < iterations; ++iteration ) convertBgrToHueSpaces( image, NULL, &hsv );
+    double const hsv_us = elapsedUs( start ) / iterations;
+
+    printf( "%12s %16.1f %16.1f %9.2fx %10.0f\n", "hsv", opencv_hsv_us, hsv_us, opencv_hsv_us / hsv_us, maxDifference( hsv, opencv_hsv ) );
+
+    start = _Clock::now();
+    for( int iteration = 0; iteration < iterations; ++iteration ) convertBgrToHueSpaces( image, &hls, &hsv );
+    double const both_us = elapsedUs( start ) / iterations;
+
+    printf( "%12s %16.1f %16.1f %9.2fx\n", "hls + hsv", opencv_hls_us + opencv_hsv_us, both_us, ( opencv_hls_us + opencv_hsv_us ) / both_us );
+
+    return 0;
+}
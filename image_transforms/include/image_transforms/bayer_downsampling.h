@@ -0,0 +1,191 @@
+/***************************************************************************
+ *  include/image_transforms/bayer_downsampling.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef IMAGETRANSFORMS_BAYERDOWNSAMPLING_H_
+#define IMAGETRANSFORMS_BAYERDOWNSAMPLING_H_
+
+// objects
+#include <opencv2/core/core.hpp>
+#include <vector>
+
+// utils
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+
+// =============================================================================================================================================
+//! Demosaic and downscale a Bayer image by an integer factor in one pass
+/*!
+ * - Each factor x factor block of the mosaic becomes one BGR pixel holding the mean of the block's red, green and blue samples; at factor 2
+ *   that's one 2x2 Bayer cell per pixel, so no color is interpolated at all
+ * - Output is bayer.cols / factor x bayer.rows / factor; leftover columns and rows at the right and bottom are dropped
+ * - Each output pixel is centered on its block, as with cv::resize, so intrinsics scale the same way; see scaleCameraInfo()
+ * - code is the cv::cvtColor conversion the mosaic would otherwise go through (CV_BayerBG2BGR, ...), which names its layout
+ * \return false, leaving bgr untouched, if the input isn't 8-bit single-channel, the code isn't a Bayer-to-BGR conversion, or factor < 2
+ */
+inline bool downsampleBayer( cv::Mat const & bayer, cv::Mat & bgr, int const & factor, int const & code = CV_BayerBG2BGR )
+{
+    if( bayer.type() != CV_8UC1 || factor < 2 ) return false;
+
+    // position of the red sample within each 2x2 cell; blue is always diagonally opposite and green fills the other two
+    int red_row;
+    int red_col;
+    switch( code )
+    {
+    case CV_BayerBG2BGR: red_row = 0; red_col = 0; break;
+    case CV_BayerGB2BGR: red_row = 0; red_col = 1; break;
+    case CV_BayerRG2BGR: red_row = 1; red_col = 1; break;
+    case CV_BayerGR2BGR: red_row = 1; red_col = 0; break;
+    default: return false;
+    }
+
+    int const output_rows = bayer.rows / factor;
+    int const output_cols = bayer.cols / factor;
+
+    bgr.create( output_rows, output_cols, CV_8UC3 );
+
+    if( factor == 2 )
+    {
+        // one cell per pixel: copy red and blue, average the two greens
+        for( int output_row = 0; output_row < output_rows; ++output_row )
+        {
+            uchar const * const red_row_ptr = bayer.ptr<uchar>( 2 * output_row + red_row );
+            uchar const * const blue_row_ptr = bayer.ptr<uchar>( 2 * output_row + 1 - red_row );
+            uchar * output_ptr = bgr.ptr<uchar>( output_row );
+
+            uchar const * red_ptr = red_row_ptr + red_col;
+            uchar const * green_ptr1 = red_row_ptr + 1 - red_col;
+            uchar const * green_ptr2 = blue_row_ptr + red_col;
+            uchar const * blue_ptr = blue_row_ptr + 1 - red_col;
+
+            for( int output_col = 0; output_col < output_cols; ++output_col )
+            {
+                output_ptr[0] = *blue_ptr;
+                output_ptr[1] = ( *green_ptr1 + *green_ptr2 + 1 ) >> 1;
+                output_ptr[2] = *red_ptr;
+
+                output_ptr += 3;
+                red_ptr += 2;
+                green_ptr1 += 2;
+                green_ptr2 += 2;
+                blue_ptr += 2;
+            }
+        }
+
+        return true;
+    }
+
+    // channel of each sample by row and column parity; 0 = blue, 1 = green, 2 = red, matching BGR
+    int channels[2][2];
+    for( int row_parity = 0; row_parity < 2; ++row_parity )
+    {
+        for( int col_parity = 0; col_parity < 2; ++col_parity )
+        {
+            if( row_parity == red_row && col_parity == red_col ) channels[row_parity][col_parity] = 2;
+            else if( row_parity != red_row && col_parity != red_col ) channels[row_parity][col_parity] = 0;
+            else channels[row_parity][col_parity] = 1;
+        }
+    }
+
+    // with an odd factor, blocks alternate between starting on even and odd samples, which changes how many of each color they hold
+    int counts[2][2][3];
+    for( int row_parity = 0; row_parity < 2; ++row_parity )
+    {
+        for( int col_parity = 0; col_parity < 2; ++col_parity )
+        {
+            int * const block_counts = counts[row_parity][col_parity];
+            block_counts[0] = block_counts[1] = block_counts[2] = 0;
+
+            for( int row = 0; row < factor; ++row )
+            {
+                for( int col = 0; col < factor; ++col )
+                {
+                    ++block_counts[channels[( row_parity + row ) & 1][( col_parity + col ) & 1]];
+                }
+            }
+        }
+    }
+
+    std::vector<int> sums( 3 * output_cols );
+
+    for( int output_row = 0; output_row < output_rows; ++output_row )
+    {
+        std::fill( sums.begin(), sums.end(), 0 );
+
+        int const first_row = output_row * factor;
+        for( int row = first_row; row < first_row + factor; ++row )
+        {
+            uchar const * input_ptr = bayer.ptr<uchar>( row );
+            int const * const row_channels = channels[row & 1];
+
+            for( int output_col = 0; output_col < output_cols; ++output_col )
+            {
+                int * const pixel_sums = &sums[3 * output_col];
+                int const first_col = output_col * factor;
+
+                for( int col = first_col; col < first_col + factor; ++col )
+                {
+                    pixel_sums[row_channels[col & 1]] += input_ptr[col];
+                }
+            }
+        }
+
+        uchar * output_ptr = bgr.ptr<uchar>( output_row );
+        for( int output_col = 0; output_col < output_cols; ++output_col )
+        {
+            int const * const block_counts = counts[first_row & 1][( output_col * factor ) & 1];
+
+            for( int channel = 0; channel < 3; ++channel )
+            {
+                output_ptr[channel] = ( sums[3 * output_col + channel] + block_counts[channel] / 2 ) / block_counts[channel];
+            }
+
+            output_ptr += 3;
+        }
+    }
+
+    return true;
+}
+
+//! \return the integer downscale factor equivalent to scale, or 0 if there isn't one (ie scale isn't 1 / n for some n >= 2)
+inline int getDownsampleFactor( double const & scale )
+{
+    if( scale <= 0 || scale > 0.5 ) return 0;
+
+    int const factor = int( 1.0 / scale + 0.5 );
+    return fabs( factor * scale - 1.0 ) < 1e-6 ? factor : 0;
+}
+
+#endif // IMAGETRANSFORMS_BAYERDOWNSAMPLING_H_
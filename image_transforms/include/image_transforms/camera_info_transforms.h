@@ -0,0 +1,80 @@
+/***************************************************************************
+ *  include/image_transforms/camera_info_transforms.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef IMAGETRANSFORMS_CAMERAINFOTRANSFORMS_H_
+#define IMAGETRANSFORMS_CAMERAINFOTRANSFORMS_H_
+
+// utils
+#include <cmath>
+
+// msgs
+#include <sensor_msgs/CameraInfo.h>
+
+// =============================================================================================================================================
+//! Update camera_info for an image resized by scale_x, scale_y with pixel centers aligned, as cv::resize and downsampleBayer() do
+/*!
+ * - Focal lengths, skew and the projection's baseline term scale directly
+ * - Principal points move with pixel centers: a pixel at u maps to ( u + 0.5 ) * scale - 0.5
+ * - width, height and the ROI are rounded to the nearest pixel; callers that crop should overwrite width and height with the actual size
+ * - Distortion and rectification are unitless and stay as they are
+ */
+inline void scaleCameraInfo( sensor_msgs::CameraInfo & camera_info, double const & scale_x, double const & scale_y )
+{
+    camera_info.width = round( camera_info.width * scale_x );
+    camera_info.height = round( camera_info.height * scale_y );
+
+    // K = [ fx s cx; 0 fy cy; 0 0 1 ]
+    camera_info.K[0] *= scale_x;
+    camera_info.K[1] *= scale_x;
+    camera_info.K[2] = ( camera_info.K[2] + 0.5 ) * scale_x - 0.5;
+    camera_info.K[4] *= scale_y;
+    camera_info.K[5] = ( camera_info.K[5] + 0.5 ) * scale_y - 0.5;
+
+    // P = [ fx' s cx' Tx; 0 fy' cy' Ty; 0 0 1 0 ]
+    camera_info.P[0] *= scale_x;
+    camera_info.P[1] *= scale_x;
+    camera_info.P[2] = ( camera_info.P[2] + 0.5 ) * scale_x - 0.5;
+    camera_info.P[3] *= scale_x;
+    camera_info.P[5] *= scale_y;
+    camera_info.P[6] = ( camera_info.P[6] + 0.5 ) * scale_y - 0.5;
+    camera_info.P[7] *= scale_y;
+
+    camera_info.roi.x_offset = round( camera_info.roi.x_offset * scale_x );
+    camera_info.roi.y_offset = round( camera_info.roi.y_offset * scale_y );
+    camera_info.roi.width = round( camera_info.roi.width * scale_x );
+    camera_info.roi.height = round( camera_info.roi.height * scale_y );
+}
+
+#endif // IMAGETRANSFORMS_CAMERAINFOTRANSFORMS_H_
@@ -0,0 +1,151 @@
+/***************************************************************************
+ *  include/image_transforms/color_conversions.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef IMAGETRANSFORMS_COLORCONVERSIONS_H_
+#define IMAGETRANSFORMS_COLORCONVERSIONS_H_
+
+// objects
+#include <opencv2/core/core.hpp>
+
+// utils
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+
+// =============================================================================================================================================
+//! Reciprocal tables for integer hue and saturation, in the style of OpenCV's own 8-bit HSV conversion
+/*! Each entry is ( numerator << SHIFT ) / i, rounded, so a division by i becomes a multiply and a shift */
+struct HueConversionTables
+{
+    static int const SHIFT = 12;
+
+    //! 30 / diff: hue is 30 * ( difference of the other two channels ) / diff on OpenCV's 0-180 scale, plus 0, 60 or 120
+    int hue_[256];
+    //! 255 / max, for HSV saturation
+    int hsv_saturation_[256];
+    //! 255 / ( max + min ) or 255 / ( 510 - max - min ), for HLS saturation
+    int hls_saturation_[511];
+
+    HueConversionTables()
+    {
+        hue_[0] = hsv_saturation_[0] = hls_saturation_[0] = 0;
+
+        for( int i = 1; i < 256; ++i )
+        {
+            hue_[i] = cvRound( ( 30 << SHIFT ) / double( i ) );
+            hsv_saturation_[i] = cvRound( ( 255 << SHIFT ) / double( i ) );
+        }
+
+        for( int i = 1; i < 511; ++i )
+        {
+            hls_saturation_[i] = cvRound( ( 255 << SHIFT ) / double( i ) );
+        }
+    }
+
+    //! Built on first use; function-local statics are initialized once, even with several threads
+    static HueConversionTables const & get()
+    {
+        static HueConversionTables const tables;
+        return tables;
+    }
+};
+
+// =============================================================================================================================================
+//! Convert a bgr8 image to 8-bit HLS and/or HSV in a single pass, sharing the hue between them
+/*!
+ * - Pass NULL for whichever output isn't needed; each non-NULL output is (re)allocated to the size of bgr as needed
+ * - HSV matches cv::cvtColor( CV_BGR2HSV ) exactly, as both use the same integer tables
+ * - HLS matches cv::cvtColor( CV_BGR2HLS ) to within one unit; OpenCV goes through floats for HLS, and rounds differently on exact halves
+ * \return false, leaving the outputs untouched, if bgr isn't 8-bit 3-channel
+ */
+inline bool convertBgrToHueSpaces( cv::Mat const & bgr, cv::Mat * hls, cv::Mat * hsv )
+{
+    if( bgr.type() != CV_8UC3 ) return false;
+
+    if( hls ) hls->create( bgr.size(), CV_8UC3 );
+    if( hsv ) hsv->create( bgr.size(), CV_8UC3 );
+
+    auto const & tables = HueConversionTables::get();
+    int const shift = HueConversionTables::SHIFT;
+    int const half = 1 << ( shift - 1 );
+
+    for( int row = 0; row < bgr.rows; ++row )
+    {
+        uchar const * input_ptr = bgr.ptr<uchar>( row );
+        uchar * hls_ptr = hls ? hls->ptr<uchar>( row ) : NULL;
+        uchar * hsv_ptr = hsv ? hsv->ptr<uchar>( row ) : NULL;
+
+        for( int col = 0; col < bgr.cols; ++col, input_ptr += 3 )
+        {
+            int const blue = input_ptr[0];
+            int const green = input_ptr[1];
+            int const red = input_ptr[2];
+
+            int const max = std::max( std::max( blue, green ), red );
+            int const min = std::min( std::min( blue, green ), red );
+            int const diff = max - min;
+
+            // same channel precedence as OpenCV when two share the max
+            int hue_numerator;
+            if( max == red ) hue_numerator = green - blue;
+            else if( max == green ) hue_numerator = blue - red + 2 * diff;
+            else hue_numerator = red - green + 4 * diff;
+
+            int const hue = ( hue_numerator * tables.hue_[diff] + half ) >> shift;
+
+            if( hls_ptr )
+            {
+                int const sum = max + min;
+
+                // OpenCV's float HLS wraps before rounding, so hues just short of 360 degrees come out as 180 rather than 0
+                hls_ptr[0] = hue_numerator < 0 ? hue + 180 : hue;
+                hls_ptr[1] = ( sum + 1 ) >> 1;
+                hls_ptr[2] = ( diff * tables.hls_saturation_[sum < 255 ? sum : 510 - sum] + half ) >> shift;
+                hls_ptr += 3;
+            }
+
+            if( hsv_ptr )
+            {
+                hsv_ptr[0] = hue < 0 ? hue + 180 : hue;
+                hsv_ptr[1] = ( diff * tables.hsv_saturation_[max] + half ) >> shift;
+                hsv_ptr[2] = max;
+                hsv_ptr += 3;
+            }
+        }
+    }
+
+    return true;
+}
+
+#endif // IMAGETRANSFORMS_COLORCONVERSIONS_H_
@@ -38,56 +38,141 @@
 
 #include <quickdev/node.h>
 
-// Declare a node called ColorTransformNode.
-// A quickdev::RunablePolicy is automatically prepended to the list of policies our node will use.
-// To use more policies, simply list them here:
-//
-// QUICKDEV_DECLARE_NODE( ColorTransform, SomePolicy1, SomePolicy2 )
-//
-QUICKDEV_DECLARE_NODE( ColorTransform )
-
-// Declare a class called ColorTransformNode
-//
+// objects
+#include <quickdev/param_reader.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// utils
+#include <image_transforms/color_conversions.h>
+
+// policies
+#include <quickdev/image_proc_policy.h>
+
+// msgs
+#include <sensor_msgs/Image.h>
+
+typedef sensor_msgs::Image _ImageMsg;
+
+typedef quickdev::ImageProcPolicy _ImageProcPolicy;
+
+//! Converts each bgr8 frame into every requested color space once, publishing each on its own topic
+/*! - spaces are listed in the color_spaces param, ie "hls lab"; each is published on output_<space>
+    - a space is only converted while its topic has subscribers, so listing spaces nobody uses costs nothing
+    - HLS and HSV come out of one table-driven pass that shares the hue between them (see convertBgrToHueSpaces()); everything else goes
+      through cv::cvtColor, whose 8-bit Lab, Luv, YCrCb and gray paths are already table-driven or fixed-point
+    - three-channel outputs are published as bgr8, as the rest of our pipeline expects, whatever the channels actually hold */
+QUICKDEV_DECLARE_NODE( ColorTransform, _ImageProcPolicy )
+
 QUICKDEV_DECLARE_NODE_CLASS( ColorTransform )
 {
-    // Variable initializations can be appended to this constructor as a comma-separated list:
-    //
-    // QUICKDEV_DECLARE_NODE_CONSTRUCTOR( ColorTransform ), member1_( some_value ), member2_( some_other_value ){}
-    //
+protected:
+    //! cv::cvtColor codes stand for themselves; the hue spaces get codes of their own
+    enum
+    {
+        CONVERSION_HLS = -1,
+        CONVERSION_HSV = -2
+    };
+
+    struct ColorSpaceOutput
+    {
+        std::string name_;
+        int conversion_;
+        std::string encoding_;
+        //! A plain publisher, so we can tell whether anyone is listening
+        ros::Publisher publisher_;
+        cv::Mat image_;
+    };
+
+    std::vector<ColorSpaceOutput> outputs_;
+
     QUICKDEV_DECLARE_NODE_CONSTRUCTOR( ColorTransform )
     {
         //
     }
 
-    // This function is called by quickdev::RunablePolicy after all policies are constructed but just before the main loop is started.
-    // All policy initialization should be done here.
-    //
     QUICKDEV_SPIN_FIRST()
     {
-        // Say we had a policy called _SomePolicy that looked for the meta-parameter "some_value1_param" of type SomeType and
-        // "some_value2_param" of type SomeOtherType in its init function
-        // We can create those meta-params here and then pass them to all policies using initPolicies<...>():
-        //
-        // initPolicies<quickdev::policy::ALL>( "some_value1_param", SomeType(), "some_value2_param", SomeOtherType() );
-        //
-        // Or we can pass those meta-params only to _SomePolicy by specifying its type:
-        //
-        // initPolicies<_SomePolicy>( "some_value1_param", SomeType(), "some_value2_param", SomeOtherType() );
-        //
-        // If we want to initialize all policies and use their default values, we can simply call initPolicies<quickdev::policy::ALL>()
-        // with no arguments.
-        // Note that most initable policies won't function properly unless their init() functions are called directly or via initPolicies<...>().
-        // Furthermore, since each policy is required to track its initialization state, initPolicies<...>() is guaranteed to only call init()
-        // on policies that have yet to be initialized; therefore, calling initPolicies<quickdev::policy::ALL>() at the end of QUICKDEV_SPIN_FIRST()
-        // is always a safe operation.
-        // To instead force re-initialization, call forceInitPolicies<...>().
-        //
+        QUICKDEV_GET_RUNABLE_NODEHANDLE( nh_rel );
+
+        initPolicies<_ImageProcPolicy>( "image_callback_param", quickdev::auto_bind( &ColorTransformNode::imageCB, this ) );
+
+        std::stringstream color_spaces( quickdev::ParamReader::readParam<std::string>( nh_rel, "color_spaces", "hls lab" ) );
+        for( std::string name; color_spaces >> name; )
+        {
+            ColorSpaceOutput output;
+            output.name_ = name;
+            output.encoding_ = "bgr8";
+
+            if( name == "hls" ) output.conversion_ = CONVERSION_HLS;
+            else if( name == "hsv" ) output.conversion_ = CONVERSION_HSV;
+            else if( name == "lab" ) output.conversion_ = CV_BGR2Lab;
+            else if( name == "luv" ) output.conversion_ = CV_BGR2Luv;
+            else if( name == "ycrcb" ) output.conversion_ = CV_BGR2YCrCb;
+            else if( name == "xyz" ) output.conversion_ = CV_BGR2XYZ;
+            else if( name == "gray" )
+            {
+                output.conversion_ = CV_BGR2GRAY;
+                output.encoding_ = "mono8";
+            }
+            else
+            {
+                PRINT_WARN( "Unknown color space [%s]; expected hls, hsv, lab, luv, ycrcb, xyz or gray", name.c_str() );
+                continue;
+            }
+
+            output.publisher_ = nh_rel.advertise<_ImageMsg>( "output_" + name, 1 );
+            outputs_.push_back( output );
+
+            PRINT_INFO( "Publishing %s on output_%s", name.c_str(), name.c_str() );
+        }
+
         initPolicies<quickdev::policy::ALL>();
     }
 
-    // This optional function is called by quickdev::RunablePolicy at a fixed rate (defined by the ROS param _loop_rate).
-    // Most updateable policies should have their update( ... ) functions called within this context.
-    //
+    QUICKDEV_DECLARE_IMAGE_CALLBACK( imageCB )
+    {
+        cv::Mat const & image = image_msg->image;
+
+        if( image.type() != CV_8UC3 )
+        {
+            PRINT_WARN( "Expected a bgr8 image" );
+            return;
+        }
+
+        // find out who's listening first, so HLS and HSV can share a pass when both are wanted
+        cv::Mat * hls_image = NULL;
+        cv::Mat * hsv_image = NULL;
+        std::vector<ColorSpaceOutput *> active_outputs;
+
+        for( auto output_it = outputs_.begin(); output_it != outputs_.end(); ++output_it )
+        {
+            if( !output_it->publisher_.getNumSubscribers() ) continue;
+
+            active_outputs.push_back( &*output_it );
+
+            // a fresh buffer every frame; the last one may still be held by an in-process subscriber
+            output_it->image_ = cv::Mat();
+
+            if( output_it->conversion_ == CONVERSION_HLS ) hls_image = &output_it->image_;
+            else if( output_it->conversion_ == CONVERSION_HSV ) hsv_image = &output_it->image_;
+            else cv::cvtColor( image, output_it->image_, output_it->conversion_ );
+        }
+
+        if( hls_image || hsv_image ) convertBgrToHueSpaces( image, hls_image, hsv_image );
+
+        for( auto output_it = active_outputs.begin(); output_it != active_outputs.end(); ++output_it )
+        {
+            auto & output = **output_it;
+
+            auto output_image_msg = quickdev::opencv_conversion::fromMat( output.image_, "", output.encoding_ );
+            output_image_msg->header = image_msg->header;
+
+            output.publisher_.publish( output_image_msg );
+        }
+    }
+
     QUICKDEV_SPIN_ONCE()
     {
         //
@@ -0,0 +1,289 @@
+/***************************************************************************
+ *  include/image_transforms/image_remapper.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef IMAGETRANSFORMS_IMAGEREMAPPER_H_
+#define IMAGETRANSFORMS_IMAGEREMAPPER_H_
+
+// objects
+#include <opencv2/core/core.hpp>
+
+// utils
+#include <opencv2/imgproc/imgproc.hpp>
+#include <algorithm>
+#include <cmath>
+
+// msgs
+#include <sensor_msgs/CameraInfo.h>
+
+// =============================================================================================================================================
+//! Rectification, rotation and scaling composed into a single precomputed cv::remap
+/*!
+ * - Rotation is about the optical axis (ie around the principal point), by angle degrees counter-clockwise as the image is displayed, like
+ *   cv::getRotationMatrix2D; the output is what a camera rolled by -angle about its z axis would see
+ * - With rectify, the output is undistorted and rectified as described by the input's R and P, then rotated and scaled; its camera_info has
+ *   no distortion, identity R, and K and P both set to the output projection
+ * - Without rectify, the output is the raw image rotated and scaled; its camera_info keeps the distortion, folds the rotation into R so
+ *   rectifying the output still lands on the same (scaled) rectified image, and scales K and P. This is exact when fx == fy and the
+ *   distortion is purely radial, which rotation about the optical axis leaves alone; tangential terms are kept as they are
+ * - Without a calibration (K is all zeros), the image is rotated about its center and rectify is ignored
+ * - With expand, the output grows to hold the whole rotated image; otherwise it's the input size times scale
+ * - All of the above is done once in build(); remap() is then a single pass over the image with fixed-point maps
+ */
+class ImageRemapper
+{
+public:
+    typedef sensor_msgs::CameraInfo _CameraInfoMsg;
+
+    struct Settings
+    {
+        bool rectify_;
+        double angle_;
+        double scale_;
+        bool expand_;
+
+        Settings( bool const & rectify = true, double const & angle = 0, double const & scale = 1, bool const & expand = false )
+        :
+            rectify_( rectify ),
+            angle_( angle ),
+            scale_( scale ),
+            expand_( expand )
+        {
+            //
+        }
+
+        bool operator==( Settings const & other ) const
+        {
+            return rectify_ == other.rectify_ && angle_ == other.angle_ && scale_ == other.scale_ && expand_ == other.expand_;
+        }
+    };
+
+protected:
+    bool initialized_;
+    Settings settings_;
+    _CameraInfoMsg input_camera_info_;
+    _CameraInfoMsg output_camera_info_;
+
+    //! Fixed-point maps, as cv::convertMaps makes them; the fastest form cv::remap takes
+    cv::Mat map1_;
+    cv::Mat map2_;
+
+public:
+    ImageRemapper()
+    :
+        initialized_( false )
+    {
+        //
+    }
+
+    //! \return true if build() with these arguments would produce what we already have
+    bool matches( _CameraInfoMsg const & camera_info_msg, Settings const & settings ) const
+    {
+        return initialized_
+            && settings == settings_
+            && camera_info_msg.width == input_camera_info_.width
+            && camera_info_msg.height == input_camera_info_.height
+            && camera_info_msg.distortion_model == input_camera_info_.distortion_model
+            && camera_info_msg.K == input_camera_info_.K
+            && camera_info_msg.R == input_camera_info_.R
+            && camera_info_msg.P == input_camera_info_.P
+            && camera_info_msg.D == input_camera_info_.D;
+    }
+
+    //! Compute the maps and output camera_info for images described by camera_info_msg
+    void build( _CameraInfoMsg const & camera_info_msg, Settings const & settings )
+    {
+        input_camera_info_ = camera_info_msg;
+        settings_ = settings;
+
+        double const scale = settings.scale_ > 0 ? settings.scale_ : 1;
+        double const angle = settings.angle_ * CV_PI / 180;
+        double const cos_angle = cos( angle );
+        double const sin_angle = sin( angle );
+
+        cv::Size const input_size( camera_info_msg.width, camera_info_msg.height );
+
+        // without a calibration we can still rotate and scale, about the middle of the image
+        bool const calibrated = camera_info_msg.K[0] != 0;
+        bool const rectify = settings.rectify_ && calibrated;
+
+        // rectified pixels are described by P, raw ones by K
+        double const * const source_projection = rectify ? &camera_info_msg.P[0] : &camera_info_msg.K[0];
+        int const source_cy_idx = rectify ? 6 : 5;
+        int const source_fy_idx = rectify ? 5 : 4;
+        cv::Point2d const source_center = calibrated
+            ? cv::Point2d( source_projection[2], source_projection[source_cy_idx] )
+            : cv::Point2d( ( input_size.width - 1 ) / 2.0, ( input_size.height - 1 ) / 2.0 );
+
+        // output size and principal point: pixel centers scale like cv::resize, unless we need to grow to hold the rotated corners
+        cv::Size output_size( round( input_size.width * scale ), round( input_size.height * scale ) );
+        cv::Point2d output_center( ( source_center.x + 0.5 ) * scale - 0.5, ( source_center.y + 0.5 ) * scale - 0.5 );
+
+        if( settings.expand_ )
+        {
+            double min_x = 0, max_x = 0, min_y = 0, max_y = 0;
+            for( int corner = 0; corner < 4; ++corner )
+            {
+                double const x = ( corner & 1 ? input_size.width : 0 ) - 0.5 - source_center.x;
+                double const y = ( corner & 2 ? input_size.height : 0 ) - 0.5 - source_center.y;
+
+                double const rotated_x = scale * ( cos_angle * x + sin_angle * y );
+                double const rotated_y = scale * ( -sin_angle * x + cos_angle * y );
+
+                min_x = std::min( min_x, rotated_x );
+                max_x = std::max( max_x, rotated_x );
+                min_y = std::min( min_y, rotated_y );
+                max_y = std::max( max_y, rotated_y );
+            }
+
+            output_size = cv::Size( ceil( max_x - min_x ), ceil( max_y - min_y ) );
+            output_center = cv::Point2d( -min_x - 0.5, -min_y - 0.5 );
+        }
+
+        // the in-plane rotation as a 3-D rotation about the optical axis, taking source camera coordinates to output camera coordinates
+        cv::Matx33d const rotation( cos_angle, sin_angle, 0, -sin_angle, cos_angle, 0, 0, 0, 1 );
+
+        output_camera_info_ = camera_info_msg;
+        output_camera_info_.width = output_size.width;
+        output_camera_info_.height = output_size.height;
+        // we've cropped and scaled everything ourselves; the old ROI no longer means anything
+        output_camera_info_.roi = sensor_msgs::RegionOfInterest();
+
+        cv::Mat map_x;
+        cv::Mat map_y;
+
+        if( rectify )
+        {
+            cv::Matx33d const camera_matrix( &camera_info_msg.K[0] );
+            cv::Matx33d const rectification( &camera_info_msg.R[0] );
+            cv::Matx33d const output_matrix
+            (
+                scale * source_projection[0], scale * source_projection[1], output_center.x,
+                0, scale * source_projection[source_fy_idx], output_center.y,
+                0, 0, 1
+            );
+
+            // undistort, rectify and rotate, then project with the output's intrinsics
+            cv::Mat const distortion( camera_info_msg.D.size(), 1, CV_64F, const_cast<double *>( camera_info_msg.D.data() ) );
+            cv::initUndistortRectifyMap( cv::Mat( camera_matrix ), distortion, cv::Mat( rotation * rectification ), cv::Mat( output_matrix ), output_size, CV_32FC1, map_x, map_y );
+
+            std::fill( output_camera_info_.D.begin(), output_camera_info_.D.end(), 0.0 );
+            std::copy( output_matrix.val, output_matrix.val + 9, output_camera_info_.K.begin() );
+
+            cv::Matx33d const identity = cv::Matx33d::eye();
+            std::copy( identity.val, identity.val + 9, output_camera_info_.R.begin() );
+
+            for( int row = 0; row < 3; ++row )
+            {
+                for( int col = 0; col < 3; ++col ) output_camera_info_.P[4 * row + col] = output_matrix( row, col );
+            }
+            // the baseline term is in pixels, so it scales with the focal length
+            output_camera_info_.P[3] = scale * camera_info_msg.P[3];
+            output_camera_info_.P[7] = scale * camera_info_msg.P[7];
+        }
+        else
+        {
+            // output pixel -> source pixel: undo the scale and rotation about the principal point
+            map_x.create( output_size, CV_32FC1 );
+            map_y.create( output_size, CV_32FC1 );
+
+            for( int row = 0; row < output_size.height; ++row )
+            {
+                float * map_x_ptr = map_x.ptr<float>( row );
+                float * map_y_ptr = map_y.ptr<float>( row );
+
+                double const y = ( row - output_center.y ) / scale;
+
+                for( int col = 0; col < output_size.width; ++col )
+                {
+                    double const x = ( col - output_center.x ) / scale;
+
+                    map_x_ptr[col] = source_center.x + cos_angle * x - sin_angle * y;
+                    map_y_ptr[col] = source_center.y + sin_angle * x + cos_angle * y;
+                }
+            }
+        }
+
+        // the rotated, scaled raw image is a raw image from a camera with scaled intrinsics, rolled about its optical axis
+        if( !rectify && calibrated )
+        {
+            output_camera_info_.K[0] = scale * camera_info_msg.K[0];
+            output_camera_info_.K[1] = scale * camera_info_msg.K[1];
+            output_camera_info_.K[2] = output_center.x;
+            output_camera_info_.K[4] = scale * camera_info_msg.K[4];
+            output_camera_info_.K[5] = output_center.y;
+
+            // rectifying goes from output camera coordinates back through the rotation, then as before
+            cv::Matx33d const rectification = cv::Matx33d( &camera_info_msg.R[0] ) * rotation.t();
+            std::copy( rectification.val, rectification.val + 9, output_camera_info_.R.begin() );
+
+            // the rectified view is unchanged apart from its scale
+            output_camera_info_.P[0] = scale * camera_info_msg.P[0];
+            output_camera_info_.P[1] = scale * camera_info_msg.P[1];
+            output_camera_info_.P[2] = ( camera_info_msg.P[2] + 0.5 ) * scale - 0.5;
+            output_camera_info_.P[3] = scale * camera_info_msg.P[3];
+            output_camera_info_.P[5] = scale * camera_info_msg.P[5];
+            output_camera_info_.P[6] = ( camera_info_msg.P[6] + 0.5 ) * scale - 0.5;
+            output_camera_info_.P[7] = scale * camera_info_msg.P[7];
+        }
+
+        cv::convertMaps( map_x, map_y, map1_, map2_, CV_16SC2 );
+
+        initialized_ = true;
+    }
+
+    bool isInitialized() const
+    {
+        return initialized_;
+    }
+
+    //! Size of the images the maps were built for
+    cv::Size getInputSize() const
+    {
+        return cv::Size( input_camera_info_.width, input_camera_info_.height );
+    }
+
+    //! camera_info describing remap()'s output; only the header is left for the caller to fill in
+    _CameraInfoMsg const & getCameraInfo() const
+    {
+        return output_camera_info_;
+    }
+
+    void remap( cv::Mat const & input, cv::Mat & output, int const & interpolation = cv::INTER_LINEAR ) const
+    {
+        cv::remap( input, output, map1_, map2_, interpolation, cv::BORDER_CONSTANT );
+    }
+};
+
+#endif // IMAGETRANSFORMS_IMAGEREMAPPER_H_
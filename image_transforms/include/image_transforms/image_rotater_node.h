@@ -38,56 +38,201 @@
 
 #include <quickdev/node.h>
 
-// Declare a node called ImageRotaterNode.
-// A quickdev::RunablePolicy is automatically prepended to the list of policies our node will use.
-// To use more policies, simply list them here:
-//
-// QUICKDEV_DECLARE_NODE( ImageRotater, SomePolicy1, SomePolicy2 )
-//
-QUICKDEV_DECLARE_NODE( ImageRotater )
-
-// Declare a class called ImageRotaterNode
-//
+// objects
+#include <image_transforms/image_remapper.h>
+#include <quickdev/multi_publisher.h>
+#include <quickdev/multi_subscriber.h>
+#include <quickdev/param_reader.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <mutex>
+
+// policies
+#include <quickdev/image_proc_policy.h>
+#include <quickdev/reconfigure_policy.h>
+
+// msgs
+#include <sensor_msgs/CameraInfo.h>
+
+// config
+#include <image_transforms/ImageRotaterConfig.h>
+
+typedef sensor_msgs::CameraInfo _CameraInfoMsg;
+
+typedef image_transforms::ImageRotaterConfig _ImageRotaterCfg;
+
+typedef quickdev::ImageProcPolicy _ImageProcPolicy;
+typedef quickdev::ReconfigurePolicy<_ImageRotaterCfg> _ImageRotaterReconfigurePolicy;
+
+//! Rectifies, rotates and scales images in a single cv::remap
+/*! - the maps are only rebuilt when camera_info or the settings change, so each frame costs one pass no matter how many of the three are on
+    - publishes camera_info describing the output; see ImageRemapper for exactly what changes
+    - until camera_info arrives, images are rotated and scaled about their center without rectification */
+QUICKDEV_DECLARE_NODE( ImageRotater, _ImageProcPolicy, _ImageRotaterReconfigurePolicy )
+
 QUICKDEV_DECLARE_NODE_CLASS( ImageRotater )
 {
-    // Variable initializations can be appended to this constructor as a comma-separated list:
-    //
-    // QUICKDEV_DECLARE_NODE_CONSTRUCTOR( ImageRotater ), member1_( some_value ), member2_( some_other_value ){}
-    //
-    QUICKDEV_DECLARE_NODE_CONSTRUCTOR( ImageRotater )
+protected:
+    typedef boost::shared_ptr<ImageRemapper const> _ImageRemapperPtr;
+
+    ros::MultiPublisher<> multi_pub_;
+    ros::MultiSubscriber<> multi_sub_;
+
+    //! Guards everything below; held only to read or swap these, never while building maps or remapping
+    std::mutex remapper_mutex_;
+    _ImageRemapperPtr remapper_;
+    _CameraInfoMsg::ConstPtr last_camera_info_;
+    ImageRemapper::Settings settings_;
+    int interpolation_;
+    //! Bumped whenever camera_info or the settings change, so maps built from older inputs are never installed over newer ones
+    size_t version_;
+
+    QUICKDEV_DECLARE_NODE_CONSTRUCTOR( ImageRotater ),
+        interpolation_( cv::INTER_LINEAR ),
+        version_( 0 )
     {
         //
     }
 
-    // This function is called by quickdev::RunablePolicy after all policies are constructed but just before the main loop is started.
-    // All policy initialization should be done here.
-    //
     QUICKDEV_SPIN_FIRST()
     {
-        // Say we had a policy called _SomePolicy that looked for the meta-parameter "some_value1_param" of type SomeType and
-        // "some_value2_param" of type SomeOtherType in its init function
-        // We can create those meta-params here and then pass them to all policies using initPolicies<...>():
-        //
-        // initPolicies<quickdev::policy::ALL>( "some_value1_param", SomeType(), "some_value2_param", SomeOtherType() );
-        //
-        // Or we can pass those meta-params only to _SomePolicy by specifying its type:
-        //
-        // initPolicies<_SomePolicy>( "some_value1_param", SomeType(), "some_value2_param", SomeOtherType() );
-        //
-        // If we want to initialize all policies and use their default values, we can simply call initPolicies<quickdev::policy::ALL>()
-        // with no arguments.
-        // Note that most initable policies won't function properly unless their init() functions are called directly or via initPolicies<...>().
-        // Furthermore, since each policy is required to track its initialization state, initPolicies<...>() is guaranteed to only call init()
-        // on policies that have yet to be initialized; therefore, calling initPolicies<quickdev::policy::ALL>() at the end of QUICKDEV_SPIN_FIRST()
-        // is always a safe operation.
-        // To instead force re-initialization, call forceInitPolicies<...>().
-        //
+        QUICKDEV_GET_RUNABLE_NODEHANDLE( nh_rel );
+
+        initPolicies<_ImageProcPolicy>( "image_callback_param", quickdev::auto_bind( &ImageRotaterNode::imageCB, this ) );
+
+        multi_sub_.addSubscriber( nh_rel, "camera_info_in", &ImageRotaterNode::cameraInfoCB, this );
+        multi_pub_.addPublishers<_CameraInfoMsg>( nh_rel, { "camera_info_out" } );
+
+        _ImageRotaterReconfigurePolicy::registerCallback( quickdev::auto_bind( &ImageRotaterNode::reconfigureCB, this ) );
+
         initPolicies<quickdev::policy::ALL>();
+
+        updateSettings( config_ );
+    }
+
+    QUICKDEV_DECLARE_IMAGE_CALLBACK( imageCB )
+    {
+        cv::Mat const & image = image_msg->image;
+
+        _ImageRemapperPtr remapper;
+        _CameraInfoMsg::ConstPtr camera_info;
+        int interpolation;
+        {
+            auto lock = quickdev::make_unique_lock( remapper_mutex_ );
+
+            remapper = remapper_;
+            camera_info = last_camera_info_;
+            interpolation = interpolation_;
+        }
+
+        if( !remapper || remapper->getInputSize() != image.size() )
+        {
+            if( camera_info && ( int( camera_info->width ) != image.cols || int( camera_info->height ) != image.rows ) )
+            {
+                PRINT_WARN( "Dropping %dx%d image; camera_info is for %dx%d", image.cols, image.rows, camera_info->width, camera_info->height );
+                return;
+            }
+
+            // either the maps for camera_info haven't been installed yet, or there's no calibration and we rotate and scale about the
+            // center of the image
+            _CameraInfoMsg uncalibrated_camera_info;
+            uncalibrated_camera_info.width = image.cols;
+            uncalibrated_camera_info.height = image.rows;
+
+            remapper = rebuild( camera_info ? *camera_info : uncalibrated_camera_info );
+        }
+
+        cv::Mat output_image;
+        remapper->remap( image, output_image, interpolation );
+
+        auto output_image_msg = quickdev::opencv_conversion::fromMat( output_image, "", image_msg->encoding );
+        output_image_msg->header = image_msg->header;
+
+        if( camera_info )
+        {
+            _CameraInfoMsg output_camera_info = remapper->getCameraInfo();
+            output_camera_info.header = image_msg->header;
+            multi_pub_.publish( "camera_info_out", output_camera_info );
+        }
+
+        _ImageProcPolicy::publishImages( "output_image", output_image_msg );
+    }
+
+    QUICKDEV_DECLARE_MESSAGE_CALLBACK( cameraInfoCB, _CameraInfoMsg )
+    {
+        {
+            auto lock = quickdev::make_unique_lock( remapper_mutex_ );
+
+            last_camera_info_ = msg;
+            if( !remapper_ || !remapper_->matches( *msg, settings_ ) ) ++version_;
+        }
+
+        rebuild( *msg );
+    }
+
+    //! Return maps for camera_info_msg and the current settings, building them if the installed ones don't match; call without remapper_mutex_
+    /*! - the maps are built without the lock, so images keep flowing through the old maps in the meantime
+        - the new maps are installed only if camera_info and the settings haven't changed since the build started; either way they're returned,
+          since they're correct for the inputs the caller asked about */
+    _ImageRemapperPtr rebuild( _CameraInfoMsg const & camera_info_msg )
+    {
+        ImageRemapper::Settings settings;
+        size_t version;
+        {
+            auto lock = quickdev::make_unique_lock( remapper_mutex_ );
+
+            if( remapper_ && remapper_->matches( camera_info_msg, settings_ ) ) return remapper_;
+
+            settings = settings_;
+            version = version_;
+        }
+
+        auto remapper = boost::make_shared<ImageRemapper>();
+        remapper->build( camera_info_msg, settings );
+
+        {
+            auto lock = quickdev::make_unique_lock( remapper_mutex_ );
+
+            if( version != version_ ) return remapper;
+
+            remapper_ = remapper;
+        }
+
+        PRINT_INFO( "Built %ux%u -> %ux%u map", camera_info_msg.width, camera_info_msg.height, remapper->getCameraInfo().width, remapper->getCameraInfo().height );
+
+        return remapper;
+    }
+
+    void updateSettings( _ImageRotaterCfg const & config )
+    {
+        _CameraInfoMsg::ConstPtr camera_info;
+        {
+            auto lock = quickdev::make_unique_lock( remapper_mutex_ );
+
+            settings_ = ImageRemapper::Settings( config.rectify, config.angle, config.scale, config.expand );
+
+            switch( config.interpolation )
+            {
+            case 0: interpolation_ = cv::INTER_NEAREST; break;
+            case 2: interpolation_ = cv::INTER_CUBIC; break;
+            default: interpolation_ = cv::INTER_LINEAR; break;
+            }
+
+            ++version_;
+            camera_info = last_camera_info_;
+
+            // without camera_info, the next image rebuilds from its own size
+            if( !camera_info ) remapper_.reset();
+        }
+
+        if( camera_info ) rebuild( *camera_info );
+    }
+
+    QUICKDEV_DECLARE_RECONFIGURE_CALLBACK( reconfigureCB, _ImageRotaterCfg )
+    {
+        updateSettings( config );
     }
 
-    // This optional function is called by quickdev::RunablePolicy at a fixed rate (defined by the ROS param _loop_rate).
-    // Most updateable policies should have their update( ... ) functions called within this context.
-    //
     QUICKDEV_SPIN_ONCE()
     {
         //
@@ -39,11 +39,15 @@
 #include <quickdev/node.h>
 
 // objects
+#include <image_transforms/bayer_downsampling.h>
 #include <quickdev/multi_publisher.h>
 #include <quickdev/multi_subscriber.h>
 #include <quickdev/param_reader.h>
 #include <camera_info_manager/camera_info_manager.h>
 
+// utils
+#include <image_transforms/camera_info_transforms.h>
+
 // policy
 #include <quickdev/image_proc_policy.h>
 
@@ -74,6 +78,10 @@ protected:
     bool scale_camera_info_;
     bool publish_static_camera_info_;
     double scale_;
+    //! cv::cvtColor code for the input's Bayer layout
+    int debayer_code_;
+    //! Nonzero when scale_ is 1 / n, so debayering and scaling can be done in one pass
+    int downsample_factor_;
 
     QUICKDEV_DECLARE_NODE_CONSTRUCTOR( ImageScaler ),
         camera_info_manager_( quickdev::getFirstOfType<ros::NodeHandle>( args... ) )
@@ -91,6 +99,15 @@ protected:
         scale_camera_info_ = quickdev::ParamReader::readParam<decltype( scale_camera_info_ )>( nh_rel, "scale_camera_info", true );
         publish_static_camera_info_ = quickdev::ParamReader::readParam<decltype( publish_static_camera_info_ )>( nh_rel, "publish_static_camera_info", false );
         scale_ = quickdev::ParamReader::readParam<decltype( scale_ )>( nh_rel, "scale", 0.5 );
+        downsample_factor_ = quickdev::ParamReader::readParam<bool>( nh_rel, "fused_debayer", true ) ? getDownsampleFactor( scale_ ) : 0;
+
+        auto const bayer_pattern = quickdev::ParamReader::readParam<std::string>( nh_rel, "bayer_pattern", "BG" );
+        if( bayer_pattern == "GB" ) debayer_code_ = CV_BayerGB2BGR;
+        else if( bayer_pattern == "RG" ) debayer_code_ = CV_BayerRG2BGR;
+        else if( bayer_pattern == "GR" ) debayer_code_ = CV_BayerGR2BGR;
+        else debayer_code_ = CV_BayerBG2BGR;
+
+        if( debayer_ && downsample_factor_ ) PRINT_INFO( "Debayering and downscaling by %d in one pass", downsample_factor_ );
 
         auto const camera_name = quickdev::ParamReader::readParam<std::string>( nh_rel, "camera_name", "camera" );
 
@@ -118,12 +135,21 @@ protected:
     {
         cv::Mat const & image = image_msg->image;
 
-        cv::Mat output_image;
         cv::Mat scaled_image;
 
-        if( debayer_ ) cv::cvtColor( image, output_image, CV_BayerBG2BGR );
-        else image.copyTo( output_image );
-        cv::resize( output_image, scaled_image, cv::Size(), scale_, scale_ );
+        // each output pixel straight from its block of the mosaic, without a full-resolution color image in between
+        bool const fused = debayer_ && downsample_factor_ && downsampleBayer( image, scaled_image, downsample_factor_, debayer_code_ );
+
+        if( !fused )
+        {
+            if( debayer_ )
+            {
+                cv::Mat output_image;
+                cv::cvtColor( image, output_image, debayer_code_ );
+                cv::resize( output_image, scaled_image, cv::Size(), scale_, scale_ );
+            }
+            else cv::resize( image, scaled_image, cv::Size(), scale_, scale_ );
+        }
 
         auto output_image_msg = quickdev::opencv_conversion::fromMat( scaled_image, "", "bgr8" );
         output_image_msg->header = image_msg->header;
@@ -134,8 +160,11 @@ protected:
             output_camera_info.header = image_msg->header;
             if( scale_camera_info_ )
             {
-                output_camera_info.width *= scale_;
-                output_camera_info.height *= scale_;
+                // with an integer factor, odd rows and columns are cropped rather than rounded
+                double const output_scale = fused ? 1.0 / downsample_factor_ : scale_;
+                scaleCameraInfo( output_camera_info, output_scale, output_scale );
+                output_camera_info.width = scaled_image.cols;
+                output_camera_info.height = scaled_image.rows;
             }
             multi_pub_.publish( "camera_info_out", output_camera_info );
         }
@@ -0,0 +1,165 @@
+/***************************************************************************
+ *  bench/transform_batch_benchmark.cpp
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+// Compares tf traffic from one transform per landmark per message (what the finders used to send) against one message per frame (what
+// TransformBatch sends): messages per second, bytes per frame, the publisher's serialization cost, and a listener's cost to deserialize the
+// messages and insert the transforms into a tf::Transformer, as tf::TransformListener does for every /tf message.
+//
+// Per-message transport and callback overhead in roscpp comes on top of the listener numbers here, so the real savings are larger.
+//
+// usage: transform_batch_benchmark [landmarks_per_frame] [frames] [frame_rate]
+
+#include <tf/tf.h>
+#include <tf/tfMessage.h>
+#include <ros/serialization.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef std::chrono::high_resolution_clock _Clock;
+
+struct TrafficStats
+{
+    size_t num_messages_;
+    size_t num_bytes_;
+    double serialize_us_;
+    double listen_us_;
+};
+
+static double elapsedUs( _Clock::time_point const & start )
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( _Clock::now() - start ).count() / 1000.0;
+}
+
+//! Send each frame's transforms in messages of at most transforms_per_message, and receive them with a fresh tf::Transformer
+static TrafficStats measure( std::vector<std::vector<tf::StampedTransform> > const & frames, size_t const & transforms_per_message )
+{
+    TrafficStats stats = { 0, 0, 0, 0 };
+
+    tf::Transformer transformer;
+    std::vector<uint8_t> buffer;
+
+    for( auto frame_it = frames.cbegin(); frame_it != frames.cend(); ++frame_it )
+    {
+        auto const & transforms = *frame_it;
+
+        for( size_t first = 0; first < transforms.size(); first += transforms_per_message )
+        {
+            size_t const last = std::min( first + transforms_per_message, transforms.size() );
+
+            // publisher: build and serialize
+            auto const publish_start = _Clock::now();
+
+            tf::tfMessage message;
+            message.transforms.resize( last - first );
+            for( size_t transform_idx = first; transform_idx < last; ++transform_idx )
+            {
+                tf::transformStampedTFToMsg( transforms[transform_idx], message.transforms[transform_idx - first] );
+            }
+
+            size_t const num_bytes = ros::serialization::serializationLength( message );
+            buffer.resize( num_bytes );
+            ros::serialization::OStream ostream( buffer.data(), buffer.size() );
+            ros::serialization::serialize( ostream, message );
+
+            stats.serialize_us_ += elapsedUs( publish_start );
+
+            // listener: deserialize and insert
+            auto const listen_start = _Clock::now();
+
+            tf::tfMessage received;
+            ros::serialization::IStream istream( buffer.data(), buffer.size() );
+            ros::serialization::deserialize( istream, received );
+
+            for( auto transform_it = received.transforms.cbegin(); transform_it != received.transforms.cend(); ++transform_it )
+            {
+                tf::StampedTransform transform;
+                tf::transformStampedMsgToTF( *transform_it, transform );
+                transformer.setTransform( transform, "benchmark" );
+            }
+
+            stats.listen_us_ += elapsedUs( listen_start );
+
+            ++stats.num_messages_;
+            stats.num_bytes_ += num_bytes;
+        }
+    }
+
+    return stats;
+}
+
+int main( int argc, char ** argv )
+{
+    size_t const num_landmarks = argc > 1 ? atoi( argv[1] ) : 50;
+    size_t const num_frames = argc > 2 ? atoi( argv[2] ) : 300;
+    double const frame_rate = argc > 3 ? atof( argv[3] ) : 30;
+
+    // landmarks scattered in front of the camera, one stamp per frame
+    srand( 0 );
+    std::vector<std::vector<tf::StampedTransform> > frames( num_frames );
+    for( size_t frame_idx = 0; frame_idx < num_frames; ++frame_idx )
+    {
+        ros::Time const stamp( 1000 + frame_idx / frame_rate );
+
+        for( size_t landmark_idx = 0; landmark_idx < num_landmarks; ++landmark_idx )
+        {
+            std::stringstream child_frame_id;
+            child_frame_id << "landmark_" << landmark_idx;
+
+            tf::Vector3 const origin( 1 + rand() % 500 / 100.0, rand() % 400 / 100.0 - 2, rand() % 300 / 100.0 - 1.5 );
+            frames[frame_idx].push_back( tf::StampedTransform( tf::Transform( tf::createIdentityQuaternion(), origin ), stamp, "/seabee3/camera1", child_frame_id.str() ) );
+        }
+    }
+
+    double const duration = num_frames / frame_rate;
+
+    printf( "%zu landmarks per frame, %zu frames at %.1f Hz\n", num_landmarks, num_frames, frame_rate );
+    printf( "%16s %14s %14s %16s %16s\n", "publication", "messages / s", "bytes / frame", "publish us / fr", "listen us / fr" );
+
+    TrafficStats const individual = measure( frames, 1 );
+    TrafficStats const batched = measure( frames, num_landmarks );
+
+    printf( "%16s %14.1f %14.1f %16.2f %16.2f\n", "per landmark", individual.num_messages_ / duration, double( individual.num_bytes_ ) / num_frames, individual.serialize_us_ / num_frames, individual.listen_us_ / num_frames );
+    printf( "%16s %14.1f %14.1f %16.2f %16.2f\n", "per frame", batched.num_messages_ / duration, double( batched.num_bytes_ ) / num_frames, batched.serialize_us_ / num_frames, batched.listen_us_ / num_frames );
+
+    printf( "listener cost ratio: %.2fx; message rate ratio: %.1fx\n", individual.listen_us_ / batched.listen_us_, double( individual.num_messages_ ) / batched.num_messages_ );
+
+    return 0;
+}
@@ -0,0 +1,335 @@
+/***************************************************************************
+ *  include/landmark_finder/landmark_detector_node.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef LANDMARKFINDER_LANDMARKDETECTORNODE_H_
+#define LANDMARKFINDER_LANDMARKDETECTORNODE_H_
+
+#include <quickdev/node.h>
+
+// policies
+#include <quickdev/reconfigure_policy.h>
+#include <quickdev/tf_tranceiver_policy.h>
+
+// objects
+#include <quickdev/multi_subscriber.h>
+#include <quickdev/multi_publisher.h>
+#include <quickdev/param_reader.h>
+
+// utils
+#include <landmark_finder/landmark_detectors.h>
+#include <landmark_finder/landmark_tracker.h>
+#include <seabee3_common/message_worker.h>
+#include <seabee3_common/snapshot.h>
+#include <seabee3_common/transform_batch.h>
+
+// msgs
+#include <seabee3_msgs/ContourArray.h>
+#include <sensor_msgs/CameraInfo.h>
+
+// config
+#include <landmark_finder/LandmarkDetectorConfig.h>
+
+typedef seabee3_msgs::ContourArray _ContourArrayMsg;
+typedef sensor_msgs::CameraInfo _CameraInfoMsg;
+
+typedef landmark_finder::LandmarkDetectorConfig _LandmarkDetectorCfg;
+
+typedef quickdev::ReconfigurePolicy<_LandmarkDetectorCfg> _LandmarkDetectorReconfigurePolicy;
+typedef quickdev::TfTranceiverPolicy _TfTranceiverPolicy;
+
+// gives us various typedefs including _LandmarkArrayMsg
+using namespace seabee;
+
+//! Finds every known kind of landmark in a single pass over the contour finder's output
+/*! - subscribes to the contours once, no matter how many landmark types are enabled
+    - all detectors share the same per-contour ellipse measurements; see LandmarkPipeline
+    - publishes every detection in one LandmarkArray, plus markers and a transform per landmark
+    - with tracking enabled, detections only correct the tracker, and predicted landmarks are published on every camera_info instead (ie at
+      camera rate), so detection can run slower than the camera without landmarks dropping out or jumping around */
+QUICKDEV_DECLARE_NODE( LandmarkDetector, _LandmarkDetectorReconfigurePolicy, _TfTranceiverPolicy )
+
+QUICKDEV_DECLARE_NODE_CLASS( LandmarkDetector )
+{
+protected:
+    ros::MultiSubscriber<> multi_sub_;
+    ros::MultiPublisher<> multi_pub_;
+    ros::Publisher markers_pub_;
+
+    //! All of a frame's landmark transforms go out in one tf message
+    seabee::TransformBatch transform_batch_;
+
+    //! Only rebuilt when the calibration changes; see CameraGeometry::fromCameraInfo()
+    seabee::Snapshot<CameraGeometry> camera_geometry_;
+
+    //! Rebuilt on reconfigure; copied (cheaply; it only holds pointers) at the start of each cycle
+    LandmarkPipeline pipeline_;
+    std::mutex pipeline_mutex_;
+
+    std::vector<LandmarkDetection> detections_;
+
+    //! Guards the tracker and everything that publishes landmarks, which may happen on the worker or in cameraInfoCB
+    std::mutex tracker_mutex_;
+    bool tracking_enabled_;
+    LandmarkTracker tracker_;
+    std::vector<Landmark> image_landmarks_;
+    std::vector<LandmarkDetection> predicted_detections_;
+
+    int worker_stats_interval_;
+
+    //! Declared last so it's stopped before anything processContours() uses is destroyed
+    seabee::MessageWorker<_ContourArrayMsg::ConstPtr> worker_;
+
+    QUICKDEV_DECLARE_NODE_CONSTRUCTOR( LandmarkDetector ),
+        tracking_enabled_( false )
+    {
+        //
+    }
+
+    QUICKDEV_SPIN_FIRST()
+    {
+        QUICKDEV_GET_RUNABLE_NODEHANDLE( nh_rel );
+
+        multi_sub_.addSubscriber( nh_rel, "contours", &LandmarkDetectorNode::contoursCB, this );
+        multi_sub_.addSubscriber( nh_rel, "camera_info", &LandmarkDetectorNode::cameraInfoCB, this );
+        multi_pub_.addPublishers<_LandmarkArrayMsg>( nh_rel, { "landmarks" } );
+        // a plain publisher, so we can tell whether anyone is listening
+        markers_pub_ = nh_rel.advertise<_MarkerArrayMsg>( "/visualization_marker_array", 1 );
+
+        worker_stats_interval_ = quickdev::ParamReader::readParam<int>( nh_rel, "worker_stats_interval", 300 );
+
+        _LandmarkDetectorReconfigurePolicy::registerCallback( quickdev::auto_bind( &LandmarkDetectorNode::reconfigureCB, this ) );
+
+        initPolicies<quickdev::policy::ALL>();
+
+        updatePipeline( config_ );
+        updateTracker( config_ );
+
+        worker_.setDepth( quickdev::ParamReader::readParam<int>( nh_rel, "queue_depth", 1 ) );
+        worker_.start( quickdev::auto_bind( &LandmarkDetectorNode::processContours, this ) );
+    }
+
+    //! Register a detector for each enabled landmark type
+    void updatePipeline( _LandmarkDetectorCfg const & config )
+    {
+        LandmarkPipeline pipeline;
+
+        if( config.enable_buoys )
+        {
+            auto buoy_detector = boost::make_shared<BuoyDetector>();
+            buoy_detector->constraints_ = EllipseConstraints( config.buoy_aspect_ratio_mean, config.buoy_aspect_ratio_variance, config.buoy_diameter_min );
+            pipeline.addDetector( buoy_detector );
+        }
+
+        if( config.enable_pipes )
+        {
+            auto pipe_detector = boost::make_shared<PipeDetector>();
+            pipe_detector->constraints_ = EllipseConstraints( config.pipe_aspect_ratio_mean, config.pipe_aspect_ratio_variance, config.pipe_diameter_min );
+            pipeline.addDetector( pipe_detector );
+        }
+
+        auto lock = quickdev::make_unique_lock( pipeline_mutex_ );
+        pipeline_ = pipeline;
+    }
+
+    void updateTracker( _LandmarkDetectorCfg const & config )
+    {
+        auto lock = quickdev::make_unique_lock( tracker_mutex_ );
+
+        // start over rather than mix in tracks that stopped being updated
+        if( !config.enable_tracking ) tracker_.clear();
+
+        tracking_enabled_ = config.enable_tracking;
+        tracker_.gate_distance_ = config.tracking_gate_distance;
+        tracker_.max_coast_time_ = config.tracking_max_coast_time;
+        tracker_.min_hits_ = config.tracking_min_hits;
+        tracker_.alpha_ = config.tracking_alpha;
+        tracker_.beta_ = config.tracking_beta;
+    }
+
+    void processContours( _ContourArrayMsg::ConstPtr const & contours_msg_ptr )
+    {
+        // use a consistent camera model for the whole cycle
+        auto const camera_geometry_ptr = camera_geometry_.get();
+
+        if( !camera_geometry_ptr->initialized() )
+        {
+            PRINT_WARN( "Camera model not initialized." );
+            return;
+        }
+
+        // likewise for the set of detectors
+        LandmarkPipeline pipeline;
+        {
+            auto pipeline_lock = quickdev::make_unique_lock( pipeline_mutex_ );
+            pipeline = pipeline_;
+        }
+
+        detections_.clear();
+        pipeline.process( *contours_msg_ptr, *camera_geometry_ptr, detections_ );
+
+        PRINT_INFO( "Found %zu landmarks in %zu contours using %zu detectors", detections_.size(), contours_msg_ptr->contours.size(), pipeline.size() );
+
+        ros::Time const stamp = ros::Time::now();
+
+        {
+            auto lock = quickdev::make_unique_lock( tracker_mutex_ );
+
+            if( tracking_enabled_ )
+            {
+                image_landmarks_.clear();
+                for( auto detection_it = detections_.cbegin(); detection_it != detections_.cend(); ++detection_it )
+                {
+                    image_landmarks_.push_back( detection_it->image_landmark_ );
+                }
+
+                // predictions go out at camera rate; see publishPredictions()
+                tracker_.update( image_landmarks_, stamp.toSec() );
+            }
+            else
+            {
+                publishLandmarks( detections_, stamp );
+            }
+        }
+
+        reportWorkerStats();
+    }
+
+    //! Publish the tracker's landmarks, as predicted for now
+    void publishPredictions()
+    {
+        auto const camera_geometry_ptr = camera_geometry_.get();
+        if( !camera_geometry_ptr->initialized() ) return;
+
+        ros::Time const stamp = ros::Time::now();
+
+        auto lock = quickdev::make_unique_lock( tracker_mutex_ );
+
+        if( !tracking_enabled_ ) return;
+
+        image_landmarks_.clear();
+        tracker_.predict( stamp.toSec(), image_landmarks_ );
+
+        predicted_detections_.clear();
+        for( auto landmark_it = image_landmarks_.cbegin(); landmark_it != image_landmarks_.cend(); ++landmark_it )
+        {
+            predicted_detections_.push_back( projectLandmark( *landmark_it, *camera_geometry_ptr ) );
+        }
+
+        publishLandmarks( predicted_detections_, stamp );
+    }
+
+    //! Publish landmarks, their transforms, and (if anyone is listening) their markers; tracker_mutex_ must be held
+    void publishLandmarks( std::vector<LandmarkDetection> const & detections, ros::Time const & stamp )
+    {
+        // markers are only for visualization; don't build them for nobody
+        bool const publish_markers = markers_pub_.getNumSubscribers() > 0;
+
+        _LandmarkArrayMsg landmarks_msg;
+        _MarkerArrayMsg markers_msg;
+
+        landmarks_msg.landmarks.reserve( detections.size() );
+        if( publish_markers ) markers_msg.markers.reserve( detections.size() );
+
+        size_t marker_id = 0;
+        for( auto detection_it = detections.cbegin(); detection_it != detections.cend(); ++detection_it )
+        {
+            auto const & detection = *detection_it;
+
+            // every transform from this frame shares a stamp, so listeners can look them up together
+            transform_batch_.add( detection.transform_, stamp, detection.frame_id_, detection.landmark_.getUniqueName() );
+
+            landmarks_msg.landmarks.push_back( detection.landmark_ );
+
+            if( !publish_markers ) continue;
+
+            _MarkerMsg marker_msg = detection.landmark_;
+            marker_msg.id = marker_id ++;
+
+            markers_msg.markers.push_back( marker_msg );
+        }
+
+        transform_batch_.flush();
+
+        multi_pub_.publish( "landmarks", landmarks_msg );
+
+        if( !markers_msg.markers.empty() ) markers_pub_.publish( markers_msg );
+    }
+
+    //! Periodically log how many contour arrays were processed or skipped, and how long they waited
+    void reportWorkerStats()
+    {
+        if( worker_stats_interval_ <= 0 ) return;
+
+        auto const stats = worker_.getStats();
+        // this cycle isn't counted as processed until we return
+        if( ( stats.processed_ + 1 ) % worker_stats_interval_ != 0 ) return;
+
+        PRINT_INFO( "Contours: %s", stats.toString().c_str() );
+        auto lock = quickdev::make_unique_lock( tracker_mutex_ );
+
+        PRINT_INFO( "tf: %zu messages carrying %zu transforms", transform_batch_.getNumMessages(), transform_batch_.getNumTransforms() );
+        if( tracking_enabled_ ) PRINT_INFO( "Tracking %zu landmarks", tracker_.size() );
+    }
+
+    QUICKDEV_DECLARE_MESSAGE_CALLBACK( contoursCB, _ContourArrayMsg )
+    {
+        worker_.post( msg );
+    }
+
+    QUICKDEV_DECLARE_MESSAGE_CALLBACK( cameraInfoCB, _CameraInfoMsg )
+    {
+        // the calibration almost never changes; don't rebuild (or copy) anything unless it did
+        if( !camera_geometry_.get()->matches( *msg ) )
+        {
+            camera_geometry_.update( [&msg]( CameraGeometry & camera_geometry ){ camera_geometry.fromCameraInfo( *msg ); } );
+        }
+
+        // camera_info comes with every frame, so this is our camera-rate tick
+        publishPredictions();
+    }
+
+    QUICKDEV_DECLARE_RECONFIGURE_CALLBACK( reconfigureCB, _LandmarkDetectorCfg )
+    {
+        updatePipeline( config );
+        updateTracker( config );
+    }
+
+    QUICKDEV_SPIN_ONCE()
+    {
+        // just update ROS
+    }
+};
+
+#endif // LANDMARKFINDER_LANDMARKDETECTORNODE_H_
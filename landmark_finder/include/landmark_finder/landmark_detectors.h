@@ -0,0 +1,247 @@
+/***************************************************************************
+ *  include/landmark_finder/landmark_detectors.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef LANDMARKFINDER_LANDMARKDETECTORS_H_
+#define LANDMARKFINDER_LANDMARKDETECTORS_H_
+
+// objects
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <vector>
+
+// utils
+#include <seabee3_common/recognition_primitives.h>
+#include <seabee3_common/camera_geometry.h>
+#include <math.h>
+
+// msgs
+#include <seabee3_msgs/ContourArray.h>
+
+namespace seabee
+{
+
+// =============================================================================================================================================
+//! Everything detectors need to know about one contour; computed once per contour and shared, read-only, by every detector
+struct LandmarkCandidate
+{
+    seabee3_msgs::Contour const * contour_msg_;
+    Color color_;
+    //! Full lengths of the blob's ellipse axes, in pixels
+    double max_diameter_;
+    double min_diameter_;
+    double aspect_ratio_;
+};
+
+//! A landmark found by a detector, with its transform relative to frame_id_
+struct LandmarkDetection
+{
+    //! As seen in the image: position and size in pixels, before projectTo3d()
+    Landmark image_landmark_;
+    Landmark landmark_;
+    btTransform transform_;
+    std::string frame_id_;
+};
+
+//! Project a landmark from pixels to meters and work out its transform, according to its type
+inline LandmarkDetection projectLandmark( Landmark const & image_landmark, CameraGeometry const & camera_geometry )
+{
+    LandmarkDetection detection;
+    detection.image_landmark_ = image_landmark;
+    detection.landmark_ = image_landmark;
+    detection.landmark_.projectTo3d( camera_geometry );
+
+    auto const & landmark = detection.landmark_;
+
+    switch( landmark.type_ )
+    {
+    case Landmark::PIPE:
+    {
+        // a pipe looks the same either way around; use whichever direction is closest to straight ahead
+        btQuaternion output_angle_quat( landmark.pose_.orientation_.yaw_, 0, 0 );
+        btQuaternion output_angle_quat2 = output_angle_quat * btQuaternion( M_PI, 0, 0 );
+
+        if( output_angle_quat.angle( btQuaternion( 0, 0, 0, 1 ) ) > output_angle_quat2.angle( btQuaternion( 0, 0, 0, 1 ) ) )
+        {
+            output_angle_quat = output_angle_quat2;
+        }
+
+        detection.transform_ = btTransform( btQuaternion( 0, -M_PI_2, 0 ) * output_angle_quat, unit::convert<btVector3>( landmark.pose_.position_ ) );
+        detection.frame_id_ = "/seabee3/camera2";
+        break;
+    }
+    default:
+        detection.transform_ = unit::convert<btTransform>( landmark.pose_ );
+        detection.frame_id_ = landmark.type_ == Landmark::BIN ? "/seabee3/camera2" : "/seabee3/camera1";
+        break;
+    }
+
+    return detection;
+}
+
+// =============================================================================================================================================
+//! Decides whether a contour is a particular kind of landmark
+class LandmarkDetector
+{
+public:
+    virtual ~LandmarkDetector()
+    {
+        //
+    }
+
+    //! Add a detection for candidate if it's one of ours
+    virtual void evaluate( LandmarkCandidate const & candidate, CameraGeometry const & camera_geometry, std::vector<LandmarkDetection> & detections ) const = 0;
+};
+
+// =============================================================================================================================================
+//! Size and shape limits for landmarks recognized by their ellipse
+struct EllipseConstraints
+{
+    double aspect_ratio_mean_;
+    double aspect_ratio_variance_;
+    double diameter_min_;
+
+    EllipseConstraints( double const & aspect_ratio_mean = 1, double const & aspect_ratio_variance = 0, double const & diameter_min = 0 )
+    :
+        aspect_ratio_mean_( aspect_ratio_mean ),
+        aspect_ratio_variance_( aspect_ratio_variance ),
+        diameter_min_( diameter_min )
+    {
+        //
+    }
+
+    //! True if ( object is not too small ) and ( object has appropriate aspect ratio )
+    bool accepts( LandmarkCandidate const & candidate ) const
+    {
+        return candidate.max_diameter_ > diameter_min_ && fabs( aspect_ratio_mean_ - candidate.aspect_ratio_ ) < aspect_ratio_variance_;
+    }
+};
+
+// =============================================================================================================================================
+class BuoyDetector : public LandmarkDetector
+{
+public:
+    EllipseConstraints constraints_;
+
+    void evaluate( LandmarkCandidate const & candidate, CameraGeometry const & camera_geometry, std::vector<LandmarkDetection> & detections ) const
+    {
+        if( !constraints_.accepts( candidate ) ) return;
+
+        auto const & contour_msg = *candidate.contour_msg_;
+
+        Buoy buoy( Pose( Position( contour_msg.centroid.x, contour_msg.centroid.y ) ), candidate.color_, Size( candidate.min_diameter_, candidate.max_diameter_ ) );
+
+        detections.push_back( projectLandmark( buoy, camera_geometry ) );
+    }
+};
+
+// =============================================================================================================================================
+class PipeDetector : public LandmarkDetector
+{
+public:
+    EllipseConstraints constraints_;
+
+    void evaluate( LandmarkCandidate const & candidate, CameraGeometry const & camera_geometry, std::vector<LandmarkDetection> & detections ) const
+    {
+        if( !constraints_.accepts( candidate ) ) return;
+
+        auto const & contour_msg = *candidate.contour_msg_;
+
+        // counter-clockwise angle of the major axis, in degrees
+        double rect_angle = -contour_msg.angle * 180 / M_PI;
+
+        Pipe pipe( Pose( Position( contour_msg.centroid.x, contour_msg.centroid.y ), Orientation( Radian( Degree( rect_angle ) ) ) ), Size( candidate.min_diameter_, candidate.max_diameter_ ) );
+
+        detections.push_back( projectLandmark( pipe, camera_geometry ) );
+    }
+};
+
+// =============================================================================================================================================
+//! Runs any number of detectors over a ContourArray in one pass
+/*! - per-contour work (color lookup, ellipse-derived sizes) is done once and shared, so adding a landmark type only adds its own test
+    - detectors are evaluated in the order they were added, so detections are in a stable order
+    - process() is const and keeps no per-call state, so one pipeline may be shared by several threads */
+class LandmarkPipeline
+{
+protected:
+    std::vector<boost::shared_ptr<LandmarkDetector const> > detectors_;
+
+public:
+    void addDetector( boost::shared_ptr<LandmarkDetector const> const & detector )
+    {
+        detectors_.push_back( detector );
+    }
+
+    void clearDetectors()
+    {
+        detectors_.clear();
+    }
+
+    size_t size() const
+    {
+        return detectors_.size();
+    }
+
+    void process( seabee3_msgs::ContourArray const & contours_msg, CameraGeometry const & camera_geometry, std::vector<LandmarkDetection> & detections ) const
+    {
+        if( detectors_.empty() ) return;
+
+        auto const & contours = contours_msg.contours;
+
+        for( auto contour_it = contours.cbegin(); contour_it != contours.cend(); ++contour_it )
+        {
+            auto const & contour_msg = *contour_it;
+
+            // degenerate (single row or column) blobs have no meaningful ellipse
+            if( contour_msg.minor_axis <= 0 ) continue;
+
+            LandmarkCandidate candidate;
+            candidate.contour_msg_ = &contour_msg;
+            candidate.color_ = Color( contour_msg.name );
+            // we consider the larger dimension of the object to be its diameter
+            candidate.max_diameter_ = contour_msg.major_axis;
+            candidate.min_diameter_ = contour_msg.minor_axis;
+            candidate.aspect_ratio_ = candidate.max_diameter_ / candidate.min_diameter_;
+
+            for( auto detector_it = detectors_.cbegin(); detector_it != detectors_.cend(); ++detector_it )
+            {
+                (*detector_it)->evaluate( candidate, camera_geometry, detections );
+            }
+        }
+    }
+};
+
+} // seabee
+
+#endif // LANDMARKFINDER_LANDMARKDETECTORS_H_
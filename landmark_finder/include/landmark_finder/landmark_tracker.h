@@ -0,0 +1,272 @@
+/***************************************************************************
+ *  include/landmark_finder/landmark_tracker.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef LANDMARKFINDER_LANDMARKTRACKER_H_
+#define LANDMARKFINDER_LANDMARKTRACKER_H_
+
+// objects
+#include <algorithm>
+#include <vector>
+
+// utils
+#include <seabee3_common/recognition_primitives.h>
+#include <math.h>
+
+namespace seabee
+{
+
+// =============================================================================================================================================
+//! One landmark followed across frames, in image space
+struct LandmarkTrack
+{
+    size_t id_;
+    //! Latest estimate; position and size in pixels, as produced by the detectors before projectTo3d()
+    Landmark image_landmark_;
+    //! Pixels per second
+    double velocity_x_;
+    double velocity_y_;
+    //! When image_landmark_ was last corrected by a detection, in seconds
+    double update_time_;
+    size_t num_hits_;
+
+    //! Where we expect the landmark to be at time, assuming constant velocity
+    Landmark predict( double const & time ) const
+    {
+        double const dt = time - update_time_;
+
+        Landmark landmark( image_landmark_ );
+        landmark.pose_.position_.x_ += velocity_x_ * dt;
+        landmark.pose_.position_.y_ += velocity_y_ * dt;
+
+        return landmark;
+    }
+};
+
+// =============================================================================================================================================
+//! Lightweight multi-target tracker for landmarks in image space
+/*!
+ * - Each track is a constant-velocity alpha-beta filter on the landmark's pixel position; size is smoothed, orientation is taken as measured
+ * - Detections are associated with tracks of the same type and color by greedy nearest-neighbor on predicted position, within a gate
+ * - Unmatched detections start new tracks; tracks that go max_coast_time_ without a detection are dropped
+ * - Tracks are only reported once they've been seen min_hits_ times, so one-frame false positives don't come out the other end
+ * - Not thread-safe
+ */
+class LandmarkTracker
+{
+public:
+    //! Max distance, in pixels, between a track's predicted position and a detection for them to be associated
+    double gate_distance_;
+    //! Seconds a track may go without a detection before it's dropped
+    double max_coast_time_;
+    size_t min_hits_;
+    //! Position and velocity gains; 0 < alpha <= 1, 0 <= beta < alpha
+    double alpha_;
+    double beta_;
+
+protected:
+    std::vector<LandmarkTrack> tracks_;
+    size_t next_id_;
+    double last_time_;
+
+    struct Association
+    {
+        double distance_;
+        size_t track_idx_;
+        size_t detection_idx_;
+
+        bool operator<( Association const & other ) const
+        {
+            return distance_ < other.distance_;
+        }
+    };
+
+    std::vector<Association> associations_;
+    std::vector<bool> track_matched_;
+    std::vector<bool> detection_matched_;
+
+public:
+    LandmarkTracker( double const & gate_distance = 50, double const & max_coast_time = 0.5, size_t const & min_hits = 2, double const & alpha = 0.5, double const & beta = 0.1 )
+    :
+        gate_distance_( gate_distance ),
+        max_coast_time_( max_coast_time ),
+        min_hits_( min_hits ),
+        alpha_( alpha ),
+        beta_( beta ),
+        next_id_( 0 ),
+        last_time_( 0 )
+    {
+        //
+    }
+
+    void clear()
+    {
+        tracks_.clear();
+    }
+
+    size_t size() const
+    {
+        return tracks_.size();
+    }
+
+    std::vector<LandmarkTrack> const & getTracks() const
+    {
+        return tracks_;
+    }
+
+    //! Correct the tracks with a frame's detections, taken at time (seconds)
+    void update( std::vector<Landmark> const & image_landmarks, double const & time )
+    {
+        // time went backwards (ie a bag looped); nothing we know is valid any more
+        if( time < last_time_ ) tracks_.clear();
+        last_time_ = time;
+
+        // candidate pairs within the gate, closest first
+        associations_.clear();
+        for( size_t track_idx = 0; track_idx < tracks_.size(); ++track_idx )
+        {
+            auto const & track = tracks_[track_idx];
+            auto const predicted = track.predict( time );
+
+            for( size_t detection_idx = 0; detection_idx < image_landmarks.size(); ++detection_idx )
+            {
+                auto const & detection = image_landmarks[detection_idx];
+
+                if( detection.type_ != track.image_landmark_.type_ || detection.color_ != track.image_landmark_.color_ ) continue;
+
+                double const dx = detection.pose_.position_.x_ - predicted.pose_.position_.x_;
+                double const dy = detection.pose_.position_.y_ - predicted.pose_.position_.y_;
+                double const distance = sqrt( dx * dx + dy * dy );
+
+                if( distance > gate_distance_ ) continue;
+
+                Association const association = { distance, track_idx, detection_idx };
+                associations_.push_back( association );
+            }
+        }
+
+        std::stable_sort( associations_.begin(), associations_.end() );
+
+        track_matched_.assign( tracks_.size(), false );
+        detection_matched_.assign( image_landmarks.size(), false );
+
+        for( auto association_it = associations_.cbegin(); association_it != associations_.cend(); ++association_it )
+        {
+            auto const & association = *association_it;
+
+            if( track_matched_[association.track_idx_] || detection_matched_[association.detection_idx_] ) continue;
+
+            track_matched_[association.track_idx_] = true;
+            detection_matched_[association.detection_idx_] = true;
+
+            correct( tracks_[association.track_idx_], image_landmarks[association.detection_idx_], time );
+        }
+
+        // drop tracks that have coasted too long
+        size_t num_kept = 0;
+        for( size_t track_idx = 0; track_idx < tracks_.size(); ++track_idx )
+        {
+            if( time - tracks_[track_idx].update_time_ > max_coast_time_ ) continue;
+            if( num_kept != track_idx ) tracks_[num_kept] = tracks_[track_idx];
+            ++num_kept;
+        }
+        tracks_.erase( tracks_.begin() + num_kept, tracks_.end() );
+
+        // anything left over is new
+        for( size_t detection_idx = 0; detection_idx < image_landmarks.size(); ++detection_idx )
+        {
+            if( detection_matched_[detection_idx] ) continue;
+
+            LandmarkTrack track;
+            track.id_ = next_id_ ++;
+            track.image_landmark_ = image_landmarks[detection_idx];
+            track.velocity_x_ = 0;
+            track.velocity_y_ = 0;
+            track.update_time_ = time;
+            track.num_hits_ = 1;
+
+            tracks_.push_back( track );
+        }
+    }
+
+    //! Get the predicted image-space landmark for every confirmed, live track at time (seconds)
+    void predict( double const & time, std::vector<Landmark> & image_landmarks ) const
+    {
+        for( auto track_it = tracks_.cbegin(); track_it != tracks_.cend(); ++track_it )
+        {
+            auto const & track = *track_it;
+
+            if( track.num_hits_ < min_hits_ ) continue;
+
+            double const age = time - track.update_time_;
+            if( age < 0 || age > max_coast_time_ ) continue;
+
+            image_landmarks.push_back( track.predict( time ) );
+        }
+    }
+
+protected:
+    void correct( LandmarkTrack & track, Landmark const & detection, double const & time ) const
+    {
+        double const dt = time - track.update_time_;
+        auto const predicted = track.predict( time );
+
+        auto & position = track.image_landmark_.pose_.position_;
+        auto const & measured_position = detection.pose_.position_;
+
+        double const residual_x = measured_position.x_ - predicted.pose_.position_.x_;
+        double const residual_y = measured_position.y_ - predicted.pose_.position_.y_;
+
+        position.x_ = predicted.pose_.position_.x_ + alpha_ * residual_x;
+        position.y_ = predicted.pose_.position_.y_ + alpha_ * residual_y;
+
+        if( dt > 0 )
+        {
+            track.velocity_x_ += beta_ * residual_x / dt;
+            track.velocity_y_ += beta_ * residual_y / dt;
+        }
+
+        auto & size = track.image_landmark_.size_;
+        size.x_ += alpha_ * ( detection.size_.x_ - size.x_ );
+        size.y_ += alpha_ * ( detection.size_.y_ - size.y_ );
+
+        track.image_landmark_.pose_.orientation_ = detection.pose_.orientation_;
+        track.update_time_ = time;
+        ++track.num_hits_;
+    }
+};
+
+} // seabee
+
+#endif // LANDMARKFINDER_LANDMARKTRACKER_H_
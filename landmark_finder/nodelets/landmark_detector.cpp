@@ -1,5 +1,5 @@
 /***************************************************************************
- *  nodelets/buoy_finder.cpp
+ *  nodelets/landmark_detector.cpp
  *  --------------------
  *
  *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
@@ -34,15 +34,15 @@
  **************************************************************************/
 
 #include <quickdev/nodelet.h>
-#include <landmark_finder/buoy_finder_node.h>
+#include <landmark_finder/landmark_detector_node.h>
 
-// This file was auto-generated; the corresponding header file is ../include/landmark_finder/buoy_finder_node.h
+// This file was auto-generated; the corresponding header file is ../include/landmark_finder/landmark_detector_node.h
 
-// Declare BuoyFinder in namespace landmark_finder
+// Declare LandmarkDetector in namespace landmark_finder
 //
-QUICKDEV_DECLARE_NODELET( landmark_finder, BuoyFinder )
+QUICKDEV_DECLARE_NODELET( landmark_finder, LandmarkDetector )
 
 // Instantiate our nodelet; this macro expands to a call to PLUGINLIB_DECLARE_CLASS and
-// registers our nodelet class landmark_finder::BuoyFinder as landmark_finder/buoy_finder
+// registers our nodelet class landmark_finder::LandmarkDetector as landmark_finder/landmark_detector
 //
-QUICKDEV_INST_NODELET( landmark_finder, BuoyFinder, buoy_finder )
+QUICKDEV_INST_NODELET( landmark_finder, LandmarkDetector, landmark_detector )
@@ -1,48 +0,0 @@
-/***************************************************************************
- *  nodelets/pipe_finder.cpp
- *  --------------------
- *
- *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
- *  All rights reserved.
- *
- *  Redistribution and use in source and binary forms, with or without
- *  modification, are permitted provided that the following conditions are
- *  met:
- *
- *  * Redistributions of source code must retain the above copyright
- *    notice, this list of conditions and the following disclaimer.
- *  * Redistributions in binary form must reproduce the above
- *    copyright notice, this list of conditions and the following disclaimer
- *    in the documentation and/or other materials provided with the
- *    distribution.
- *  * Neither the name of seabee3-ros-pkg nor the names of its
- *    contributors may be used to endorse or promote products derived from
- *    this software without specific prior written permission.
- *
- *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
- *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
- *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
- *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
- *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
- *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
- *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
- *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
- *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
- *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
- *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
- *
- **************************************************************************/
-
-#include <quickdev/nodelet.h>
-#include <landmark_finder/pipe_finder_node.h>
-
-// This file was auto-generated; the corresponding header file is ../include/landmark_finder/pipe_finder_node.h
-
-// Declare PipeFinder in namespace landmark_finder
-//
-QUICKDEV_DECLARE_NODELET( landmark_finder, PipeFinder )
-
-// Instantiate our nodelet; this macro expands to a call to PLUGINLIB_DECLARE_CLASS and
-// registers our nodelet class landmark_finder::PipeFinder as landmark_finder/pipe_finder
-//
-QUICKDEV_INST_NODELET( landmark_finder, PipeFinder, pipe_finder )
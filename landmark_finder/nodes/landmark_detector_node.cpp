@@ -1,5 +1,5 @@
 /***************************************************************************
- *  nodes/buoy_finder_node.cpp
+ *  nodes/landmark_detector_node.cpp
  *  --------------------
  *
  *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
@@ -33,10 +33,10 @@
  *
  **************************************************************************/
 
-#include <landmark_finder/buoy_finder_node.h>
+#include <landmark_finder/landmark_detector_node.h>
 
-// This file was auto-generated; the corresponding header file is ../include/landmark_finder/buoy_finder_node.h
+// This file was auto-generated; the corresponding header file is ../include/landmark_finder/landmark_detector_node.h
 
 // Instantiate our node; this macro expands to an int main( ... ) in which an instance of our node is created and started
 //
-QUICKDEV_INST_NODE( BuoyFinderNode, "buoy_finder" )
+QUICKDEV_INST_NODE( LandmarkDetectorNode, "landmark_detector" )
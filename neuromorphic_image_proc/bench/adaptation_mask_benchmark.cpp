@@ -0,0 +1,191 @@
+/***************************************************************************
+ *  bench/adaptation_mask_benchmark.cpp
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+// Compares AdaptationMaskKernel (SIMD and scalar) against the multi-pass OpenCV sequence it replaced in AdaptationMaskNode::imageCB
+// (absdiff, split, weighted sum, threshold, masked copyTo/setTo), on a sequence of frames with a moving region, and reports how many
+// mask pixels differ between the two (the OpenCV version rounds its weighted sum differently, so a few pixels right at the threshold may).
+//
+// usage: adaptation_mask_benchmark [width] [height] [iterations]
+// defaults to 640x480
+
+#include <neuromorphic_image_proc/adaptation_mask_kernel.h>
+#include <opencv/cv.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+typedef std::chrono::high_resolution_clock _Clock;
+
+static unsigned int const THRESHOLD = 30;
+
+//! The original multi-pass implementation
+struct ReferenceAdaptationMask
+{
+    cv::Mat last_image_;
+    cv::Mat adaptation_image_;
+    cv::Mat high_values_mask_;
+    cv::Mat adaptation_time_image_;
+    cv::Mat adaptation_mask_image_;
+
+    void reset( cv::Mat const & image )
+    {
+        image.copyTo( last_image_ );
+        adaptation_time_image_ = cv::Mat::zeros( image.size(), CV_8UC1 );
+    }
+
+    void process( cv::Mat const & image )
+    {
+        cv::absdiff( image, last_image_, adaptation_image_ );
+
+        std::vector<cv::Mat> adaptation_images( 3 );
+        cv::split( adaptation_image_, adaptation_images );
+
+        adaptation_time_image_ += 1;
+        adaptation_mask_image_ = adaptation_images[0] * 0.33 + adaptation_images[1] * 0.33 + adaptation_images[2] * 0.33 + adaptation_time_image_;
+
+        cv::threshold( adaptation_mask_image_, high_values_mask_, THRESHOLD, 255, CV_THRESH_BINARY );
+
+        image.copyTo( last_image_, high_values_mask_ );
+        adaptation_time_image_.setTo( cv::Scalar( 0 ), high_values_mask_ );
+    }
+};
+
+//! The fused kernel, as used by AdaptationMaskNode
+struct FusedAdaptationMask
+{
+    cv::Mat last_image_;
+    cv::Mat high_values_mask_;
+    cv::Mat adaptation_time_image_;
+    bool enable_simd_;
+
+    FusedAdaptationMask( bool const & enable_simd )
+    :
+        enable_simd_( enable_simd )
+    {
+        //
+    }
+
+    void reset( cv::Mat const & image )
+    {
+        image.copyTo( last_image_ );
+        adaptation_time_image_ = cv::Mat::zeros( image.size(), CV_8UC1 );
+        high_values_mask_.create( image.size(), CV_8UC1 );
+    }
+
+    void process( cv::Mat const & image )
+    {
+        for( int y = 0; y < image.rows; ++y )
+        {
+            AdaptationMaskKernel::processRow( image.ptr<uchar>( y ), last_image_.ptr<uchar>( y ), adaptation_time_image_.ptr<uchar>( y ), high_values_mask_.ptr<uchar>( y ), image.cols, THRESHOLD, enable_simd_ );
+        }
+    }
+};
+
+//! A noisy background with a bright square moving across it
+static void makeFrames( cv::Size const & size, size_t const & num_frames, std::vector<cv::Mat> & frames )
+{
+    cv::Mat background( size, CV_8UC3 );
+    cv::randu( background, cv::Scalar::all( 0 ), cv::Scalar::all( 255 ) );
+
+    frames.resize( num_frames );
+    for( size_t i = 0; i < num_frames; ++i )
+    {
+        cv::Mat noise( size, CV_8UC3 );
+        cv::randu( noise, cv::Scalar::all( 0 ), cv::Scalar::all( 8 ) );
+
+        frames[i] = background + noise;
+
+        int const square_size = size.height / 4;
+        int const x = ( i * 7 ) % ( size.width - square_size );
+        cv::rectangle( frames[i], cv::Rect( x, size.height / 3, square_size, square_size ), cv::Scalar( 20, 200, 250 ), CV_FILLED );
+    }
+}
+
+template<class __Mask>
+double timeMsPerFrame( __Mask & mask, std::vector<cv::Mat> const & frames, size_t const & iterations )
+{
+    mask.reset( frames[0] );
+
+    auto const start = _Clock::now();
+    for( size_t i = 0; i < iterations; ++i )
+    {
+        mask.process( frames[i % frames.size()] );
+    }
+    auto const end = _Clock::now();
+
+    return std::chrono::duration_cast<std::chrono::microseconds>( end - start ).count() / ( 1000.0 * iterations );
+}
+
+int main( int argc, char ** argv )
+{
+    int const width = argc > 1 ? atoi( argv[1] ) : 640;
+    int const height = argc > 2 ? atoi( argv[2] ) : 480;
+    size_t const iterations = argc > 3 ? atoi( argv[3] ) : 200;
+
+    std::vector<cv::Mat> frames;
+    makeFrames( cv::Size( width, height ), 32, frames );
+
+    printf( "Adaptation mask on %ix%i frames, %zu iterations; SIMD %s\n", width, height, iterations, AdaptationMaskKernel::simdAvailable() ? "available" : "not available" );
+
+    ReferenceAdaptationMask reference;
+    FusedAdaptationMask scalar( false );
+    FusedAdaptationMask simd( true );
+
+    double const reference_ms = timeMsPerFrame( reference, frames, iterations );
+    double const scalar_ms = timeMsPerFrame( scalar, frames, iterations );
+    double const simd_ms = timeMsPerFrame( simd, frames, iterations );
+
+    printf( "%12s %12s %12s\n", "multi-pass", "fused", "fused simd" );
+    printf( "%9.3f ms %9.3f ms %9.3f ms\n", reference_ms, scalar_ms, simd_ms );
+
+    // run all three over the same frames and compare the masks on the last one
+    reference.reset( frames[0] );
+    simd.reset( frames[0] );
+    scalar.reset( frames[0] );
+    for( size_t i = 1; i < frames.size(); ++i )
+    {
+        reference.process( frames[i] );
+        simd.process( frames[i] );
+        scalar.process( frames[i] );
+    }
+
+    printf( "mask pixels differing from multi-pass: %i; simd vs scalar: %i\n",
+        cv::countNonZero( reference.high_values_mask_ != simd.high_values_mask_ ),
+        cv::countNonZero( scalar.high_values_mask_ != simd.high_values_mask_ ) );
+
+    return 0;
+}
@@ -0,0 +1,139 @@
+/***************************************************************************
+ *  bench/preprocessor_benchmark.cpp
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+// Compares HlsPreprocessor against the cv::resize + cv::GaussianBlur + cv::cvtColor sequence it replaces, for the settings used by
+// ColorClassifierNode (downscale 2, 15x15 blur, sigma 3) and AdaptationMaskNode (no downscale, 3x3 blur), and reports the largest
+// per-channel difference between the two outputs.
+//
+// usage: preprocessor_benchmark [image_uri] [iterations]
+// if no image is given, a random 640x480 image is used
+
+#include <neuromorphic_image_proc/hls_preprocessor.h>
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+typedef std::chrono::high_resolution_clock _Clock;
+
+template<class __Function>
+double timeMsPerFrame( __Function function, size_t const & iterations )
+{
+    // warm up
+    function();
+
+    auto const start = _Clock::now();
+    for( size_t i = 0; i < iterations; ++i )
+    {
+        function();
+    }
+    auto const end = _Clock::now();
+
+    return std::chrono::duration_cast<std::chrono::microseconds>( end - start ).count() / ( 1000.0 * iterations );
+}
+
+void runBenchmark( cv::Mat const & image, int const & downscale, int const & blur_size, double const & blur_sigma, size_t const & iterations )
+{
+    cv::Mat reference_image;
+    auto const reference = [&]()
+    {
+        cv::Mat resized_image;
+        if( downscale > 1 ) cv::resize( image, resized_image, cv::Size(), 1.0 / downscale, 1.0 / downscale );
+        else resized_image = image;
+
+        cv::Mat blurred_image;
+        cv::GaussianBlur( resized_image, blurred_image, cv::Size( blur_size, blur_size ), blur_sigma );
+        cv::cvtColor( blurred_image, reference_image, CV_BGR2HLS );
+    };
+
+    HlsPreprocessor preprocessor( downscale, blur_size, blur_sigma );
+    cv::Mat fused_image;
+    auto const fused = [&]()
+    {
+        preprocessor.process( image, fused_image );
+    };
+
+    double const reference_ms = timeMsPerFrame( reference, iterations );
+    double const fused_ms = timeMsPerFrame( fused, iterations );
+
+    // hue is circular, so a difference of 179 is really a difference of 1
+    int max_diff[3] = { 0, 0, 0 };
+    for( int y = 0; y < fused_image.rows; ++y )
+    {
+        for( int x = 0; x < fused_image.cols; ++x )
+        {
+            auto const & a = reference_image.at<cv::Vec3b>( y, x );
+            auto const & b = fused_image.at<cv::Vec3b>( y, x );
+
+            for( int c = 0; c < 3; ++c )
+            {
+                int diff = abs( int( a[c] ) - int( b[c] ) );
+                if( c == 0 ) diff = std::min( diff, 180 - diff );
+                max_diff[c] = std::max( max_diff[c], diff );
+            }
+        }
+    }
+
+    printf( "%9i %5ix%-5i %12.3f %12.3f %8.2fx %6i %6i %6i\n", downscale, blur_size, blur_size, reference_ms, fused_ms, reference_ms / fused_ms, max_diff[0], max_diff[1], max_diff[2] );
+}
+
+int main( int argc, char ** argv )
+{
+    std::string const image_uri = argc > 1 ? argv[1] : "";
+    size_t const iterations = argc > 2 ? atoi( argv[2] ) : 50;
+
+    cv::Mat image;
+    if( !image_uri.empty() ) image = cv::imread( image_uri );
+
+    if( image.empty() )
+    {
+        printf( "Using random 640x480 image\n" );
+        image.create( 480, 640, CV_8UC3 );
+        cv::randu( image, cv::Scalar::all( 0 ), cv::Scalar::all( 255 ) );
+    }
+
+    printf( "Preprocessing %ix%i image, %zu iterations\n", image.cols, image.rows, iterations );
+    printf( "%9s %11s %12s %12s %9s %6s %6s %6s\n", "downscale", "blur", "3-call ms", "fused ms", "speedup", "max dH", "max dL", "max dS" );
+
+    // ColorClassifierNode
+    runBenchmark( image, 2, 15, 3, iterations );
+    // AdaptationMaskNode
+    runBenchmark( image, 1, 3, 0, iterations );
+
+    return 0;
+}
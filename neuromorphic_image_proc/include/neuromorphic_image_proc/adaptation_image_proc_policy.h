@@ -39,6 +39,7 @@
 #include <quickdev/image_proc_policy.h>
 
 // objects
+#include <neuromorphic_image_proc/stamp_synchronizer.h>
 #include <mutex>
 
 // policies
@@ -62,23 +63,23 @@ public:
     typedef QUICKDEV_GET_POLICY_NS( AdaptationImageProc )::_ImageProcPolicy _ImageProcPolicy;
     typedef QUICKDEV_GET_POLICY_NS( AdaptationImageProc )::_CombinedImageCallbackPolicy _CombinedImageCallbackPolicy;
     typedef cv_bridge::CvImageConstPtr _CvImageMsgPtr;
+    //! Images are the first stream, masks the second
+    typedef StampSynchronizer<_CvImageMsgPtr> _Synchronizer;
 
 protected:
-    _CvImageMsgPtr image_ptr_;
-    _CvImageMsgPtr adaptation_mask_ptr_;
-
-    std::deque<_CvImageMsgPtr> image_queue_;
-    std::deque<_CvImageMsgPtr> mask_queue_;
-
-    std::deque<_CvImageMsgPtr> visited_images_;
-    std::deque<_CvImageMsgPtr> visited_masks_;
-
-    std::mutex synced_callback_mutex_;
+    _Synchronizer synchronizer_;
+    //! Serializes calls to the combined image callback
+    std::mutex callback_mutex_;
 
     bool disable_mask_;
 
+    //! Report synchronizer stats every this many images; 0 to disable
+    int sync_stats_interval_;
+    size_t last_reported_dropped_;
+
     QUICKDEV_DECLARE_POLICY_CONSTRUCTOR( AdaptationImageProc ),
-        initialized_( false )
+        initialized_( false ),
+        last_reported_dropped_( 0 )
     {
         printPolicyActionStart( "create", this );
         printPolicyActionDone( "create", this );
@@ -95,6 +96,14 @@ protected:
 
         disable_mask_ = quickdev::policy::readPolicyParam<decltype( disable_mask_ )>( nh_rel, "disable_mask_param", "disable_mask", false, args... );
 
+        // masks are matched to images by stamp; unmatched images and masks are kept for at most sync_max_age seconds, up to sync_capacity of each
+        auto const sync_capacity = quickdev::policy::readPolicyParam<int>( nh_rel, "sync_capacity_param", "sync_capacity", 10, args... );
+        auto const sync_max_age = quickdev::policy::readPolicyParam<double>( nh_rel, "sync_max_age_param", "sync_max_age", 1.0, args... );
+        auto const sync_tolerance = quickdev::policy::readPolicyParam<double>( nh_rel, "sync_tolerance_param", "sync_tolerance", 0.0, args... );
+        sync_stats_interval_ = quickdev::policy::readPolicyParam<int>( nh_rel, "sync_stats_interval_param", "sync_stats_interval", 300, args... );
+
+        synchronizer_.configure( std::max( sync_capacity, 1 ), ros::Duration( sync_max_age ), ros::Duration( sync_tolerance ) );
+
         if( !disable_mask_ )
         {
             // subscription to mask with pixel updates
@@ -113,204 +122,76 @@ protected:
         _CombinedImageCallbackPolicy::registerCallback( std::forward<__Args>( args )... );
     }
 
-    void tryCallSyncedImagesCB()
+    //! Add an image or mask to the synchronizer; if that completes a pair, pass the pair to the registered callback
+    void addSyncedImage( _Synchronizer::Side const & side, _CvImageMsgPtr const & image_msg )
     {
-//        std::cout << "Looking for image/mask pair; waiting for lock..." << std::endl;
-        synced_callback_mutex_.lock();
-//        std::cout << "Looking for image/mask pair; acquired lock..." << std::endl;
-
-//        std::cout << "Trying to find mask/image pair; cached " << visited_images_.size() << " old images and " << visited_masks_.size() << " old masks" << std::endl;
-
-/*
-        in    vis
-
-        i m | i m
-        ----|----
-        0 2 | - -
-        1 3 | - -
-        2 4 | - -
-        3 0 | - -
-        4 1 | - -
-
-        i m | i m
-        ----|----
-        1 3 | 0 2
-        2 4 | - -
-        3 0 | - -
-        4 1 | - -
-
-        i m | i m
-        ----|----
-        2 4 | 0 2
-        3 0 | 1 3
-        4 1 | - -
-
-        i m | i m
-        ----|----
-        3 4 | 0 3
-        4 0 | 1 -
-        - 1 | - -
-
-        i m | i m
-        ----|----
-        4 4 | 0 -
-        - 0 | 1 -
-        - 1 | - -
-
-        i m | i m
-        ----|----
-        - 0 | 0 -
-        - 1 | 1 -
-
-        i m | i m
-        ----|----
-        - 0 | 0 -
-
-        i m | i m
-        ----|----
-*/
-        //! storage for a copy of the current image
-        _CvImageMsgPtr current_image;
-        //! storage for a copy of the current mask
-        _CvImageMsgPtr current_mask;
-
-        //! storage for a copy of the image, if we find it
         _CvImageMsgPtr matched_image;
-        //! storage for a copy of the mask, if we find it
         _CvImageMsgPtr matched_mask;
-        //! flag to indicate whether we've found the pair of images
-        bool match_found = false;
-
-        if( disable_mask_ && !image_queue_.empty() )
-        {
-            _CombinedImageCallbackPolicy::invokeCallback( image_queue_.front(), _CvImageMsgPtr() );
-            image_queue_.pop_front();
-            synced_callback_mutex_.unlock();
-            return;
-        }
 
+        // only the synchronizer's bookkeeping is locked here, so images and masks never wait on the (much slower) callback
+        bool const match_found = synchronizer_.add( side, image_msg->header.stamp, image_msg, matched_image, matched_mask );
 
-        // while no match has been found and there's at least one new image or mask to process
-        while( !match_found && !( image_queue_.empty() && mask_queue_.empty() ) )
-        {
-            // if we have a new image
-            if( !image_queue_.empty() )
-            {
-//                std::cout << "Looking for image/mask pair; using new image" << std::endl;
-                current_image = image_queue_.front();
-                image_queue_.pop_front();
-            }
-
-            // if we have a new mask
-            if( !mask_queue_.empty() )
-            {
-//                std::cout << "Looking for image/mask pair; using new mask" << std::endl;
-                current_mask = mask_queue_.front();
-                mask_queue_.pop_front();
-            }
-
-            // if the first pair of images matches
-            if( current_image && current_mask && current_image->header.stamp == current_mask->header.stamp )
-            {
-//                std::cout << "Looking for image/mask pair; new messages match" << std::endl;
-                match_found = true;
-                matched_image = current_image;
-                matched_mask = current_mask;
-            }
-            else
-            {
-//                std::cout << "Looking for image/mask pair; new messages don't match; looking through " << visited_images_.size() << " old images and " << visited_masks_.size() << " old masks" << std::endl;
-                // if we have a new mask
-                if( !match_found && current_mask )
-                {
-                    // try to find a matching image
-                    for( auto visited_images_it = visited_images_.begin(); visited_images_it != visited_images_.end(); ++visited_images_it )
-                    {
-                        if( current_mask->header.stamp == (*visited_images_it)->header.stamp )
-                        {
-//                            std::cout << "Looking for image/mask pair; matched current mask to old image" << std::endl;
-                            match_found = true;
-                            matched_image = *visited_images_it;
-                            matched_mask = current_mask;
-
-                            visited_images_.erase( visited_images_it );
-
-                            break;
-                        }
-                    }
-                }
-                // if we have a new image
-                if( !match_found && current_image )
-                {
-                    // try to find a matching mask
-                    for( auto visited_masks_it = visited_masks_.begin(); visited_masks_it != visited_masks_.end(); ++visited_masks_it )
-                    {
-                        if( current_image->header.stamp == (*visited_masks_it)->header.stamp )
-                        {
-//                            std::cout << "Looking for image/mask pair; matched current image to old mask" << std::endl;
-                            match_found = true;
-                            matched_image = current_image;
-                            matched_mask = *visited_masks_it;
-
-                            visited_masks_.erase( visited_masks_it );
-
-                            break;
-                        }
-                    }
-                }
-
-                // if we didn't find any matches, or if we did but the current image wasn't matched
-                if( current_image && ( !match_found || current_image != matched_image ) ) visited_images_.push_back( current_image );
-                // if we didn't find any matches, or if we did but the current mask wasn't matched
-                if( current_mask && ( !match_found || current_mask != matched_mask ) ) visited_masks_.push_back( current_mask );
-            }
-        }
-
-        // if we found a match, pass it to the registered caller
-        if( match_found )
-        {
-//            std::cout << "Looking for image/mask pair; found matching pair; invoking registered callback" << std::endl;
-            _CombinedImageCallbackPolicy::invokeCallback( matched_image, matched_mask );
-//            std::cout << "Looking for image/mask pair; found matching pair; registered callback completed" << std::endl;
-        }
+        if( side == _Synchronizer::FIRST ) reportSynchronizerStats();
 
-        // unblock dependent callbacks
-//        std::cout << "Looking for image/mask pair; releasing lock..." << std::endl;
-        synced_callback_mutex_.unlock();
+        if( match_found ) invokeCombinedImageCallback( matched_image, matched_mask );
     }
 
-    QUICKDEV_DECLARE_IMAGE_CALLBACK( imageCB )
+    void invokeCombinedImageCallback( _CvImageMsgPtr const & image_msg, _CvImageMsgPtr const & mask_msg )
     {
-//        std::cout << "Got new image; waiting for lock..." << std::endl;
-        synced_callback_mutex_.lock();
-//        std::cout << "Got new image; acquired lock" << std::endl;
+        // callbacks for successive pairs never overlap
+        auto lock = quickdev::make_unique_lock( callback_mutex_ );
+        _CombinedImageCallbackPolicy::invokeCallback( image_msg, mask_msg );
+    }
 
-        //while( image_queue_.size() >= 10 ) image_queue_.pop_front();
-        image_queue_.push_back( image_msg );
+    //! Periodically warn about images or masks that were dropped without being matched
+    void reportSynchronizerStats()
+    {
+        if( sync_stats_interval_ <= 0 ) return;
 
-//        PRINT_INFO( "%zu images waiting to be processed.", image_queue_.size() );
+        auto const stats = synchronizer_.getStats();
+        if( stats.received_[_Synchronizer::FIRST] % sync_stats_interval_ != 0 ) return;
 
-//        std::cout << "Got new image; releasing lock" << std::endl;
-        synced_callback_mutex_.unlock();
+        size_t const dropped = stats.getDropped( _Synchronizer::FIRST ) + stats.getDropped( _Synchronizer::SECOND );
+        if( dropped == last_reported_dropped_ ) return;
+        last_reported_dropped_ = dropped;
 
-        tryCallSyncedImagesCB();
+        PRINT_WARN
+        (
+            "Image/mask sync: %zu/%zu images/masks received, %zu matched, %zu resets; dropped images (capacity/age/duplicate/reset): %zu/%zu/%zu/%zu, masks: %zu/%zu/%zu/%zu",
+            stats.received_[_Synchronizer::FIRST],
+            stats.received_[_Synchronizer::SECOND],
+            stats.matched_,
+            stats.resets_,
+            stats.dropped_capacity_[_Synchronizer::FIRST],
+            stats.dropped_age_[_Synchronizer::FIRST],
+            stats.dropped_duplicate_[_Synchronizer::FIRST],
+            stats.dropped_reset_[_Synchronizer::FIRST],
+            stats.dropped_capacity_[_Synchronizer::SECOND],
+            stats.dropped_age_[_Synchronizer::SECOND],
+            stats.dropped_duplicate_[_Synchronizer::SECOND],
+            stats.dropped_reset_[_Synchronizer::SECOND]
+        );
     }
 
-    QUICKDEV_DECLARE_IMAGE_CALLBACK( adaptationImageCB )
+    _Synchronizer::Stats getSynchronizerStats() const
     {
-//        std::cout << "Got new mask; waiting for lock..." << std::endl;
-        synced_callback_mutex_.lock();
-//        std::cout << "Got new mask; acquired lock" << std::endl;
-
-        //while( mask_queue_.size() >= 10 ) adaptation_mask_queue_.pop_front();
-        mask_queue_.push_back( image_msg );
+        return synchronizer_.getStats();
+    }
 
-//        PRINT_INFO( "%zu masks waiting to be processed.", mask_queue_.size() );
+    QUICKDEV_DECLARE_IMAGE_CALLBACK( imageCB )
+    {
+        if( disable_mask_ )
+        {
+            invokeCombinedImageCallback( image_msg, _CvImageMsgPtr() );
+            return;
+        }
 
-//        std::cout << "Got new mask; releasing lock" << std::endl;
-        synced_callback_mutex_.unlock();
+        addSyncedImage( _Synchronizer::FIRST, image_msg );
+    }
 
-        tryCallSyncedImagesCB();
+    QUICKDEV_DECLARE_IMAGE_CALLBACK( adaptationImageCB )
+    {
+        addSyncedImage( _Synchronizer::SECOND, image_msg );
     }
 };
 
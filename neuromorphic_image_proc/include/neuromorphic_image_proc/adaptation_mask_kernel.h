@@ -0,0 +1,223 @@
+/***************************************************************************
+ *  include/neuromorphic_image_proc/adaptation_mask_kernel.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef NEUROMORPHICIMAGEPROC_ADAPTATIONMASKKERNEL_H_
+#define NEUROMORPHICIMAGEPROC_ADAPTATIONMASKKERNEL_H_
+
+// objects
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#if defined( __SSSE3__ )
+#include <tmmintrin.h>
+#endif
+
+// =============================================================================================================================================
+//! Fused per-row update for AdaptationMaskNode
+/*!
+ * For each pixel, in a single pass:
+ * - value = 0.33 * ( |h - last_h| + |l - last_l| + |s - last_s| ) + time, saturated to 255, where time counts frames since the pixel was
+ *   last flagged (also saturated)
+ * - if value > threshold, the pixel is flagged: mask = 255, time = 0, and last_image takes the current value
+ * - otherwise mask = 0 and last_image is left alone
+ *
+ * The SSSE3 path processes 16 pixels at a time and produces exactly the same output as the scalar path.
+ */
+class AdaptationMaskKernel
+{
+public:
+    //! 0.33 in Q15, applied with rounding as in _mm_mulhrs_epi16
+    static int const DIFF_WEIGHT_Q15 = 10813;
+
+    static bool simdAvailable()
+    {
+#if defined( __SSSE3__ )
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /*! \param image current 3-channel row
+     *  \param last_image 3-channel row of last flagged values; updated in place
+     *  \param time frames since each pixel was last flagged; updated in place
+     *  \param mask output; 255 for flagged pixels, 0 otherwise */
+    static void processRow( uint8_t const * image, uint8_t * last_image, uint8_t * time, uint8_t * mask, size_t const & width, uint8_t const & threshold, bool const & enable_simd = true )
+    {
+        size_t x = 0;
+
+#if defined( __SSSE3__ )
+        if( enable_simd && threshold < 255 ) x = processSimd( image, last_image, time, mask, width, threshold );
+#endif
+
+        processScalar( image, last_image, time, mask, x, width, threshold );
+    }
+
+protected:
+    static void processScalar( uint8_t const * image, uint8_t * last_image, uint8_t * time, uint8_t * mask, size_t const & begin, size_t const & end, uint8_t const & threshold )
+    {
+        for( size_t x = begin; x < end; ++x )
+        {
+            uint8_t const * pixel = image + 3 * x;
+            uint8_t * last_pixel = last_image + 3 * x;
+
+            int const diff = abs( pixel[0] - last_pixel[0] ) + abs( pixel[1] - last_pixel[1] ) + abs( pixel[2] - last_pixel[2] );
+            int const weighted_diff = ( diff * DIFF_WEIGHT_Q15 + ( 1 << 14 ) ) >> 15;
+            int const pixel_time = time[x] < 255 ? time[x] + 1 : 255;
+            int const value = weighted_diff + pixel_time < 255 ? weighted_diff + pixel_time : 255;
+
+            if( value > threshold )
+            {
+                mask[x] = 255;
+                time[x] = 0;
+                last_pixel[0] = pixel[0];
+                last_pixel[1] = pixel[1];
+                last_pixel[2] = pixel[2];
+            }
+            else
+            {
+                mask[x] = 0;
+                time[x] = pixel_time;
+            }
+        }
+    }
+
+#if defined( __SSSE3__ )
+    //! Shuffle masks for converting between 16 interleaved 3-channel pixels (three vectors) and one vector per channel
+    struct ShuffleMasks
+    {
+        //! deinterleave_[channel][vector] picks the bytes of the given channel out of the given input vector
+        __m128i deinterleave_[3][3];
+        //! interleave_[vector] spreads a per-pixel mask over the three channels of the given output vector
+        __m128i interleave_[3];
+
+        ShuffleMasks()
+        {
+            for( int vector = 0; vector < 3; ++vector )
+            {
+                uint8_t bytes[16] __attribute__(( aligned( 16 ) ));
+
+                for( int channel = 0; channel < 3; ++channel )
+                {
+                    for( int pixel = 0; pixel < 16; ++pixel )
+                    {
+                        int const byte = 3 * pixel + channel;
+                        bytes[pixel] = byte / 16 == vector ? byte % 16 : 0x80;
+                    }
+                    deinterleave_[channel][vector] = _mm_load_si128( reinterpret_cast<__m128i const *>( bytes ) );
+                }
+
+                for( int byte = 0; byte < 16; ++byte )
+                {
+                    bytes[byte] = ( 16 * vector + byte ) / 3;
+                }
+                interleave_[vector] = _mm_load_si128( reinterpret_cast<__m128i const *>( bytes ) );
+            }
+        }
+    };
+
+    static ShuffleMasks const & getShuffleMasks()
+    {
+        static ShuffleMasks const shuffle_masks;
+        return shuffle_masks;
+    }
+
+    static __m128i absDiff( __m128i const & a, __m128i const & b )
+    {
+        return _mm_or_si128( _mm_subs_epu8( a, b ), _mm_subs_epu8( b, a ) );
+    }
+
+    //! Process as many whole blocks of 16 pixels as possible; returns the number of pixels processed
+    static size_t processSimd( uint8_t const * image, uint8_t * last_image, uint8_t * time, uint8_t * mask, size_t const & width, uint8_t const & threshold )
+    {
+        ShuffleMasks const & shuffle_masks = getShuffleMasks();
+
+        __m128i const zero = _mm_setzero_si128();
+        __m128i const one = _mm_set1_epi8( 1 );
+        __m128i const diff_weight = _mm_set1_epi16( DIFF_WEIGHT_Q15 );
+        // value > threshold <=> max( value, threshold + 1 ) == value
+        __m128i const min_flagged_value = _mm_set1_epi8( threshold + 1 );
+
+        size_t x = 0;
+        for( ; x + 16 <= width; x += 16 )
+        {
+            __m128i pixels[3];
+            __m128i last_pixels[3];
+            for( int i = 0; i < 3; ++i )
+            {
+                pixels[i] = _mm_loadu_si128( reinterpret_cast<__m128i const *>( image + 3 * x ) + i );
+                last_pixels[i] = _mm_loadu_si128( reinterpret_cast<__m128i const *>( last_image + 3 * x ) + i );
+            }
+
+            // per-byte absolute difference, then gather each channel into its own vector and sum the channels in 16 bits
+            __m128i diff_lo = zero;
+            __m128i diff_hi = zero;
+            for( int channel = 0; channel < 3; ++channel )
+            {
+                __m128i channel_diff = zero;
+                for( int i = 0; i < 3; ++i )
+                {
+                    channel_diff = _mm_or_si128( channel_diff, _mm_shuffle_epi8( absDiff( pixels[i], last_pixels[i] ), shuffle_masks.deinterleave_[channel][i] ) );
+                }
+
+                diff_lo = _mm_add_epi16( diff_lo, _mm_unpacklo_epi8( channel_diff, zero ) );
+                diff_hi = _mm_add_epi16( diff_hi, _mm_unpackhi_epi8( channel_diff, zero ) );
+            }
+
+            __m128i const weighted_diff = _mm_packus_epi16( _mm_mulhrs_epi16( diff_lo, diff_weight ), _mm_mulhrs_epi16( diff_hi, diff_weight ) );
+
+            __m128i const pixel_time = _mm_adds_epu8( _mm_loadu_si128( reinterpret_cast<__m128i const *>( time + x ) ), one );
+            __m128i const value = _mm_adds_epu8( weighted_diff, pixel_time );
+            __m128i const flagged = _mm_cmpeq_epi8( _mm_max_epu8( value, min_flagged_value ), value );
+
+            _mm_storeu_si128( reinterpret_cast<__m128i *>( mask + x ), flagged );
+            _mm_storeu_si128( reinterpret_cast<__m128i *>( time + x ), _mm_andnot_si128( flagged, pixel_time ) );
+
+            // take the current value for flagged pixels only
+            for( int i = 0; i < 3; ++i )
+            {
+                __m128i const flagged_bytes = _mm_shuffle_epi8( flagged, shuffle_masks.interleave_[i] );
+                __m128i const updated = _mm_or_si128( _mm_and_si128( flagged_bytes, pixels[i] ), _mm_andnot_si128( flagged_bytes, last_pixels[i] ) );
+                _mm_storeu_si128( reinterpret_cast<__m128i *>( last_image + 3 * x ) + i, updated );
+            }
+        }
+
+        return x;
+    }
+#endif
+};
+
+#endif // NEUROMORPHICIMAGEPROC_ADAPTATIONMASKKERNEL_H_
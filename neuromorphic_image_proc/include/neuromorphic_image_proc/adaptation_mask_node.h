@@ -43,6 +43,11 @@
 
 // objects
 #include <quickdev/feature.h>
+#include <neuromorphic_image_proc/hls_preprocessor.h>
+#include <neuromorphic_image_proc/adaptation_mask_kernel.h>
+#include <neuromorphic_image_proc/changed_tiles.h>
+#include <quickdev/multi_publisher.h>
+#include <quickdev/param_reader.h>
 
 typedef quickdev::ImageProcPolicy _ImageProcPolicy;
 
@@ -50,15 +55,27 @@ QUICKDEV_DECLARE_NODE( AdaptationMask, _ImageProcPolicy )
 
 QUICKDEV_DECLARE_NODE_CLASS( AdaptationMask )
 {
+    //! Value of each pixel when it was last flagged as changed
     cv::Mat last_image_;
-    cv::Mat adaptation_image_;
     cv::Mat high_values_mask_;
-    cv::Mat adaptation_mask_;
+    //! Frames since each pixel was last flagged as changed
     cv::Mat adaptation_time_image_;
-    cv::Mat adaptation_mask_image_;
     const static unsigned int threshold_ = 30;
 
-    QUICKDEV_DECLARE_NODE_CONSTRUCTOR( AdaptationMask )
+    HlsPreprocessor preprocessor_;
+    cv::Mat hsl_image_;
+
+    //! Per-tile summary of high_values_mask_, so consumers can skip unchanged regions without scanning the mask
+    ChangedTiles changed_tiles_;
+    int tile_size_;
+    //! If false, output_adaptation_mask carries only the header (an empty image), for consumers that match masks to images by stamp but
+    //! read the changes from changed_tiles
+    bool publish_full_mask_;
+
+    ros::MultiPublisher<> multi_pub_;
+
+    QUICKDEV_DECLARE_NODE_CONSTRUCTOR( AdaptationMask ),
+        preprocessor_( 1, 3, 0 )
     {
         //
     }
@@ -69,6 +86,12 @@ QUICKDEV_DECLARE_NODE_CLASS( AdaptationMask )
 
         _ImageProcPolicy::addImagePublisher( "output_adaptation_mask" );
 
+        QUICKDEV_GET_RUNABLE_NODEHANDLE( nh_rel );
+
+        tile_size_ = quickdev::ParamReader::readParam<int>( nh_rel, "tile_size", 16 );
+        publish_full_mask_ = quickdev::ParamReader::readParam<bool>( nh_rel, "publish_full_mask", true );
+        multi_pub_.addPublishers<_ChangedTilesMsg>( nh_rel, {"changed_tiles"} );
+
         initPolicies<quickdev::policy::ALL>();
     }
 
@@ -78,49 +101,72 @@ QUICKDEV_DECLARE_NODE_CLASS( AdaptationMask )
 
         cv::Mat const & image = image_msg->image;
         //cv::Mat lab_image;
-        cv::Mat hsl_image;
+        cv::Mat & hsl_image = hsl_image_;
         //cv::cvtColor( image, lab_image, CV_BGR2Lab );
-        cv::cvtColor( image, hsl_image, CV_BGR2HLS );
 
-        cv::GaussianBlur( hsl_image, hsl_image, cv::Size( 3, 3 ), 0 );
+        // blur and convert to HLS in one pass
+        preprocessor_.process( image, hsl_image );
 
         // convert our LAB image to float
         //cv::Mat lab_image_float;
         //lab_image.convertTo( lab_image_float, CV_32F );
 
-        // find the difference for each pixel (in time)
-        if( last_image_.empty() ) last_image_ = cv::Mat( hsl_image.rows, hsl_image.cols, CV_8UC3 );
-        cv::absdiff( hsl_image, last_image_, adaptation_image_ );
-
-        // flatten the image (sum the channels)
-        std::vector<cv::Mat> adaptation_images( 3 );
-        cv::split( adaptation_image_, adaptation_images );
-
-        if( adaptation_time_image_.empty() ) adaptation_time_image_ = cv::Mat( adaptation_mask_image_.rows, adaptation_mask_image_.cols, CV_8UC1 );
-        adaptation_time_image_ += 1;
-        adaptation_mask_image_ = adaptation_images[0] * 0.33 + adaptation_images[1] * 0.33 + adaptation_images[2] * 0.33 + adaptation_time_image_;
-
-        cv::threshold( adaptation_mask_image_, high_values_mask_, threshold_, 255, CV_THRESH_BINARY );
+        // (re)start from the current image; every pixel is reported as changed so downstream consumers do a full update
+        if( last_image_.size() != hsl_image.size() )
+        {
+            hsl_image.copyTo( last_image_ );
+            adaptation_time_image_ = cv::Mat::zeros( hsl_image.size(), CV_8UC1 );
+            high_values_mask_ = cv::Mat( hsl_image.size(), CV_8UC1, cv::Scalar( 255 ) );
+
+            changed_tiles_.reset( hsl_image.cols, hsl_image.rows, tile_size_ );
+            changed_tiles_.setAll();
+        }
+        else
+        {
+            changed_tiles_.reset( hsl_image.cols, hsl_image.rows, tile_size_ );
+
+            // find the difference for each pixel (in time), flatten it, add the time since each pixel last changed, threshold, and update
+            // last_image_ for the changed pixels, all in one pass
+            for( int y = 0; y < hsl_image.rows; ++y )
+            {
+                AdaptationMaskKernel::processRow
+                (
+                    hsl_image.ptr<uchar>( y ),
+                    last_image_.ptr<uchar>( y ),
+                    adaptation_time_image_.ptr<uchar>( y ),
+                    high_values_mask_.ptr<uchar>( y ),
+                    hsl_image.cols,
+                    uchar( threshold_ )
+                );
+
+                // the row is still in cache, so summarize it now
+                changed_tiles_.addMaskRow( y, high_values_mask_.ptr<uchar>( y ) );
+            }
+        }
 
         //cv::GaussianBlur( high_values_mask_, high_values_mask_, cv::Size( 3, 3 ), 0 );
         //cv::threshold( high_values_mask_, high_values_mask_, 127, 255, CV_THRESH_BINARY );
 
-        auto const now = ros::Time::now();
+        // outputs carry the stamp of the image they were computed from, so they can be matched back up with it downstream
+        auto const & header = image_msg->header;
 
         auto output_image_msg = quickdev::opencv_conversion::fromMat( hsl_image, "", "bgr8" );
-        output_image_msg->header.stamp = now;
+        output_image_msg->header = header;
+
+        auto output_adaptation_mask_msg = quickdev::opencv_conversion::fromMat( publish_full_mask_ ? high_values_mask_ : cv::Mat(), "", "mono8" );
+        output_adaptation_mask_msg->header = header;
 
-        auto output_adaptation_mask_msg = quickdev::opencv_conversion::fromMat( high_values_mask_, "", "mono8" );
-        output_adaptation_mask_msg->header.stamp = now;
+        _ChangedTilesMsg changed_tiles_msg;
+        changed_tiles_msg.header = header;
+        changed_tiles_.toMsg( changed_tiles_msg );
+
+        multi_pub_.publish( "changed_tiles", changed_tiles_msg );
 
         publishImages
         (
             "output_image", output_image_msg,
             "output_adaptation_mask", output_adaptation_mask_msg
         );
-
-        hsl_image.copyTo( last_image_, high_values_mask_ );
-        adaptation_time_image_.setTo( cv::Scalar( 0 ), high_values_mask_ );
     }
 
     QUICKDEV_SPIN_ONCE()
@@ -0,0 +1,245 @@
+/***************************************************************************
+ *  include/neuromorphic_image_proc/changed_tiles.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef NEUROMORPHICIMAGEPROC_CHANGEDTILES_H_
+#define NEUROMORPHICIMAGEPROC_CHANGEDTILES_H_
+
+// objects
+#include <algorithm>
+#include <vector>
+
+// msgs
+#include <seabee3_msgs/ChangedTiles.h>
+#include <sensor_msgs/RegionOfInterest.h>
+
+typedef seabee3_msgs::ChangedTiles _ChangedTilesMsg;
+typedef sensor_msgs::RegionOfInterest _RegionOfInterestMsg;
+
+// =============================================================================================================================================
+//! Coarse summary of a change mask: which tile_size x tile_size tiles contain at least one changed pixel
+/*!
+ * - Built one mask row at a time, so it can be filled in while the mask is being produced
+ * - Converts to and from _ChangedTilesMsg; consumers can test isChanged() per tile instead of scanning the full mask
+ */
+class ChangedTiles
+{
+protected:
+    size_t width_;
+    size_t height_;
+    size_t tile_size_;
+    size_t tiles_x_;
+    size_t tiles_y_;
+
+    //! One entry per tile, row-major; non-zero if changed
+    std::vector<uint8_t> changed_;
+
+public:
+    ChangedTiles()
+    :
+        width_( 0 ),
+        height_( 0 ),
+        tile_size_( 16 ),
+        tiles_x_( 0 ),
+        tiles_y_( 0 )
+    {
+        //
+    }
+
+    //! Set the mask size and tile size, and mark every tile as unchanged
+    void reset( size_t const & width, size_t const & height, size_t const & tile_size )
+    {
+        width_ = width;
+        height_ = height;
+        tile_size_ = std::max<size_t>( tile_size, 1 );
+        tiles_x_ = ( width_ + tile_size_ - 1 ) / tile_size_;
+        tiles_y_ = ( height_ + tile_size_ - 1 ) / tile_size_;
+
+        changed_.assign( tiles_x_ * tiles_y_, 0 );
+    }
+
+    void setAll()
+    {
+        std::fill( changed_.begin(), changed_.end(), 1 );
+    }
+
+    //! Mark the tiles touched by any non-zero pixel in row y of the mask
+    void addMaskRow( size_t const & y, uint8_t const * mask_row )
+    {
+        uint8_t * changed_row = &changed_[( y / tile_size_ ) * tiles_x_];
+
+        for( size_t tile_x = 0; tile_x < tiles_x_; ++tile_x )
+        {
+            // once a tile is marked, the rest of its pixels don't matter
+            if( changed_row[tile_x] ) continue;
+
+            size_t const x_end = std::min( ( tile_x + 1 ) * tile_size_, width_ );
+            for( size_t x = tile_x * tile_size_; x < x_end; ++x )
+            {
+                if( !mask_row[x] ) continue;
+
+                changed_row[tile_x] = 1;
+                break;
+            }
+        }
+    }
+
+    bool isChanged( size_t const & tile_x, size_t const & tile_y ) const
+    {
+        return changed_[tile_y * tiles_x_ + tile_x];
+    }
+
+    size_t getNumChanged() const
+    {
+        return std::count_if( changed_.begin(), changed_.end(), []( uint8_t const & changed ){ return changed != 0; } );
+    }
+
+    size_t getWidth() const
+    {
+        return width_;
+    }
+
+    size_t getHeight() const
+    {
+        return height_;
+    }
+
+    size_t getTileSize() const
+    {
+        return tile_size_;
+    }
+
+    size_t getTilesX() const
+    {
+        return tiles_x_;
+    }
+
+    size_t getTilesY() const
+    {
+        return tiles_y_;
+    }
+
+    //! Fill in everything but the header
+    void toMsg( _ChangedTilesMsg & msg ) const
+    {
+        msg.width = width_;
+        msg.height = height_;
+        msg.tile_size = tile_size_;
+        msg.tiles_x = tiles_x_;
+        msg.tiles_y = tiles_y_;
+        msg.num_changed_tiles = 0;
+
+        msg.bitmap.assign( ( changed_.size() + 7 ) / 8, 0 );
+        for( size_t i = 0; i < changed_.size(); ++i )
+        {
+            if( !changed_[i] ) continue;
+
+            msg.bitmap[i / 8] |= 1 << ( i % 8 );
+            ++msg.num_changed_tiles;
+        }
+
+        findRegions( msg.regions );
+    }
+
+    //! Restore from a message; returns false if the message is malformed
+    bool fromMsg( _ChangedTilesMsg const & msg )
+    {
+        reset( msg.width, msg.height, msg.tile_size );
+
+        if( msg.tiles_x != tiles_x_ || msg.tiles_y != tiles_y_ || msg.bitmap.size() != ( changed_.size() + 7 ) / 8 ) return false;
+
+        for( size_t i = 0; i < changed_.size(); ++i )
+        {
+            changed_[i] = ( msg.bitmap[i / 8] >> ( i % 8 ) ) & 1;
+        }
+
+        return true;
+    }
+
+protected:
+    //! Bounding boxes, in pixels, of 8-connected groups of changed tiles
+    void findRegions( std::vector<_RegionOfInterestMsg> & regions ) const
+    {
+        regions.clear();
+
+        std::vector<uint8_t> visited( changed_.size(), 0 );
+        std::vector<size_t> stack;
+
+        for( size_t start = 0; start < changed_.size(); ++start )
+        {
+            if( !changed_[start] || visited[start] ) continue;
+
+            size_t min_x = tiles_x_, min_y = tiles_y_, max_x = 0, max_y = 0;
+
+            visited[start] = 1;
+            stack.push_back( start );
+
+            while( !stack.empty() )
+            {
+                size_t const tile = stack.back();
+                stack.pop_back();
+
+                size_t const tile_x = tile % tiles_x_;
+                size_t const tile_y = tile / tiles_x_;
+
+                min_x = std::min( min_x, tile_x );
+                min_y = std::min( min_y, tile_y );
+                max_x = std::max( max_x, tile_x );
+                max_y = std::max( max_y, tile_y );
+
+                for( size_t neighbor_y = tile_y > 0 ? tile_y - 1 : 0; neighbor_y <= std::min( tile_y + 1, tiles_y_ - 1 ); ++neighbor_y )
+                {
+                    for( size_t neighbor_x = tile_x > 0 ? tile_x - 1 : 0; neighbor_x <= std::min( tile_x + 1, tiles_x_ - 1 ); ++neighbor_x )
+                    {
+                        size_t const neighbor = neighbor_y * tiles_x_ + neighbor_x;
+                        if( !changed_[neighbor] || visited[neighbor] ) continue;
+
+                        visited[neighbor] = 1;
+                        stack.push_back( neighbor );
+                    }
+                }
+            }
+
+            _RegionOfInterestMsg region;
+            region.x_offset = min_x * tile_size_;
+            region.y_offset = min_y * tile_size_;
+            region.width = std::min( ( max_x + 1 ) * tile_size_, width_ ) - region.x_offset;
+            region.height = std::min( ( max_y + 1 ) * tile_size_, height_ ) - region.y_offset;
+
+            regions.push_back( region );
+        }
+    }
+};
+
+#endif // NEUROMORPHICIMAGEPROC_CHANGEDTILES_H_
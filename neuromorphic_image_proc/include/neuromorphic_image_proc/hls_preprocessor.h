@@ -0,0 +1,199 @@
+/***************************************************************************
+ *  include/neuromorphic_image_proc/hls_preprocessor.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef NEUROMORPHICIMAGEPROC_HLSPREPROCESSOR_H_
+#define NEUROMORPHICIMAGEPROC_HLSPREPROCESSOR_H_
+
+// objects
+#include <opencv/cv.h>
+#include <algorithm>
+#include <vector>
+
+// =============================================================================================================================================
+//! Downscales, gaussian-blurs, and converts a bgr8 image to 8-bit HLS in a single pass over the source image
+/*! - Equivalent to cv::resize( 1 / downscale ) + cv::GaussianBlur() + cv::cvtColor( CV_BGR2HLS ), to within rounding
+ *  - Each output row is produced from a small ring of horizontally-blurred rows, so the working set stays in cache and there are no
+ *    full-frame intermediate images
+ *  - Downscaling is an integer box average, which matches cv::resize with INTER_LINEAR for a factor of 2
+ *  - All buffers, including the output, are reused across calls as long as the image size doesn't change */
+class HlsPreprocessor
+{
+protected:
+    int downscale_;
+    //! Normalized 1D gaussian kernel; the blur is applied separably with reflect-101 borders, as in cv::GaussianBlur
+    std::vector<float> kernel_;
+
+    //! Horizontally-blurred, downscaled rows; source row y lives in row y % kernel size
+    cv::Mat ring_;
+    std::vector<float> padded_row_;
+    std::vector<float> vertical_row_;
+    cv::Mat blurred_row_;
+
+public:
+    /*! \param downscale integer factor by which to shrink each dimension (1 for none)
+     *  \param blur_size gaussian kernel size; must be odd; 1 for none
+     *  \param blur_sigma gaussian sigma; if <= 0, computed from blur_size as in cv::getGaussianKernel */
+    HlsPreprocessor( int const & downscale = 1, int const & blur_size = 1, double const & blur_sigma = 0 )
+    {
+        configure( downscale, blur_size, blur_sigma );
+    }
+
+    void configure( int const & downscale, int const & blur_size, double const & blur_sigma )
+    {
+        downscale_ = std::max( downscale, 1 );
+
+        cv::Mat const kernel = cv::getGaussianKernel( std::max( blur_size | 1, 1 ), blur_sigma, CV_32F );
+        kernel_.assign( kernel.ptr<float>(), kernel.ptr<float>() + kernel.rows );
+    }
+
+    //! Process a bgr8 image into dst, an 8-bit HLS image of size src.size() / downscale (rounded down)
+    void process( cv::Mat const & src, cv::Mat & dst )
+    {
+        int const rows = src.rows / downscale_;
+        int const cols = src.cols / downscale_;
+
+        dst.create( rows, cols, CV_8UC3 );
+        if( rows == 0 || cols == 0 ) return;
+
+        int const kernel_size = kernel_.size();
+        int const radius = kernel_size / 2;
+        size_t const row_length = 3 * cols;
+
+        ring_.create( kernel_size, row_length, CV_32FC1 );
+        padded_row_.resize( 3 * ( cols + 2 * radius ) );
+        vertical_row_.resize( row_length );
+        blurred_row_.create( 1, cols, CV_8UC3 );
+
+        int next_row = 0;
+        for( int y = 0; y < rows; ++y )
+        {
+            // make sure every row under the kernel has been downscaled and blurred horizontally; reflected rows near the top and bottom
+            // edges are always within [y - radius, y + radius], so they're already in the ring
+            for( int const last_row = std::min( rows - 1, y + radius ); next_row <= last_row; ++next_row )
+            {
+                horizontalPass( src, next_row, cols, radius, ring_.ptr<float>( next_row % kernel_size ) );
+            }
+
+            std::fill( vertical_row_.begin(), vertical_row_.end(), 0.0f );
+            for( int k = 0; k < kernel_size; ++k )
+            {
+                float const weight = kernel_[k];
+                float const * ring_row = ring_.ptr<float>( cv::borderInterpolate( y + k - radius, rows, cv::BORDER_REFLECT_101 ) % kernel_size );
+
+                for( size_t i = 0; i < row_length; ++i )
+                {
+                    vertical_row_[i] += weight * ring_row[i];
+                }
+            }
+
+            uchar * blurred_row = blurred_row_.ptr<uchar>();
+            for( size_t i = 0; i < row_length; ++i )
+            {
+                blurred_row[i] = cv::saturate_cast<uchar>( vertical_row_[i] );
+            }
+
+            // dst_row has the right size and type, so cvtColor writes straight into dst
+            cv::Mat dst_row = dst.row( y );
+            cv::cvtColor( blurred_row_, dst_row, CV_BGR2HLS );
+        }
+    }
+
+protected:
+    //! Box-average the source pixels behind output row y into padded_row_, then blur horizontally into dst
+    void horizontalPass( cv::Mat const & src, int const & y, int const & cols, int const & radius, float * dst )
+    {
+        float * const padded = &padded_row_[3 * radius];
+
+        if( downscale_ == 1 )
+        {
+            uchar const * src_row = src.ptr<uchar>( y );
+            for( int i = 0; i < 3 * cols; ++i )
+            {
+                padded[i] = src_row[i];
+            }
+        }
+        else
+        {
+            std::fill( padded, padded + 3 * cols, 0.0f );
+
+            for( int dy = 0; dy < downscale_; ++dy )
+            {
+                uchar const * src_row = src.ptr<uchar>( y * downscale_ + dy );
+                for( int x = 0; x < cols; ++x )
+                {
+                    uchar const * src_pixel = src_row + 3 * x * downscale_;
+                    for( int dx = 0; dx < downscale_; ++dx, src_pixel += 3 )
+                    {
+                        padded[3 * x]     += src_pixel[0];
+                        padded[3 * x + 1] += src_pixel[1];
+                        padded[3 * x + 2] += src_pixel[2];
+                    }
+                }
+            }
+
+            float const scale = 1.0f / ( downscale_ * downscale_ );
+            for( int i = 0; i < 3 * cols; ++i )
+            {
+                padded[i] *= scale;
+            }
+        }
+
+        for( int i = 1; i <= radius; ++i )
+        {
+            int const left = cv::borderInterpolate( -i, cols, cv::BORDER_REFLECT_101 );
+            int const right = cv::borderInterpolate( cols - 1 + i, cols, cv::BORDER_REFLECT_101 );
+
+            for( int c = 0; c < 3; ++c )
+            {
+                padded[-3 * i + c] = padded[3 * left + c];
+                padded[3 * ( cols - 1 + i ) + c] = padded[3 * right + c];
+            }
+        }
+
+        int const kernel_size = kernel_.size();
+        for( int i = 0; i < 3 * cols; ++i )
+        {
+            float sum = 0;
+            float const * window = padded + i - 3 * radius;
+            for( int k = 0; k < kernel_size; ++k )
+            {
+                sum += kernel_[k] * window[3 * k];
+            }
+            dst[i] = sum;
+        }
+    }
+};
+
+#endif // NEUROMORPHICIMAGEPROC_HLSPREPROCESSOR_H_
@@ -0,0 +1,245 @@
+/***************************************************************************
+ *  include/neuromorphic_image_proc/stamp_synchronizer.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef NEUROMORPHICIMAGEPROC_STAMPSYNCHRONIZER_H_
+#define NEUROMORPHICIMAGEPROC_STAMPSYNCHRONIZER_H_
+
+// objects
+#include <ros/time.h>
+#include <algorithm>
+#include <iterator>
+#include <map>
+#include <mutex>
+
+// =============================================================================================================================================
+//! Pairs up items from two streams (ie images and masks) by timestamp, in bounded memory
+/*!
+ * - Unmatched items from each stream are kept in a map keyed by stamp, so each lookup is O(log capacity) regardless of run time
+ * - Each side holds at most capacity items; the oldest item is dropped to make room
+ * - Items more than max_age older than the newest stamp seen on either side are dropped
+ * - An item more than max_age older than the newest stamp means time went backwards (ie a bag looped or a sim reset); everything pending is
+ *   dropped and matching restarts from that item, rather than rejecting every item until the stream catches up with the old stamps
+ * - With a tolerance > 0, an item matches the closest item from the other stream within +/- tolerance; otherwise stamps must be equal
+ * - Only the bookkeeping is done under the internal mutex; callers act on the returned pair without holding it
+ */
+template<class __Item>
+class StampSynchronizer
+{
+public:
+    enum Side
+    {
+        FIRST = 0,
+        SECOND = 1
+    };
+
+    struct Stats
+    {
+        //! Items received, per side
+        size_t received_[2];
+        //! Pairs returned
+        size_t matched_;
+        //! Items dropped to stay within capacity, per side
+        size_t dropped_capacity_[2];
+        //! Items dropped for being older than max_age, per side
+        size_t dropped_age_[2];
+        //! Items replaced by a newer item with the same stamp on the same side
+        size_t dropped_duplicate_[2];
+        //! Items discarded when time went backwards, per side
+        size_t dropped_reset_[2];
+        //! Times time went backwards
+        size_t resets_;
+
+        Stats()
+        :
+            matched_( 0 ),
+            resets_( 0 )
+        {
+            for( size_t side = 0; side < 2; ++side )
+            {
+                received_[side] = 0;
+                dropped_capacity_[side] = 0;
+                dropped_age_[side] = 0;
+                dropped_duplicate_[side] = 0;
+                dropped_reset_[side] = 0;
+            }
+        }
+
+        size_t getDropped( size_t const & side ) const
+        {
+            return dropped_capacity_[side] + dropped_age_[side] + dropped_duplicate_[side] + dropped_reset_[side];
+        }
+    };
+
+protected:
+    typedef std::map<ros::Time, __Item> _ItemMap;
+
+    _ItemMap pending_[2];
+    ros::Time newest_stamp_;
+
+    size_t capacity_;
+    ros::Duration max_age_;
+    ros::Duration tolerance_;
+
+    Stats stats_;
+    mutable std::mutex mutex_;
+
+public:
+    StampSynchronizer( size_t const & capacity = 10, ros::Duration const & max_age = ros::Duration( 1.0 ), ros::Duration const & tolerance = ros::Duration( 0 ) )
+    :
+        capacity_( std::max<size_t>( capacity, 1 ) ),
+        max_age_( max_age ),
+        tolerance_( tolerance )
+    {
+        //
+    }
+
+    void configure( size_t const & capacity, ros::Duration const & max_age, ros::Duration const & tolerance )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        capacity_ = std::max<size_t>( capacity, 1 );
+        max_age_ = max_age;
+        tolerance_ = tolerance;
+    }
+
+    //! Add an item to the given side; if it completes a pair, store the pair in first and second and return true
+    bool add( Side const & side, ros::Time const & stamp, __Item const & item, __Item & first, __Item & second )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+
+        ++stats_.received_[side];
+
+        // time went backwards; nothing pending can match anything that follows
+        if( stamp + max_age_ < newest_stamp_ ) reset( stamp );
+
+        if( stamp > newest_stamp_ ) newest_stamp_ = stamp;
+        ageOut();
+
+        auto & other_pending = pending_[1 - side];
+        auto const match_it = findMatch( other_pending, stamp );
+
+        if( match_it != other_pending.end() )
+        {
+            first = side == FIRST ? item : match_it->second;
+            second = side == FIRST ? match_it->second : item;
+
+            other_pending.erase( match_it );
+            ++stats_.matched_;
+
+            return true;
+        }
+
+        auto & pending = pending_[side];
+
+        auto const insert_result = pending.insert( std::make_pair( stamp, item ) );
+        if( !insert_result.second )
+        {
+            insert_result.first->second = item;
+            ++stats_.dropped_duplicate_[side];
+        }
+
+        while( pending.size() > capacity_ )
+        {
+            pending.erase( pending.begin() );
+            ++stats_.dropped_capacity_[side];
+        }
+
+        return false;
+    }
+
+    Stats getStats() const
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        return stats_;
+    }
+
+    size_t getPendingSize( Side const & side ) const
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        return pending_[side].size();
+    }
+
+protected:
+    void reset( ros::Time const & stamp )
+    {
+        for( size_t side = 0; side < 2; ++side )
+        {
+            stats_.dropped_reset_[side] += pending_[side].size();
+            pending_[side].clear();
+        }
+
+        newest_stamp_ = stamp;
+        ++stats_.resets_;
+    }
+
+    void ageOut()
+    {
+        for( size_t side = 0; side < 2; ++side )
+        {
+            auto & pending = pending_[side];
+            while( !pending.empty() && pending.begin()->first + max_age_ < newest_stamp_ )
+            {
+                pending.erase( pending.begin() );
+                ++stats_.dropped_age_[side];
+            }
+        }
+    }
+
+    typename _ItemMap::iterator findMatch( _ItemMap & pending, ros::Time const & stamp )
+    {
+        if( tolerance_ <= ros::Duration( 0 ) ) return pending.find( stamp );
+
+        // the closest stamp is either the first one at or after stamp, or the one just before it
+        auto const after_it = pending.lower_bound( stamp );
+        auto best_it = pending.end();
+        ros::Duration best_distance = tolerance_;
+
+        if( after_it != pending.end() && after_it->first - stamp <= best_distance )
+        {
+            best_it = after_it;
+            best_distance = after_it->first - stamp;
+        }
+
+        if( after_it != pending.begin() )
+        {
+            auto const before_it = std::prev( after_it );
+            if( stamp - before_it->first <= best_distance ) best_it = before_it;
+        }
+
+        return best_it;
+    }
+};
+
+#endif // NEUROMORPHICIMAGEPROC_STAMPSYNCHRONIZER_H_
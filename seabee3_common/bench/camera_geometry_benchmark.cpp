@@ -0,0 +1,187 @@
+/***************************************************************************
+ *  bench/camera_geometry_benchmark.cpp
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+// Compares projecting landmark candidates to 3-D with a PinholeCameraModel (two projectPixelTo3dRay calls, acos and tan per candidate, and
+// a fromCameraInfo per CameraInfo message) against CameraGeometry's cached ray tables, and checks that both give the same positions.
+//
+// The model path repeats Landmark::projectTo3d( _PinholeCameraModel )'s math without its logging, so only the geometry is compared.
+//
+// usage: camera_geometry_benchmark [candidates] [iterations]
+
+#include <seabee3_common/recognition_primitives.h>
+#include <seabee3_common/camera_geometry.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+typedef std::chrono::high_resolution_clock _Clock;
+typedef sensor_msgs::CameraInfo _CameraInfoMsg;
+
+using namespace seabee;
+
+//! A 640x480 camera with a 500px focal length, like the front camera's calibration
+static _CameraInfoMsg makeCameraInfo()
+{
+    _CameraInfoMsg camera_info_msg;
+    camera_info_msg.width = 640;
+    camera_info_msg.height = 480;
+    camera_info_msg.D.resize( 5, 0.0 );
+
+    double const K[] = { 500, 0, 319.5, 0, 505, 239.5, 0, 0, 1 };
+    double const R[] = { 1, 0, 0, 0, 1, 0, 0, 0, 1 };
+    double const P[] = { 500, 0, 319.5, 0, 0, 505, 239.5, 0, 0, 0, 1, 0 };
+
+    std::copy( K, K + 9, camera_info_msg.K.begin() );
+    std::copy( R, R + 9, camera_info_msg.R.begin() );
+    std::copy( P, P + 12, camera_info_msg.P.begin() );
+
+    return camera_info_msg;
+}
+
+//! Landmark::projectTo3d( _PinholeCameraModel ), minus the logging
+static void projectWithModel( Landmark & landmark, _PinholeCameraModel const & camera_model )
+{
+    cv::Point2d const center_point( landmark.pose_.position_.x_, landmark.pose_.position_.y_ );
+    cv::Point3d const center_ray = camera_model.projectPixelTo3dRay( center_point );
+    btVector3 const center_unit_vec( center_ray.x, center_ray.y, center_ray.z );
+
+    auto const size_meters = landmark.getIdealSize();
+    auto const size_pixels = landmark.size_;
+
+    double const radius_meters = quickdev::min( size_meters.x_, size_meters.y_ ) / 2.0;
+    double const radius_pixels = quickdev::min( size_pixels.x_, size_pixels.y_ ) / 2.0;
+
+    cv::Point2d const radius_point( landmark.pose_.position_.x_ + radius_pixels, landmark.pose_.position_.y_ );
+    cv::Point3d const radius_ray = camera_model.projectPixelTo3dRay( radius_point );
+    btVector3 const radius_unit_vec( radius_ray.x, radius_ray.y, radius_ray.z );
+
+    double const distance = radius_meters / tan( center_unit_vec.angle( radius_unit_vec ) );
+    btVector3 const center_vec = center_unit_vec * distance;
+
+    landmark.pose_.position_.x_ = center_vec.getZ();
+    landmark.pose_.position_.y_ = -center_vec.getX();
+    landmark.pose_.position_.z_ = -center_vec.getY();
+    landmark.size_ = size_meters;
+}
+
+template<class __Func>
+double timeUs( __Func const & func, size_t const & iterations )
+{
+    auto const start = _Clock::now();
+    for( size_t i = 0; i < iterations; ++i )
+    {
+        func();
+    }
+    auto const end = _Clock::now();
+
+    return std::chrono::duration_cast<std::chrono::nanoseconds>( end - start ).count() / ( 1000.0 * iterations );
+}
+
+int main( int argc, char ** argv )
+{
+    size_t const num_candidates = argc > 1 ? atoi( argv[1] ) : 500;
+    size_t const iterations = argc > 2 ? atoi( argv[2] ) : 1000;
+
+    _CameraInfoMsg const camera_info_msg = makeCameraInfo();
+
+    // random buoy-sized blobs anywhere in the image
+    srand( 0 );
+    std::vector<Landmark> candidates;
+    candidates.reserve( num_candidates );
+    for( size_t candidate_idx = 0; candidate_idx < num_candidates; ++candidate_idx )
+    {
+        double const u = rand() % 6400 / 10.0;
+        double const v = rand() % 4800 / 10.0;
+        double const diameter = 5 + rand() % 1500 / 10.0;
+        candidates.push_back( Buoy( Pose( Position( u, v ) ), Color( Color::ORANGE ), Size( diameter * 0.9, diameter ) ) );
+    }
+
+    std::vector<Landmark> model_results( candidates );
+    std::vector<Landmark> geometry_results( candidates );
+
+    // one CameraInfo per frame, as the finders receive them
+    _PinholeCameraModel camera_model;
+    auto project_model = [&]()
+    {
+        camera_model.fromCameraInfo( camera_info_msg );
+        for( size_t candidate_idx = 0; candidate_idx < num_candidates; ++candidate_idx )
+        {
+            model_results[candidate_idx] = candidates[candidate_idx];
+            projectWithModel( model_results[candidate_idx], camera_model );
+        }
+    };
+
+    CameraGeometry camera_geometry;
+    camera_geometry.fromCameraInfo( camera_info_msg );
+    auto project_geometry = [&]()
+    {
+        camera_geometry.fromCameraInfo( camera_info_msg );
+        for( size_t candidate_idx = 0; candidate_idx < num_candidates; ++candidate_idx )
+        {
+            geometry_results[candidate_idx] = candidates[candidate_idx];
+            geometry_results[candidate_idx].projectTo3d( camera_geometry );
+        }
+    };
+
+    double const model_us = timeUs( project_model, iterations );
+    double const geometry_us = timeUs( project_geometry, iterations );
+
+    double max_error = 0;
+    for( size_t candidate_idx = 0; candidate_idx < num_candidates; ++candidate_idx )
+    {
+        auto const & expected = model_results[candidate_idx].pose_.position_;
+        auto const & actual = geometry_results[candidate_idx].pose_.position_;
+        double const error = std::max( fabs( expected.x_ - actual.x_ ), std::max( fabs( expected.y_ - actual.y_ ), fabs( expected.z_ - actual.z_ ) ) );
+        // relative to distance, since far-away candidates have large absolute positions
+        max_error = std::max( max_error, error / std::max( 1.0, fabs( expected.x_ ) ) );
+    }
+
+    printf( "%zu candidates, %zu iterations\n", num_candidates, iterations );
+    printf( "%24s %14s %14s\n", "method", "us / frame", "ns / candidate" );
+    printf( "%24s %14.1f %14.1f\n", "camera model", model_us, 1000 * model_us / num_candidates );
+    printf( "%24s %14.1f %14.1f\n", "camera geometry", geometry_us, 1000 * geometry_us / num_candidates );
+    printf( "speedup: %.2fx, max relative position error: %g\n", model_us / geometry_us, max_error );
+
+    if( max_error > 1e-4 )
+    {
+        printf( "camera geometry disagrees with the camera model\n" );
+        return 1;
+    }
+
+    return 0;
+}
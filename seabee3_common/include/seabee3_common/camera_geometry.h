@@ -0,0 +1,201 @@
+/***************************************************************************
+ *  include/seabee3_common/camera_geometry.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef SEABEE3COMMON_CAMERAGEOMETRY_H_
+#define SEABEE3COMMON_CAMERAGEOMETRY_H_
+
+// objects
+#include <image_geometry/pinhole_camera_model.h>
+#include <vector>
+
+// utils
+#include <math.h>
+
+// msgs
+#include <sensor_msgs/CameraInfo.h>
+
+namespace seabee
+{
+
+// =============================================================================================================================================
+//! A camera model plus lookup tables for turning (rectified) pixels into rays and pixel sizes into distances
+/*!
+ * - The pinhole ray through pixel ( u, v ) is ( x( u ), y( v ), 1 ): its x component depends only on the column and its y component only
+ *   on the row, so one table per axis holds the whole rectified ray field
+ * - Tables are sampled from the camera model itself at each integer pixel; since the ray mapping is affine, interpolating between entries
+ *   is exact, and so is extrapolating past the edges (the row scales aren't affine, but interpolate to within ~1e-6 inside the image)
+ * - fromCameraInfo() only rebuilds anything when the calibration actually changed, so it's cheap to call on every CameraInfo message
+ */
+class CameraGeometry
+{
+public:
+    typedef image_geometry::PinholeCameraModel _PinholeCameraModel;
+    typedef sensor_msgs::CameraInfo _CameraInfoMsg;
+
+protected:
+    _PinholeCameraModel camera_model_;
+    _CameraInfoMsg camera_info_msg_;
+    bool initialized_;
+
+    //! x component of the ray through each column
+    std::vector<double> column_rays_;
+    //! y component of the ray through each row
+    std::vector<double> row_rays_;
+    //! sqrt( 1 + y^2 ) for each row; the length of the row's ray projected onto the y-z plane
+    std::vector<double> row_scales_;
+
+public:
+    CameraGeometry()
+    :
+        initialized_( false )
+    {
+        //
+    }
+
+    bool initialized() const
+    {
+        return initialized_;
+    }
+
+    _PinholeCameraModel const & getCameraModel() const
+    {
+        return camera_model_;
+    }
+
+    //! True if camera_info_msg describes the same calibration we're already using
+    bool matches( _CameraInfoMsg const & camera_info_msg ) const
+    {
+        return initialized_
+            && camera_info_msg.width == camera_info_msg_.width
+            && camera_info_msg.height == camera_info_msg_.height
+            && camera_info_msg.binning_x == camera_info_msg_.binning_x
+            && camera_info_msg.binning_y == camera_info_msg_.binning_y
+            && camera_info_msg.roi.x_offset == camera_info_msg_.roi.x_offset
+            && camera_info_msg.roi.y_offset == camera_info_msg_.roi.y_offset
+            && camera_info_msg.roi.width == camera_info_msg_.roi.width
+            && camera_info_msg.roi.height == camera_info_msg_.roi.height
+            && camera_info_msg.roi.do_rectify == camera_info_msg_.roi.do_rectify
+            && camera_info_msg.K == camera_info_msg_.K
+            && camera_info_msg.R == camera_info_msg_.R
+            && camera_info_msg.P == camera_info_msg_.P
+            && camera_info_msg.D == camera_info_msg_.D;
+    }
+
+    //! Update the model and rebuild the tables, unless the calibration is unchanged
+    /*! \return true if anything was rebuilt */
+    bool fromCameraInfo( _CameraInfoMsg const & camera_info_msg )
+    {
+        if( matches( camera_info_msg ) ) return false;
+
+        camera_info_msg_ = camera_info_msg;
+        camera_model_.fromCameraInfo( camera_info_msg );
+
+        // one extra entry so the far edge of the last pixel is in the table
+        column_rays_.resize( camera_info_msg.width + 1 );
+        row_rays_.resize( camera_info_msg.height + 1 );
+        row_scales_.resize( camera_info_msg.height + 1 );
+
+        for( size_t column = 0; column < column_rays_.size(); ++column )
+        {
+            column_rays_[column] = camera_model_.projectPixelTo3dRay( cv::Point2d( column, 0 ) ).x;
+        }
+
+        for( size_t row = 0; row < row_rays_.size(); ++row )
+        {
+            double const ray_y = camera_model_.projectPixelTo3dRay( cv::Point2d( 0, row ) ).y;
+            row_rays_[row] = ray_y;
+            row_scales_[row] = sqrt( 1 + ray_y * ray_y );
+        }
+
+        initialized_ = !column_rays_.empty() && !row_rays_.empty();
+
+        return true;
+    }
+
+protected:
+    //! Linearly interpolate table at (possibly fractional, possibly out-of-range) index
+    static double lookup( std::vector<double> const & table, double const & index )
+    {
+        if( table.size() < 2 ) return table.empty() ? 0 : table.front();
+
+        long const last = table.size() - 2;
+        long base = long( floor( index ) );
+        if( base < 0 ) base = 0;
+        else if( base > last ) base = last;
+
+        return table[base] + ( index - base ) * ( table[base + 1] - table[base] );
+    }
+
+public:
+    double getRayX( double const & u ) const
+    {
+        return lookup( column_rays_, u );
+    }
+
+    double getRayY( double const & v ) const
+    {
+        return lookup( row_rays_, v );
+    }
+
+    double getRowScale( double const & v ) const
+    {
+        // the row scales aren't affine, so don't extrapolate them
+        if( v < 0 || v > double( row_scales_.size() ) - 1 )
+        {
+            double const ray_y = getRayY( v );
+            return sqrt( 1 + ray_y * ray_y );
+        }
+
+        return lookup( row_scales_, v );
+    }
+
+    //! Distance along the optical axis to an object centered at ( u, v ) whose radius_pixels-wide (horizontal) radius is radius_meters
+    /*! Equivalent to taking the angle between the rays to ( u, v ) and ( u + radius_pixels, v ), then dividing radius_meters by its tangent;
+        since both rays are in the same row, tan( angle ) = |x1 - x0| * rowscale( v ) / ( x0 * x1 + rowscale( v )^2 ), with no trig needed */
+    double getDepth( double const & u, double const & v, double const & radius_pixels, double const & radius_meters ) const
+    {
+        double const center_x = getRayX( u );
+        double const radius_x = getRayX( u + radius_pixels );
+        double const ray_y = getRayY( v );
+
+        double const tan_angle = fabs( radius_x - center_x ) * getRowScale( v ) / ( center_x * radius_x + ray_y * ray_y + 1 );
+
+        return radius_meters / tan_angle;
+    }
+};
+
+} // seabee
+
+#endif // SEABEE3COMMON_CAMERAGEOMETRY_H_
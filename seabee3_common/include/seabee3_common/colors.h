@@ -80,6 +80,16 @@ public:
         else color_ = BLACK;
     }
 
+    bool operator==( Color const & other ) const
+    {
+        return color_ == other.color_;
+    }
+
+    bool operator!=( Color const & other ) const
+    {
+        return color_ != other.color_;
+    }
+
     operator std::string() const
     {
         switch( color_ )
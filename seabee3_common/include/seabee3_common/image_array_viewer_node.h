@@ -41,10 +41,15 @@
 // policies
 #include <quickdev/image_proc_policy.h>
 
+// utils
+#include <seabee3_common/colors.h>
+#include <seabee3_common/label_map.h>
+
 // msgs
 #include <seabee3_msgs/NamedImageArray.h>
 
 typedef seabee3_msgs::NamedImageArray _NamedImageArrayMsg;
+typedef seabee::_LabelMapMsg _LabelMapMsg;
 
 QUICKDEV_DECLARE_NODE( ImageArrayViewer )
 
@@ -64,6 +69,7 @@ QUICKDEV_DECLARE_NODE_CLASS( ImageArrayViewer )
         QUICKDEV_GET_RUNABLE_NODEHANDLE( nh_rel );
 
         multi_sub_.addSubscriber( nh_rel, "images", &ImageArrayViewerNode::imagesCB, this );
+        multi_sub_.addSubscriber( nh_rel, "label_map", &ImageArrayViewerNode::labelMapCB, this );
     }
 
     QUICKDEV_DECLARE_MESSAGE_CALLBACK( imagesCB, _NamedImageArrayMsg )
@@ -83,6 +89,49 @@ QUICKDEV_DECLARE_NODE_CLASS( ImageArrayViewer )
         cvWaitKey( 20 );
     }
 
+    // draw each labeled pixel in its color, scaled by its confidence; unlabeled pixels are drawn in dark gray
+    QUICKDEV_DECLARE_MESSAGE_CALLBACK( labelMapCB, _LabelMapMsg )
+    {
+        cv::Mat labels;
+        cv::Mat confidence;
+
+        if( !seabee::decodeLabelMap( *msg, labels, confidence ) )
+        {
+            PRINT_WARN( "Dropping malformed label map" );
+            return;
+        }
+
+        // note: bgr
+        std::vector<cv::Vec3b> palette( 256, cv::Vec3b( 64, 64, 64 ) );
+        for( size_t label = 0; label < msg->color_names.size() && label < _LabelMapMsg::LABEL_NONE; ++label )
+        {
+            seabee::_ColorRGBAMsg const color = seabee::Color( msg->color_names[label] );
+            palette[label] = cv::Vec3b( 255 * color.b, 255 * color.g, 255 * color.r );
+        }
+
+        cv::Mat image( labels.size(), CV_8UC3 );
+        for( int y = 0; y < labels.rows; ++y )
+        {
+            uchar const * labels_row = labels.ptr<uchar>( y );
+            uchar const * confidence_row = confidence.ptr<uchar>( y );
+            cv::Vec3b * image_row = image.ptr<cv::Vec3b>( y );
+
+            for( int x = 0; x < labels.cols; ++x )
+            {
+                auto const & color = palette[labels_row[x]];
+                if( labels_row[x] == _LabelMapMsg::LABEL_NONE ) image_row[x] = color;
+                else image_row[x] = cv::Vec3b( color[0] * confidence_row[x] / 255, color[1] * confidence_row[x] / 255, color[2] * confidence_row[x] / 255 );
+            }
+        }
+
+        PRINT_INFO( "Got label map %ux%u with %zu colors", msg->width, msg->height, msg->color_names.size() );
+
+        cv::namedWindow( "label_map", 0 );
+        cv::imshow( "label_map", image );
+
+        cvWaitKey( 20 );
+    }
+
     QUICKDEV_SPIN_ONCE()
     {
         //
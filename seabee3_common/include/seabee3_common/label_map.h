@@ -0,0 +1,152 @@
+/***************************************************************************
+ *  include/seabee3_common/label_map.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef SEABEE3COMMON_LABELMAP_H_
+#define SEABEE3COMMON_LABELMAP_H_
+
+// objects
+#include <opencv/cv.h>
+#include <string.h>
+
+// msgs
+#include <seabee3_msgs/LabelMap.h>
+
+namespace seabee
+{
+
+typedef seabee3_msgs::LabelMap _LabelMapMsg;
+
+//! Pack a mono8 label image (and, for ENCODING_RAW, its mono8 confidence image) into the given message; header, color_names, and scale are left to the caller
+inline void encodeLabelMap( cv::Mat const & labels, cv::Mat const & confidence, bool const & run_length_encode, _LabelMapMsg & label_map_msg )
+{
+    label_map_msg.width = labels.cols;
+    label_map_msg.height = labels.rows;
+    label_map_msg.labels.clear();
+    label_map_msg.confidence.clear();
+    label_map_msg.run_lengths.clear();
+
+    if( run_length_encode )
+    {
+        label_map_msg.encoding = _LabelMapMsg::ENCODING_RLE;
+
+        // runs continue across row boundaries; the decoder only needs the total pixel count to match
+        uchar current_label = 0;
+        uint32_t current_length = 0;
+
+        for( int y = 0; y < labels.rows; ++y )
+        {
+            uchar const * labels_row = labels.ptr<uchar>( y );
+            for( int x = 0; x < labels.cols; ++x )
+            {
+                if( current_length > 0 && labels_row[x] == current_label )
+                {
+                    ++current_length;
+                    continue;
+                }
+
+                if( current_length > 0 )
+                {
+                    label_map_msg.labels.push_back( current_label );
+                    label_map_msg.run_lengths.push_back( current_length );
+                }
+
+                current_label = labels_row[x];
+                current_length = 1;
+            }
+        }
+
+        if( current_length > 0 )
+        {
+            label_map_msg.labels.push_back( current_label );
+            label_map_msg.run_lengths.push_back( current_length );
+        }
+
+        return;
+    }
+
+    label_map_msg.encoding = _LabelMapMsg::ENCODING_RAW;
+    label_map_msg.labels.resize( labels.total() );
+    label_map_msg.confidence.resize( labels.total() );
+
+    for( int y = 0; y < labels.rows; ++y )
+    {
+        memcpy( &label_map_msg.labels[y * labels.cols], labels.ptr<uchar>( y ), labels.cols );
+        memcpy( &label_map_msg.confidence[y * labels.cols], confidence.ptr<uchar>( y ), labels.cols );
+    }
+}
+
+//! Unpack a label map message into mono8 label and confidence images; for ENCODING_RLE, confidence is 255 for labeled pixels and 0 otherwise
+/*! \return false if the message is malformed */
+inline bool decodeLabelMap( _LabelMapMsg const & label_map_msg, cv::Mat & labels, cv::Mat & confidence )
+{
+    size_t const num_pixels = size_t( label_map_msg.width ) * label_map_msg.height;
+
+    labels.create( label_map_msg.height, label_map_msg.width, CV_8UC1 );
+    confidence.create( label_map_msg.height, label_map_msg.width, CV_8UC1 );
+
+    if( label_map_msg.encoding == _LabelMapMsg::ENCODING_RAW )
+    {
+        if( label_map_msg.labels.size() != num_pixels || label_map_msg.confidence.size() != num_pixels ) return false;
+
+        if( num_pixels > 0 )
+        {
+            memcpy( labels.data, &label_map_msg.labels[0], num_pixels );
+            memcpy( confidence.data, &label_map_msg.confidence[0], num_pixels );
+        }
+
+        return true;
+    }
+
+    if( label_map_msg.encoding != _LabelMapMsg::ENCODING_RLE || label_map_msg.labels.size() != label_map_msg.run_lengths.size() ) return false;
+
+    size_t pixel_idx = 0;
+    for( size_t run_idx = 0; run_idx < label_map_msg.run_lengths.size(); ++run_idx )
+    {
+        size_t const run_length = label_map_msg.run_lengths[run_idx];
+        if( pixel_idx + run_length > num_pixels ) return false;
+
+        uchar const label = label_map_msg.labels[run_idx];
+        memset( labels.data + pixel_idx, label, run_length );
+        memset( confidence.data + pixel_idx, label == _LabelMapMsg::LABEL_NONE ? 0 : 255, run_length );
+
+        pixel_idx += run_length;
+    }
+
+    return pixel_idx == num_pixels;
+}
+
+} // seabee
+
+#endif // SEABEE3COMMON_LABELMAP_H_
@@ -0,0 +1,285 @@
+/***************************************************************************
+ *  seabee3_common/include/seabee3_common/message_worker.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef SEABEE3COMMON_MESSAGEWORKER_H_
+#define SEABEE3COMMON_MESSAGEWORKER_H_
+
+// objects
+#include <ros/time.h>
+#include <boost/thread.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <deque>
+#include <string>
+#include <stdio.h>
+
+namespace seabee
+{
+
+// =============================================================================================================================================
+//! A mailbox of the most recent messages and a thread that processes them, for callbacks that are too slow to run on the ROS callback thread
+/*!
+ * - post() never blocks on processing; with depth 1 a new message replaces one that hasn't been picked up yet, otherwise the oldest queued
+ *   message is dropped to make room
+ * - The worker waits on a predicate, so a message posted while it's busy is picked up as soon as it's done; wakeups are never lost
+ * - Messages are processed one at a time, in the order they were posted
+ * - Stopping (or destroying) the worker joins its thread; any messages still queued are discarded
+ */
+template<class __Message>
+class MessageWorker : boost::noncopyable
+{
+public:
+    typedef std::function<void( __Message const & )> _ProcessFunc;
+
+    //! Bin i counts latencies in [2^i, 2^(i+1)) microseconds; the first bin also counts anything faster and the last anything slower
+    static size_t const NUM_LATENCY_BINS = 21;
+
+    struct Stats
+    {
+        size_t posted_;
+        size_t processed_;
+        //! Messages replaced by a newer one before the worker picked them up (depth 1)
+        size_t overwritten_;
+        //! Messages evicted from a full queue (depth > 1), or posted while the worker was stopped
+        size_t dropped_;
+        //! Time from post() to the start of processing
+        size_t latency_histogram_[NUM_LATENCY_BINS];
+
+        Stats()
+        :
+            posted_( 0 ),
+            processed_( 0 ),
+            overwritten_( 0 ),
+            dropped_( 0 )
+        {
+            for( size_t bin = 0; bin < NUM_LATENCY_BINS; ++bin )
+            {
+                latency_histogram_[bin] = 0;
+            }
+        }
+
+        static size_t getLatencyBin( double const & seconds )
+        {
+            size_t bin = 0;
+            for( double bound = 2e-6; bin + 1 < NUM_LATENCY_BINS && seconds >= bound; bound *= 2 ) ++bin;
+            return bin;
+        }
+
+        //! Upper bound of the given bin, in seconds
+        static double getLatencyBinBound( size_t const & bin )
+        {
+            return ( size_t( 2 ) << bin ) * 1e-6;
+        }
+
+        //! Upper bound, in seconds, of the bin containing the given fraction of the recorded latencies
+        double getLatencyPercentile( double const & fraction ) const
+        {
+            size_t total = 0;
+            for( size_t bin = 0; bin < NUM_LATENCY_BINS; ++bin )
+            {
+                total += latency_histogram_[bin];
+            }
+
+            size_t const target = fraction * total;
+            size_t count = 0;
+            for( size_t bin = 0; bin < NUM_LATENCY_BINS; ++bin )
+            {
+                count += latency_histogram_[bin];
+                if( count > target ) return getLatencyBinBound( bin );
+            }
+            return getLatencyBinBound( NUM_LATENCY_BINS - 1 );
+        }
+
+        std::string toString() const
+        {
+            char buffer[256];
+            snprintf
+            (
+                buffer,
+                sizeof( buffer ),
+                "%zu posted, %zu processed, %zu overwritten, %zu dropped; wake-to-process latency p50 < %.3f ms, p99 < %.3f ms",
+                posted_,
+                processed_,
+                overwritten_,
+                dropped_,
+                1000 * getLatencyPercentile( 0.5 ),
+                1000 * getLatencyPercentile( 0.99 )
+            );
+            return buffer;
+        }
+    };
+
+protected:
+    struct Entry
+    {
+        __Message message_;
+        ros::WallTime posted_;
+    };
+
+    std::deque<Entry> queue_;
+    size_t depth_;
+    bool running_;
+
+    _ProcessFunc process_func_;
+    boost::shared_ptr<boost::thread> thread_ptr_;
+
+    Stats stats_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+
+public:
+    MessageWorker( size_t const & depth = 1 )
+    :
+        depth_( std::max<size_t>( depth, 1 ) ),
+        running_( false )
+    {
+        //
+    }
+
+    ~MessageWorker()
+    {
+        stop();
+    }
+
+    //! Start a thread that calls process_func on each posted message
+    void start( _ProcessFunc const & process_func )
+    {
+        stop();
+
+        {
+            std::lock_guard<std::mutex> lock( mutex_ );
+            process_func_ = process_func;
+            running_ = true;
+        }
+
+        thread_ptr_ = boost::make_shared<boost::thread>( &MessageWorker::workerLoop, this );
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock( mutex_ );
+            if( !running_ ) return;
+            running_ = false;
+            queue_.clear();
+        }
+        condition_.notify_all();
+
+        if( thread_ptr_ && thread_ptr_->get_id() != boost::this_thread::get_id() ) thread_ptr_->join();
+        thread_ptr_.reset();
+    }
+
+    void setDepth( size_t const & depth )
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        depth_ = std::max<size_t>( depth, 1 );
+
+        while( queue_.size() > depth_ )
+        {
+            queue_.pop_front();
+            ++stats_.dropped_;
+        }
+    }
+
+    //! Queue a message for processing; returns false if this displaced an older message (or the worker isn't running)
+    bool post( __Message const & message )
+    {
+        bool displaced = false;
+
+        {
+            std::lock_guard<std::mutex> lock( mutex_ );
+            ++stats_.posted_;
+
+            if( !running_ )
+            {
+                ++stats_.dropped_;
+                return false;
+            }
+
+            if( queue_.size() >= depth_ )
+            {
+                queue_.pop_front();
+                if( depth_ == 1 ) ++stats_.overwritten_;
+                else ++stats_.dropped_;
+                displaced = true;
+            }
+
+            Entry entry;
+            entry.message_ = message;
+            entry.posted_ = ros::WallTime::now();
+            queue_.push_back( entry );
+        }
+
+        condition_.notify_one();
+        return !displaced;
+    }
+
+    Stats getStats() const
+    {
+        std::lock_guard<std::mutex> lock( mutex_ );
+        return stats_;
+    }
+
+protected:
+    void workerLoop()
+    {
+        std::unique_lock<std::mutex> lock( mutex_ );
+        while( true )
+        {
+            condition_.wait( lock, [this](){ return !running_ || !queue_.empty(); } );
+            if( !running_ ) return;
+
+            Entry entry = queue_.front();
+            queue_.pop_front();
+
+            ++stats_.latency_histogram_[Stats::getLatencyBin( ( ros::WallTime::now() - entry.posted_ ).toSec() )];
+
+            lock.unlock();
+            process_func_( entry.message_ );
+            lock.lock();
+
+            ++stats_.processed_;
+        }
+    }
+};
+
+} // seabee
+
+#endif // SEABEE3COMMON_MESSAGEWORKER_H_
@@ -42,6 +42,7 @@
 #include <seabee3_common/colors.h>
 #include <seabee3_common/motion_primitives.h>
 #include <image_geometry/pinhole_camera_model.h>
+#include <seabee3_common/camera_geometry.h>
 
 // utils
 #include <quickdev/math.h>
@@ -297,6 +298,29 @@ public:
 
         size_ = size_meters;
     }
+
+    //! Same result as projectTo3d( _PinholeCameraModel ), but using camera_geometry's cached ray tables; a few table reads, no trig
+    void projectTo3d( CameraGeometry const & camera_geometry )
+    {
+        double const center_u = pose_.position_.x_;
+        double const center_v = pose_.position_.y_;
+
+        auto const size_meters = getIdealSize();
+        // we always use the max length as a diameter
+        auto const size_pixels = size_;
+
+        double const radius_meters = quickdev::min( size_meters.x_, size_meters.y_ ) / 2.0;
+        double const radius_pixels = quickdev::min( size_pixels.x_, size_pixels.y_ ) / 2.0;
+
+        double const distance = camera_geometry.getDepth( center_u, center_v, radius_pixels, radius_meters );
+
+        // project the center ray ( x, y, 1 ) out to the distance calculated
+        pose_.position_.x_ = distance;
+        pose_.position_.y_ = -camera_geometry.getRayX( center_u ) * distance;
+        pose_.position_.z_ = -camera_geometry.getRayY( center_v ) * distance;
+
+        size_ = size_meters;
+    }
 };
 
 // =============================================================================================================================================
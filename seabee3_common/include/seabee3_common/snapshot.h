@@ -0,0 +1,102 @@
+/***************************************************************************
+ *  include/seabee3_common/snapshot.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef SEABEE3COMMON_SNAPSHOT_H_
+#define SEABEE3COMMON_SNAPSHOT_H_
+
+// objects
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <mutex>
+
+namespace seabee
+{
+
+// =============================================================================================================================================
+//! Holds an immutable copy of some shared state (read-copy-update)
+/*!
+ * - Readers call get() once per unit of work and use the returned copy for as long as they like; it never changes underneath them
+ * - Writers call update(), which copies the current state, modifies the copy, and publishes it with a single atomic pointer swap
+ * - Readers never wait on writers: get() only uses boost's atomic shared_ptr load, never the update mutex
+ * - Old copies are freed automatically when the last reader holding them lets go
+ */
+template<class __Data>
+class Snapshot : boost::noncopyable
+{
+public:
+    typedef __Data _Data;
+    typedef boost::shared_ptr<_Data const> _DataPtr;
+
+protected:
+    _DataPtr data_ptr_;
+
+    //! Serializes writers so that concurrent updates don't overwrite each other's changes
+    std::mutex update_mutex_;
+
+public:
+    Snapshot()
+    :
+        data_ptr_( boost::make_shared<_Data>() )
+    {
+        //
+    }
+
+    //! Get the current copy of the data; never blocks on update()
+    _DataPtr get() const
+    {
+        return boost::atomic_load( &data_ptr_ );
+    }
+
+    //! Copy the current data, apply func to the copy, and publish the result
+    /*! \return the newly published data */
+    template<class __Func>
+    _DataPtr update( __Func func )
+    {
+        std::lock_guard<std::mutex> lock( update_mutex_ );
+
+        auto const data_ptr = boost::make_shared<_Data>( *boost::atomic_load( &data_ptr_ ) );
+        func( *data_ptr );
+
+        _DataPtr const result( data_ptr );
+        boost::atomic_store( &data_ptr_, result );
+
+        return result;
+    }
+};
+
+} // seabee
+
+#endif // SEABEE3COMMON_SNAPSHOT_H_
@@ -0,0 +1,121 @@
+/***************************************************************************
+ *  include/seabee3_common/transform_batch.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef SEABEE3COMMON_TRANSFORMBATCH_H_
+#define SEABEE3COMMON_TRANSFORMBATCH_H_
+
+// objects
+#include <tf/transform_broadcaster.h>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <vector>
+
+namespace seabee
+{
+
+// =============================================================================================================================================
+//! Collects transforms and broadcasts them together as a single tf message
+/*!
+ * - Every tf listener in the system deserializes every /tf message, so one message per frame instead of one per landmark cuts their work
+ *   (and /tf's message rate) by the number of landmarks
+ * - Frames are resolved against tf_prefix exactly like tf::TransformBroadcaster, which does the actual publishing
+ * - Not thread-safe; meant to be owned by whichever thread produces the transforms
+ */
+class TransformBatch : boost::noncopyable
+{
+protected:
+    //! Created on first use, since it needs ROS to be up
+    boost::shared_ptr<tf::TransformBroadcaster> broadcaster_;
+    std::vector<tf::StampedTransform> transforms_;
+
+    size_t num_messages_;
+    size_t num_transforms_;
+
+public:
+    TransformBatch()
+    :
+        num_messages_( 0 ),
+        num_transforms_( 0 )
+    {
+        //
+    }
+
+    void add( tf::Transform const & transform, ros::Time const & stamp, std::string const & frame_id, std::string const & child_frame_id )
+    {
+        transforms_.push_back( tf::StampedTransform( transform, stamp, frame_id, child_frame_id ) );
+    }
+
+    size_t size() const
+    {
+        return transforms_.size();
+    }
+
+    bool empty() const
+    {
+        return transforms_.empty();
+    }
+
+    //! Broadcast everything added since the last flush() as one message; does nothing if there's nothing to send
+    void flush()
+    {
+        if( transforms_.empty() ) return;
+
+        if( !broadcaster_ ) broadcaster_ = boost::make_shared<tf::TransformBroadcaster>();
+
+        broadcaster_->sendTransform( transforms_ );
+
+        ++num_messages_;
+        num_transforms_ += transforms_.size();
+
+        transforms_.clear();
+    }
+
+    //! Number of tf messages sent so far
+    size_t getNumMessages() const
+    {
+        return num_messages_;
+    }
+
+    //! Number of transforms sent so far; the number of messages we'd have sent without batching
+    size_t getNumTransforms() const
+    {
+        return num_transforms_;
+    }
+};
+
+} // seabee
+
+#endif // SEABEE3COMMON_TRANSFORMBATCH_H_
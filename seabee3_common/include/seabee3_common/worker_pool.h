@@ -0,0 +1,173 @@
+/***************************************************************************
+ *  include/seabee3_common/worker_pool.h
+ *  --------------------
+ *
+ *  Copyright (c) 2011, Edward T. Kaszubski ( ekaszubski@gmail.com )
+ *  All rights reserved.
+ *
+ *  Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are
+ *  met:
+ *
+ *  * Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above
+ *    copyright notice, this list of conditions and the following disclaimer
+ *    in the documentation and/or other materials provided with the
+ *    distribution.
+ *  * Neither the name of seabee3-ros-pkg nor the names of its
+ *    contributors may be used to endorse or promote products derived from
+ *    this software without specific prior written permission.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *  "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *  LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *  A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *  OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *  SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *  LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *  DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *  THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *  (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *  OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ **************************************************************************/
+
+#ifndef SEABEE3COMMON_WORKERPOOL_H_
+#define SEABEE3COMMON_WORKERPOOL_H_
+
+// objects
+#include <boost/thread.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/noncopyable.hpp>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace seabee
+{
+
+// =============================================================================================================================================
+//! A fixed set of threads for splitting a range of work (rows of an image, a list of images, ...) into contiguous chunks
+/*!
+ * - The calling thread always processes the first chunk itself, so a pool of size N owns N - 1 threads
+ * - Chunk boundaries depend only on the number of items and the pool size, so the assignment of items to chunks is deterministic
+ * - parallelFor() is not re-entrant; only one thread may submit work to a given pool at a time
+ */
+class WorkerPool : boost::noncopyable
+{
+public:
+    typedef std::function<void( size_t const &, size_t const & )> _RangeFunc;
+
+protected:
+    std::vector<boost::shared_ptr<boost::thread> > threads_;
+
+    std::mutex mutex_;
+    std::condition_variable work_condition_;
+    std::condition_variable done_condition_;
+
+    //! Incremented for each call to parallelFor(); lets workers tell new work from spurious wakeups
+    size_t generation_;
+    size_t pending_;
+    bool running_;
+
+    _RangeFunc const * func_;
+    size_t num_items_;
+
+public:
+    WorkerPool( size_t const & size = 1 )
+    :
+        generation_( 0 ),
+        pending_( 0 ),
+        running_( true ),
+        func_( NULL ),
+        num_items_( 0 )
+    {
+        for( size_t worker_idx = 1; worker_idx < size; ++worker_idx )
+        {
+            threads_.push_back( boost::make_shared<boost::thread>( &WorkerPool::workerLoop, this, worker_idx ) );
+        }
+    }
+
+    ~WorkerPool()
+    {
+        {
+            std::unique_lock<std::mutex> lock( mutex_ );
+            running_ = false;
+        }
+        work_condition_.notify_all();
+
+        for( auto thread_it = threads_.begin(); thread_it != threads_.end(); ++thread_it )
+        {
+            (*thread_it)->join();
+        }
+    }
+
+    //! Total number of threads used by parallelFor(), including the caller
+    size_t size() const
+    {
+        return threads_.size() + 1;
+    }
+
+    //! Run func( begin, end ) over size() contiguous sub-ranges of [0, num_items); blocks until all sub-ranges are done
+    void parallelFor( size_t const & num_items, _RangeFunc const & func )
+    {
+        if( threads_.empty() || num_items < 2 )
+        {
+            if( num_items ) func( 0, num_items );
+            return;
+        }
+
+        {
+            std::unique_lock<std::mutex> lock( mutex_ );
+            func_ = &func;
+            num_items_ = num_items;
+            pending_ = threads_.size();
+            ++generation_;
+        }
+        work_condition_.notify_all();
+
+        runChunk( 0, num_items, func );
+
+        std::unique_lock<std::mutex> lock( mutex_ );
+        while( pending_ > 0 ) done_condition_.wait( lock );
+        func_ = NULL;
+    }
+
+protected:
+    void runChunk( size_t const & worker_idx, size_t const & num_items, _RangeFunc const & func ) const
+    {
+        size_t const begin = num_items * worker_idx / size();
+        size_t const end = num_items * ( worker_idx + 1 ) / size();
+
+        if( begin < end ) func( begin, end );
+    }
+
+    void workerLoop( size_t const worker_idx )
+    {
+        size_t last_generation = 0;
+
+        std::unique_lock<std::mutex> lock( mutex_ );
+        while( true )
+        {
+            while( running_ && generation_ == last_generation ) work_condition_.wait( lock );
+            if( !running_ ) return;
+
+            last_generation = generation_;
+            _RangeFunc const & func = *func_;
+            size_t const num_items = num_items_;
+
+            lock.unlock();
+            runChunk( worker_idx, num_items, func );
+            lock.lock();
+
+            if( --pending_ == 0 ) done_condition_.notify_all();
+        }
+    }
+};
+
+} // seabee
+
+#endif // SEABEE3COMMON_WORKERPOOL_H_